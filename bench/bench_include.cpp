@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+
+#include <sasm/parser.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Hardware register definitions, as included by every module
+std::string header_path() {
+    static const auto path = [] () {
+        const auto path = (std::filesystem::temp_directory_path()
+                           / "sasm_bench_header.inc").string();
+        std::ofstream output(path, std::ios::binary);
+        for (int i = 0; i < 2000; ++i) {
+            output << ".define REGISTER_" << i << " $" << std::hex << (0x4000 + i)
+                   << std::dec << "    ; register " << i << "\n";
+        }
+        return path;
+    }();
+    return path;
+}
+
+// Header with the code of another platform, inactive in every module
+std::string skipped_path(int64_t lines) {
+    const auto path = (std::filesystem::temp_directory_path()
+                       / ("sasm_bench_skipped_" + std::to_string(lines) + ".inc")).string();
+    std::ofstream output(path, std::ios::binary);
+    output << ".ifdef OTHER_PLATFORM\n";
+    for (int64_t i = 0; i < lines; ++i) {
+        output << "    LDX #" << (i % 256) << "    ; line " << i << "\n";
+    }
+    output << ".endif\nNOP\n";
+    return path;
+}
+
+std::string module_source() {
+    std::string source = ".include \"" + header_path() + "\"\n";
+    for (int i = 0; i < 20; ++i) {
+        source += "    LDX REGISTER_" + std::to_string(i) + "\n";
+    }
+    return source;
+}
+
+size_t assemble(const std::string& source, sasm::source_manager& sources) {
+    sasm::reader reader(source);
+    sasm::lexer lexer(&reader);
+    sasm::parser parser(&lexer, &sources);
+    size_t count = 0;
+    for (const auto& statement : parser.statements()) {
+        benchmark::DoNotOptimize(statement.kind);
+        ++count;
+    }
+    return count;
+}
+
+// All modules share one source manager, the header is lexed once
+void BM_IncludeShared(benchmark::State& state) {
+    const auto source = module_source();
+    const auto modules = state.range(0);
+    size_t lex_count = 0;
+    for (auto _ : state) {
+        sasm::source_manager sources;
+        for (int64_t i = 0; i < modules; ++i) {
+            assemble(source, sources);
+        }
+        lex_count = sources.lex_count();
+    }
+    state.counters["lexed"] = static_cast<double>(lex_count);
+    state.SetItemsProcessed(state.iterations() * modules);
+}
+BENCHMARK(BM_IncludeShared)->RangeMultiplier(4)->Range(1, 64);
+
+// Each module has its own source manager, the header is lexed every time
+void BM_IncludeUnshared(benchmark::State& state) {
+    const auto source = module_source();
+    const auto modules = state.range(0);
+    size_t lex_count = 0;
+    for (auto _ : state) {
+        lex_count = 0;
+        for (int64_t i = 0; i < modules; ++i) {
+            sasm::source_manager sources;
+            assemble(source, sources);
+            lex_count += sources.lex_count();
+        }
+    }
+    state.counters["lexed"] = static_cast<double>(lex_count);
+    state.SetItemsProcessed(state.iterations() * modules);
+}
+BENCHMARK(BM_IncludeUnshared)->RangeMultiplier(4)->Range(1, 64);
+
+// Included tokens in an inactive branch, jumped over to the next directive
+// line rather than scanned line by line
+void BM_IncludeSkipped(benchmark::State& state) {
+    const auto path = skipped_path(state.range(0));
+    const auto source = ".include \"" + path + "\"\n";
+    sasm::source_manager sources;
+    sources.get(path);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(assemble(source, sources));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_IncludeSkipped)->RangeMultiplier(8)->Range(64, 32768);
+
+// Cost of getting the header tokens alone, once cached
+void BM_IncludeLookup(benchmark::State& state) {
+    sasm::source_manager sources;
+    sources.get(header_path());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sources.get(header_path()));
+    }
+}
+BENCHMARK(BM_IncludeLookup);
+
+}
@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+
+#include <sasm/parser.h>
+
+#include <cctype>
+
+namespace {
+
+const std::string macro_body =
+    "    LDX source\n"
+    "    LDY target, X\n"
+    "    ADC source + 1, X\n"
+    "    ROL target\n";
+
+// Tokens of one expansion, as parsed
+constexpr int64_t expansion_tokens = 18;
+
+size_t parse(const std::string& source) {
+    sasm::reader reader(source);
+    sasm::lexer lexer(&reader);
+    sasm::parser parser(&lexer);
+    size_t count = 0;
+    for (const auto& statement : parser.statements()) {
+        benchmark::DoNotOptimize(statement.kind);
+        ++count;
+    }
+    return count;
+}
+
+// Unrolled copy loop, expanded by the parser from the stored body tokens
+void BM_MacroReplay(benchmark::State& state) {
+    const auto expansions = state.range(0);
+    std::string source = ".macro COPY source, target\n" + macro_body + ".endmacro\n";
+    for (int64_t i = 0; i < expansions; ++i) {
+        source += "COPY $" + std::to_string(10 + i % 80) + ", $4" + std::to_string(100 + i % 800) + "\n";
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parse(source));
+    }
+    state.SetItemsProcessed(state.iterations() * expansions * expansion_tokens);
+}
+BENCHMARK(BM_MacroReplay)->RangeMultiplier(8)->Range(8, 4096);
+
+// Replaces the parameter where it is a whole identifier
+std::string substitute(const std::string& text, const std::string& name, const std::string& value) {
+    const auto identifier = [] (char c) { return std::isalnum(static_cast<unsigned char>(c)) || (c == '_'); };
+    std::string result;
+    result.reserve(text.size() + value.size() * 2);
+    size_t from = 0;
+    for (auto at = text.find(name); at != std::string::npos; at = text.find(name, at + name.size())) {
+        const auto end = at + name.size();
+        if (((at > 0) && identifier(text[at - 1])) || ((end < text.size()) && identifier(text[end]))) continue;
+        result.append(text, from, at - from);
+        result += value;
+        from = end;
+    }
+    result.append(text, from, std::string::npos);
+    return result;
+}
+
+// Baseline: the body text is substituted for each call, then lexed again
+void BM_MacroTextual(benchmark::State& state) {
+    const auto expansions = state.range(0);
+    for (auto _ : state) {
+        std::string source;
+        for (int64_t i = 0; i < expansions; ++i) {
+            const auto text = substitute(macro_body, "source", "$" + std::to_string(10 + i % 80));
+            source += substitute(text, "target", "$4" + std::to_string(100 + i % 800));
+        }
+        benchmark::DoNotOptimize(parse(source));
+    }
+    state.SetItemsProcessed(state.iterations() * expansions * expansion_tokens);
+}
+BENCHMARK(BM_MacroTextual)->RangeMultiplier(8)->Range(8, 4096);
+
+}
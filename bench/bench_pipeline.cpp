@@ -0,0 +1,235 @@
+#include <benchmark/benchmark.h>
+
+#include "corpus.h"
+
+#include <sasm/debug_map.h>
+#include <sasm/line_index.h>
+#include <sasm/parser.h>
+
+#include <map>
+
+namespace {
+
+using sasm::bench::corpus_mix;
+
+// Generated once per mix, every benchmark of a mix reads the same bytes
+const std::string& corpus(corpus_mix mix) {
+    static std::map<corpus_mix, std::string> corpora;
+    auto& content = corpora[mix];
+    if (content.empty()) {
+        sasm::bench::corpus_options_t options;
+        options.mix = mix;
+        content = sasm::bench::generate_corpus(options);
+    }
+    return content;
+}
+
+corpus_mix mix_of(const benchmark::State& state) {
+    return static_cast<corpus_mix>(state.range(0));
+}
+
+void every_mix(benchmark::internal::Benchmark* benchmark) {
+    for (const auto mix : { corpus_mix::instructions, corpus_mix::data, corpus_mix::comments,
+                            corpus_mix::expressions, corpus_mix::mixed }) {
+        benchmark->Arg(static_cast<int64_t>(mix));
+    }
+}
+
+void report(benchmark::State& state, size_t bytes, size_t items) {
+    state.SetLabel(sasm::bench::mix_name(mix_of(state)));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items));
+}
+
+// Characters
+void BM_ReaderGet(benchmark::State& state) {
+    const auto& content = corpus(mix_of(state));
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        count = 0;
+        for (auto c = reader.get(); !c.eof(); c = reader.get()) {
+            benchmark::DoNotOptimize(c.value);
+            ++count;
+        }
+    }
+    report(state, content.size(), count);
+}
+BENCHMARK(BM_ReaderGet)->Apply(every_mix);
+
+// Tokens, trivia included
+void BM_LexerGet(benchmark::State& state) {
+    const auto& content = corpus(mix_of(state));
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        count = 0;
+        for (auto token = lexer.get(); !token.eof(); token = lexer.get()) {
+            benchmark::DoNotOptimize(token.type);
+            ++count;
+        }
+    }
+    report(state, content.size(), count);
+}
+BENCHMARK(BM_LexerGet)->Apply(every_mix);
+
+// Tokens staged once and accepted at each line end
+void BM_ParserBaseStaging(benchmark::State& state) {
+    const auto& content = corpus(mix_of(state));
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        sasm::parser_base_t parser(&lexer);
+        count = 0;
+        parser.push_scope();
+        for (auto token = parser.stage_token(); !token.eof(); token = parser.stage_token()) {
+            ++count;
+            if (token.is<sasm::lexer_token::end_of_line>()) {
+                parser.accept();
+                parser.push_scope();
+            }
+        }
+    }
+    report(state, content.size(), count);
+}
+BENCHMARK(BM_ParserBaseStaging)->Apply(every_mix);
+
+// Each line is staged as far as its third token, cancelled, then staged
+// again to its end, as a failed rule followed by a successful one does
+void BM_ParserBaseBacktracking(benchmark::State& state) {
+    const auto& content = corpus(mix_of(state));
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        sasm::parser_base_t parser(&lexer);
+        count = 0;
+        while (true) {
+            parser.push_scope();
+            for (int i = 0; i < 3; ++i) {
+                const auto token = parser.stage_token();
+                ++count;
+                if (token.is<sasm::lexer_token::end_of_line, sasm::lexer_token::end_of_file>()) break;
+            }
+            parser.cancel_scope();
+            parser.push_scope();
+            auto token = parser.stage_token();
+            while (!token.is<sasm::lexer_token::end_of_line, sasm::lexer_token::end_of_file>()) {
+                token = parser.stage_token();
+                ++count;
+            }
+            parser.accept();
+            if (token.eof()) break;
+        }
+    }
+    report(state, content.size(), count);
+}
+BENCHMARK(BM_ParserBaseBacktracking)->Apply(every_mix);
+
+// Expressions alone, one per line
+void BM_TryParseExpression(benchmark::State& state) {
+    sasm::bench::corpus_options_t options;
+    options.mix = corpus_mix::expressions;
+    options.expression_depth = static_cast<size_t>(state.range(0));
+    auto content = sasm::bench::generate_corpus(options);
+    // Only the values are kept, without the directive
+    for (size_t at = content.find(".word "); at != std::string::npos; at = content.find(".word ", at)) {
+        content.replace(at, 6, "");
+    }
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        sasm::parser_base_t parser(&lexer);
+        count = 0;
+        sasm::expression_t expression;
+        while (sasm::try_parse_expression(parser, expression)) {
+            parser.push_scope();
+            parser.stage_token();
+            parser.accept();
+            ++count;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+BENCHMARK(BM_TryParseExpression)->Arg(1)->Arg(4)->Arg(16);
+
+// Instruction lines through every addressing mode rule
+void BM_TryParseInstruction(benchmark::State& state) {
+    const auto& content = corpus(corpus_mix::instructions);
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer);
+        count = 0;
+        while (!parser.parse_eof()) {
+            parser.m_tokens.clear();
+            if (!parser.parse_label() && parser.parse_instruction()) ++count;
+            if (!parser.parse_eol()) parser.parse_to_eol();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+BENCHMARK(BM_TryParseInstruction);
+
+// Statements, the whole front end
+void BM_ParserGet(benchmark::State& state) {
+    const auto& content = corpus(mix_of(state));
+    size_t count = 0;
+    for (auto _ : state) {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer);
+        count = 0;
+        for (auto statement = parser.get(); !statement.eof(); statement = parser.get()) {
+            benchmark::DoNotOptimize(statement.kind);
+            ++count;
+        }
+    }
+    report(state, content.size(), count);
+}
+BENCHMARK(BM_ParserGet)->Apply(every_mix);
+
+// Line starts found on first use, then a diagnostic every 64 lines located
+void BM_LineIndex(benchmark::State& state) {
+    const auto& content = corpus(mix_of(state));
+    std::vector<size_t> offsets;
+    for (size_t offset = 0, line = 0; offset < content.size(); ++offset) {
+        if ((content[offset] == '\n') && (++line % 64 == 0)) offsets.push_back(offset);
+    }
+    for (auto _ : state) {
+        sasm::line_index lines(content.data(), content.size());
+        benchmark::DoNotOptimize(lines.locate(offsets));
+    }
+    report(state, content.size(), offsets.size());
+}
+BENCHMARK(BM_LineIndex)->Apply(every_mix);
+
+// Source of addresses spread over a 4 MiB output of two byte instructions
+void BM_DebugMapFind(benchmark::State& state) {
+    static constexpr uint32_t size = 4 << 20;
+    std::vector<sasm::debug_row_t> rows;
+    for (uint32_t address = 0, line = 1; address < size; address += 2, ++line) {
+        rows.push_back({ address, 0, line, 5 });
+    }
+    std::vector<uint8_t> content;
+    sasm::write_debug_map(std::vector<std::string>{ "rom.s" }, rows, size, content);
+    sasm::debug_map_view view;
+    view.open(content);
+    uint32_t address = 0;
+    sasm::debug_row_t row;
+    for (auto _ : state) {
+        address = (address + 0x9E3779B1u) % size;
+        benchmark::DoNotOptimize(view.find(address, row));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["bytes_per_row"] = static_cast<double>(content.size()) / rows.size();
+}
+BENCHMARK(BM_DebugMapFind);
+
+}
@@ -0,0 +1,153 @@
+#include "corpus.h"
+
+#include <array>
+
+namespace sasm::bench {
+
+namespace {
+
+// splitmix64, the standard distributions differ between libraries
+class random_t {
+    uint64_t m_state;
+public:
+    explicit random_t(uint64_t seed) : m_state(seed) {}
+
+    uint64_t next() {
+        auto z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+};
+
+std::string hex(uint64_t value, int digits) {
+    static const char* symbols = "0123456789ABCDEF";
+    std::string text = "$";
+    for (int i = digits - 1; i >= 0; --i) text += symbols[(value >> (4 * i)) & 0xF];
+    return text;
+}
+
+// Jumps go to the label of their block of 16 lines, always defined before
+void instruction_line(random_t& random, size_t line, bool label_jumps, std::string& output) {
+    static const std::array<const char*, 4> loads { "LDX", "LDY", "ADC", "ADC" };
+    const auto operation = loads[random.below(loads.size())];
+    switch (random.below(8)) {
+        case 0: output += "    NOP\n"; break;
+        case 1: output += "    ROL\n"; break;
+        case 2: output += std::string("    ") + operation + " #" + hex(random.below(256), 2) + "\n"; break;
+        case 3: output += std::string("    ") + operation + " " + hex(random.below(256), 2) + "\n"; break;
+        case 4: output += std::string("    ") + operation + " " + hex(0x200 + random.below(0xF000), 4) + "\n"; break;
+        case 5: output += "    ADC " + hex(0x200 + random.below(0xF000), 4) + ", X\n"; break;
+        case 6: output += "    BCC *+" + std::to_string(2 + random.below(100)) + "\n"; break;
+        default:
+            output += label_jumps
+                ? "    JMP L" + std::to_string(line / 16 * 16) + "\n"
+                : "    JMP " + hex(0x200 + random.below(0xF000), 4) + "\n";
+            break;
+    }
+}
+
+void data_line(random_t& random, std::string& output) {
+    const auto words = random.below(4) == 0;
+    output += words ? "    .word " : "    .byte ";
+    for (int i = 0; i < 16; ++i) {
+        if (i > 0) output += ", ";
+        output += words ? hex(random.below(0x10000), 4) : std::to_string(1 + random.below(255));
+    }
+    output += "\n";
+}
+
+void bytes_line(random_t& random, std::string& output) {
+    output += "    .byte ";
+    for (int i = 0; i < 64; ++i) {
+        if (i > 0) output += ", ";
+        output += std::to_string(1 + random.below(255));
+    }
+    output += "\n";
+}
+
+// One line in 8 jumps, forward or backward, the rest are labels alone
+void label_line(random_t& random, size_t line, size_t lines, std::string& output) {
+    output += "L" + std::to_string(line) + ":";
+    if (line % 8 == 0) output += " JMP L" + std::to_string(random.below(lines));
+    output += "\n";
+}
+
+void comment_line(random_t& random, size_t line, std::string& output) {
+    if (random.below(2) == 0) {
+        output += "; line " + std::to_string(line) + ", nothing but a comment here to be skipped\n";
+    } else {
+        output += "    NOP    ; trailing comment after the instruction\n";
+    }
+}
+
+void expression(random_t& random, size_t depth, std::string& output) {
+    if (depth == 0) {
+        output += std::to_string(1 + random.below(100));
+        return;
+    }
+    static const std::array<const char*, 3> operations { " + ", " - ", " * " };
+    output += "(";
+    expression(random, depth - 1, output);
+    output += operations[random.below(operations.size())];
+    output += std::to_string(1 + random.below(9));
+    output += ")";
+}
+
+void expression_line(random_t& random, size_t depth, std::string& output) {
+    output += "    .word ";
+    expression(random, depth, output);
+    output += "\n";
+}
+
+}
+
+const char* mix_name(corpus_mix mix) {
+    switch (mix) {
+        case corpus_mix::instructions: return "instructions";
+        case corpus_mix::data: return "data";
+        case corpus_mix::comments: return "comments";
+        case corpus_mix::expressions: return "expressions";
+        case corpus_mix::mixed: return "mixed";
+        case corpus_mix::bytes: return "bytes";
+        case corpus_mix::labels: return "labels";
+    }
+    return "";
+}
+
+std::string generate_corpus(const corpus_options_t& options) {
+    random_t random(options.seed);
+    std::string output;
+    output.reserve(options.lines * 40);
+    const auto has_labels = (options.mix == corpus_mix::instructions)
+        || (options.mix == corpus_mix::mixed);
+    for (size_t line = 0; line < options.lines; ++line) {
+        if (has_labels && (line % 16 == 0)) {
+            output += "L" + std::to_string(line) + ":\n";
+            continue;
+        }
+        auto mix = options.mix;
+        if (mix == corpus_mix::mixed) {
+            // Mostly code, as in a program
+            static const std::array<corpus_mix, 8> weights {
+                corpus_mix::instructions, corpus_mix::instructions, corpus_mix::instructions,
+                corpus_mix::instructions, corpus_mix::data, corpus_mix::comments,
+                corpus_mix::comments, corpus_mix::expressions,
+            };
+            mix = weights[random.below(weights.size())];
+        }
+        switch (mix) {
+            case corpus_mix::instructions: instruction_line(random, line, options.label_jumps, output); break;
+            case corpus_mix::data: data_line(random, output); break;
+            case corpus_mix::comments: comment_line(random, line, output); break;
+            case corpus_mix::expressions: expression_line(random, options.expression_depth, output); break;
+            case corpus_mix::bytes: bytes_line(random, output); break;
+            case corpus_mix::labels: label_line(random, line, options.lines, output); break;
+            case corpus_mix::mixed: break;
+        }
+    }
+    return output;
+}
+
+}
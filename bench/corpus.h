@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sasm::bench {
+
+// Kind of lines a synthetic corpus is made of
+enum class corpus_mix {
+    instructions,   // every addressing mode, a label every 16 lines
+    data,           // long .byte and .word lists
+    comments,       // comment lines and trailing comments
+    expressions,    // .word values of deeply nested expressions
+    mixed,          // all of the above, as in a real program
+    bytes,          // .byte lists alone, 64 values a line
+    labels,         // a label every line, jumps to any of them
+};
+
+const char* mix_name(corpus_mix mix);
+
+struct corpus_options_t {
+    corpus_mix mix = corpus_mix::mixed;
+    size_t lines = 10000;
+    uint64_t seed = 1;
+    size_t expression_depth = 8;
+    bool label_jumps = true;    // off for programs past $FFFF, jumps go to literals
+};
+
+// Same options, same bytes, on every platform
+std::string generate_corpus(const corpus_options_t& options);
+
+}
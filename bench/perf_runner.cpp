@@ -0,0 +1,355 @@
+#include "corpus.h"
+
+#include <sasm/allocation.h>
+#include <sasm/assembler.h>
+#include <sasm/parser.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+
+#include <sys/resource.h>
+
+#ifndef SASM_ALLOCATIONS
+// Every allocation of the process is counted, the assembly ones are those
+// made between two reads of the counter
+static std::atomic<size_t> g_allocations = 0;
+
+// Every form is replaced, so that each one allocating with malloc or
+// aligned_alloc has its operator delete freeing with free
+static void* counted_allocate(size_t size, size_t alignment = 0) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size ? size : 1;
+    void* pointer = (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    if (pointer) return pointer;
+#ifdef __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    std::abort();
+#endif
+}
+
+static void counted_free(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void* operator new(size_t size) { return counted_allocate(size); }
+void* operator new[](size_t size) { return counted_allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) {
+    return counted_allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return counted_allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { counted_free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { counted_free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { counted_free(pointer); }
+
+static size_t allocation_count() {
+    return g_allocations.load();
+}
+#else
+// The library replaced operator new already, its stages are summed
+static size_t allocation_count() {
+    size_t count = 0;
+    for (const auto& stage : sasm::allocation_counts()) count += stage.count;
+    return count;
+}
+#endif
+
+namespace {
+
+namespace fs = std::filesystem;
+using sasm::bench::corpus_mix;
+
+using metrics_t = std::map<std::string, double>;
+using baseline_t = std::map<std::string, metrics_t>;
+
+// Corpora of the suite, large enough for a quadratic step to show
+struct suite_corpus_t {
+    const char* name;
+    corpus_mix mix;
+    size_t lines;
+    bool label_jumps;
+};
+
+const suite_corpus_t suite[] = {
+    { "instructions", corpus_mix::instructions, 1000000, false },   // 1M lines
+    { "bytes", corpus_mix::bytes, 156250, true },                   // 10M .byte values
+    { "labels", corpus_mix::labels, 100000, true },                 // 100k labels
+};
+
+// Higher is better for rates, lower for the others. Rates are counted in
+// the time a calibration loop takes on the same machine rather than in
+// seconds, so that the baseline holds on a faster or slower host.
+bool is_rate(const std::string& metric) {
+    return metric.ends_with("_per_calibration");
+}
+
+// The baseline is an object of corpora, each an object of numbers, which
+// is all this reader accepts
+class baseline_reader {
+    const std::string& m_text;
+    size_t m_position = 0;
+
+    void skip_space() {
+        while ((m_position < m_text.size()) && std::isspace(static_cast<unsigned char>(m_text[m_position]))) {
+            ++m_position;
+        }
+    }
+    bool expect(char c) {
+        skip_space();
+        if ((m_position >= m_text.size()) || (m_text[m_position] != c)) return false;
+        ++m_position;
+        return true;
+    }
+    bool read_string(std::string& value) {
+        if (!expect('"')) return false;
+        const auto end = m_text.find('"', m_position);
+        if (end == std::string::npos) return false;
+        value = m_text.substr(m_position, end - m_position);
+        m_position = end + 1;
+        return true;
+    }
+    bool read_number(double& value) {
+        skip_space();
+        char* end = nullptr;
+        value = std::strtod(m_text.c_str() + m_position, &end);
+        if (end == m_text.c_str() + m_position) return false;
+        m_position = end - m_text.c_str();
+        return true;
+    }
+    template <typename read_value_t>
+    bool read_object(read_value_t read_value) {
+        if (!expect('{')) return false;
+        if (expect('}')) return true;
+        do {
+            std::string key;
+            if (!read_string(key) || !expect(':') || !read_value(key)) return false;
+        } while (expect(','));
+        return expect('}');
+    }
+
+public:
+    explicit baseline_reader(const std::string& text) : m_text(text) {}
+
+    bool read(baseline_t& baseline) {
+        return read_object([&] (const std::string& corpus) {
+            return read_object([&] (const std::string& metric) {
+                return read_number(baseline[corpus][metric]);
+            });
+        });
+    }
+};
+
+bool read_baseline(const std::string& path, baseline_t& baseline) {
+    std::ifstream input(path);
+    if (!input) return false;
+    std::stringstream text;
+    text << input.rdbuf();
+    const auto content = text.str();
+    return baseline_reader(content).read(baseline);
+}
+
+bool write_baseline(const std::string& path, const baseline_t& baseline) {
+    std::ofstream output(path);
+    output << "{";
+    const char* corpus_separator = "\n";
+    for (const auto& [corpus, metrics] : baseline) {
+        output << corpus_separator << "    \"" << corpus << "\": {";
+        const char* metric_separator = "\n";
+        for (const auto& [metric, value] : metrics) {
+            output << metric_separator << "        \"" << metric << "\": " << static_cast<uint64_t>(value);
+            metric_separator = ",\n";
+        }
+        output << "\n    }";
+        corpus_separator = ",\n";
+    }
+    output << "\n}\n";
+    return static_cast<bool>(output);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best time of a loop of byte reads, branches and multiplies over the
+// corpus, the kind of work the lexer does, untouched by changes to sasm
+double calibration_seconds(const std::string& content, int runs) {
+    static constexpr int passes = 4;
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        uint64_t hash = 14695981039346656037ull;
+        size_t lines = 0;
+        for (int pass = 0; pass < passes; ++pass) {
+            for (const char c : content) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+                if (c == '\n') ++lines;
+            }
+        }
+        // Stored, so that the loop is not optimized away
+        static volatile uint64_t sink;
+        sink = hash + lines;
+        best = std::min(best, seconds_since(start));
+    }
+    return best;
+}
+
+// Best of the runs, the others are the noise of the machine
+bool measure(const suite_corpus_t& corpus, int runs, metrics_t& metrics) {
+    sasm::bench::corpus_options_t options;
+    options.mix = corpus.mix;
+    options.lines = corpus.lines;
+    options.label_jumps = corpus.label_jumps;
+    const auto content = sasm::bench::generate_corpus(options);
+    const auto path = (fs::temp_directory_path() / (std::string("sasm_perf_") + corpus.name + ".s")).string();
+    {
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+    }
+
+    size_t tokens = 0;
+    double lex_seconds = 1e30;
+    for (int run = 0; run < runs; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        tokens = 0;
+        for (auto token = lexer.get(); !token.eof(); token = lexer.get()) ++tokens;
+        lex_seconds = std::min(lex_seconds, seconds_since(start));
+    }
+
+    size_t statements = 0;
+    {
+        sasm::reader reader(content.data(), content.size());
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer);
+        for (auto statement = parser.get(); !statement.eof(); statement = parser.get()) ++statements;
+    }
+
+    // The whole pipeline, reading the file to encoding its last statement
+    double assemble_seconds = 1e30;
+    size_t allocations = 0;
+    for (int run = 0; run < runs; ++run) {
+        const auto before = allocation_count();
+        const auto start = std::chrono::steady_clock::now();
+        sasm::source_manager sources;
+        sasm::assembly_t assembly;
+        const auto success = sasm::assemble(path, sources, {}, assembly);
+        assemble_seconds = std::min(assemble_seconds, seconds_since(start));
+        allocations = allocation_count() - before;
+        if (!success) {
+            for (const auto& error : assembly.errors.messages()) std::cerr << error << "\n";
+            fs::remove(path);
+            return false;
+        }
+    }
+    fs::remove(path);
+
+    const auto calibration = calibration_seconds(content, runs);
+    std::printf("%-12s %-26s %14.0f  tokens/s %.0f, statements/s %.0f\n",
+                corpus.name, "calibration_us", calibration * 1e6, tokens / lex_seconds, statements / assemble_seconds);
+
+    rusage usage {};
+    ::getrusage(RUSAGE_SELF, &usage);
+    metrics["tokens_per_calibration"] = tokens * calibration / lex_seconds;
+    metrics["statements_per_calibration"] = statements * calibration / assemble_seconds;
+    metrics["peak_rss_kb"] = static_cast<double>(usage.ru_maxrss);
+    metrics["allocations"] = static_cast<double>(allocations);
+    return true;
+}
+
+const char* usage_text =
+    "usage: perf_runner --corpus <name> --baseline <path> [options]\n"
+    "  --corpus <name>      instructions, bytes or labels\n"
+    "  --baseline <path>    JSON of the metrics each corpus is held to\n"
+    "  --threshold <ratio>  regression tolerated, 0.25 by default\n"
+    "  --runs <count>       the best of which is kept, 3 by default\n"
+    "  --update             records the metrics into the baseline instead\n";
+
+}
+
+int main(int argc, char** argv) {
+    std::string corpus_name;
+    std::string baseline_path;
+    double threshold = 0.25;
+    int runs = 3;
+    bool update = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if ((arg == "--corpus") && has_value) {
+            corpus_name = argv[++i];
+        } else if ((arg == "--baseline") && has_value) {
+            baseline_path = argv[++i];
+        } else if ((arg == "--threshold") && has_value) {
+            threshold = std::strtod(argv[++i], nullptr);
+        } else if ((arg == "--runs") && has_value) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--update") {
+            update = true;
+        } else {
+            std::cerr << usage_text;
+            return 2;
+        }
+    }
+    const auto corpus = std::find_if(std::begin(suite), std::end(suite),
+        [&] (const auto& entry) { return corpus_name == entry.name; });
+    if ((corpus == std::end(suite)) || baseline_path.empty()) {
+        std::cerr << usage_text;
+        return 2;
+    }
+
+    baseline_t baseline;
+    const auto has_baseline = read_baseline(baseline_path, baseline);
+    if (!has_baseline && !update) {
+        std::cerr << baseline_path << ": cannot read baseline\n";
+        return 2;
+    }
+
+    metrics_t metrics;
+    if (!measure(*corpus, runs, metrics)) {
+        std::cerr << corpus->name << ": cannot be assembled\n";
+        return 1;
+    }
+
+    if (update) {
+        baseline[corpus->name] = metrics;
+        if (!write_baseline(baseline_path, baseline)) {
+            std::cerr << baseline_path << ": cannot write baseline\n";
+            return 2;
+        }
+    }
+
+    bool regressed = false;
+    const auto& expected = baseline[corpus->name];
+    for (const auto& [metric, value] : metrics) {
+        const auto it = expected.find(metric);
+        const auto reference = (it != expected.end()) ? it->second : value;
+        const auto ratio = (reference > 0) ? value / reference : 1.0;
+        const auto worse = is_rate(metric) ? (ratio < 1.0 - threshold) : (ratio > 1.0 + threshold);
+        std::printf("%-12s %-26s %14.0f  baseline %14.0f  %+6.1f%%%s\n",
+                    corpus->name, metric.c_str(), value, reference, (ratio - 1.0) * 100.0,
+                    worse ? "  REGRESSED" : "");
+        regressed = regressed || worse;
+    }
+    return regressed ? 1 : 0;
+}
@@ -0,0 +1 @@
+LDX #$
@@ -0,0 +1,22 @@
+.define COUNT 3
+.define BASE $0200
+.import PRINT
+.export START
+.align 16
+START:
+.byte 1, 2, COUNT * 2, (BASE + 1) / 2
+.word BASE, START, -1
+.macro LOAD value, address
+    LDX #value
+    LDY address, X
+.endmacro
+LOAD 1, $1234
+.repeat COUNT, i
+    .byte i
+.endrepeat
+.ifdef COUNT
+    NOP
+.else
+    JMP PRINT
+.endif
+.include "missing.s"
@@ -0,0 +1,12 @@
+START:
+    LDX #$10
+    LDY $1234, X
+    ADC ($20), Y
+    ADC ($20, X)
+    JMP ($FFFC)
+    ROL A
+@loop:
+    BCC @loop
+    BCC *-2
+:   NOP
+    JMP :-
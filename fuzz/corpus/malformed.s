@@ -0,0 +1,5 @@
+LDX #((((((((((((1))))))))))))
+LDX #(((
+.byte 1,,2
+.macro
+.repeat 2
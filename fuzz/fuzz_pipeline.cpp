@@ -0,0 +1,55 @@
+#include <sasm/debug_map.h>
+#include <sasm/encoder.h>
+#include <sasm/object.h>
+#include <sasm/parser.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Arbitrary bytes through the whole pipeline: lexing, parsing under the
+// default limits, encoding both ways, flattening and writing the object and
+// the debug map.
+// Without a source manager includes fail rather than read files, and the
+// binary includes are skipped for the same reason.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // Repeats and macros legitimately expand a few lines into any number
+    // of statements, such inputs would only be reported as timeouts
+    static constexpr size_t max_statements = 1 << 16;
+
+    sasm::reader reader(reinterpret_cast<const char*>(data), size);
+    sasm::lexer lexer(&reader);
+    sasm::parser parser(&lexer);
+    sasm::encoder flat;
+    sasm::encoder relocatable(0, true);
+    flat.track_positions();
+    size_t statements = 0;
+    for (auto statement = parser.get(); !statement.eof() && (statements < max_statements); statement = parser.get()) {
+        ++statements;
+        if (statement.kind == sasm::parser_token::binary_include) continue;
+        flat.encode(statement);
+        relocatable.encode(statement);
+    }
+    if (flat.finish()) {
+        const auto bytes = flat.flatten();
+        (void)bytes;
+    }
+    // Offsets stand for lines, the lexer input has no line index here
+    std::vector<sasm::debug_row_t> rows;
+    for (const auto& position : flat.positions()) {
+        rows.push_back({ static_cast<uint32_t>(position.address), 0,
+                         static_cast<uint32_t>(position.offset), 1 });
+    }
+    std::vector<uint8_t> map;
+    const std::string files[] = { "input" };
+    if (sasm::write_debug_map(files, rows, static_cast<uint32_t>(flat.size()), map)) {
+        sasm::debug_map_view view;
+        sasm::debug_row_t row;
+        if (view.open(map) && !rows.empty()) view.find(rows.back().address, row);
+    }
+    relocatable.finish();
+    std::vector<uint8_t> object;
+    sasm::write_object(relocatable, object);
+    return 0;
+}
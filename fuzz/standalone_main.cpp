@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace fs = std::filesystem;
+
+// Runs the fuzz target over files and directories of inputs where libFuzzer
+// is not available, to replay a corpus or a crash. The time and memory limits
+// of libFuzzer are honoured, its other flags ignored.
+int main(int argc, char** argv) {
+    unsigned timeout = 0;
+    uint64_t rss_limit_mb = 0;
+    std::vector<fs::path> inputs;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.starts_with("-timeout=")) {
+            timeout = static_cast<unsigned>(std::strtoul(arg.c_str() + 9, nullptr, 10));
+        } else if (arg.starts_with("-rss_limit_mb=")) {
+            rss_limit_mb = std::strtoull(arg.c_str() + 14, nullptr, 10);
+        } else if (arg.starts_with("-")) {
+            continue;
+        } else if (fs::is_directory(arg)) {
+            for (const auto& entry : fs::directory_iterator(arg)) {
+                if (entry.is_regular_file()) inputs.push_back(entry.path());
+            }
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    // Address space rather than resident set, the closest bound to set
+    if (rss_limit_mb > 0) {
+        const rlim_t bytes = rss_limit_mb << 20;
+        rlimit limit { bytes, bytes };
+        ::setrlimit(RLIMIT_AS, &limit);
+    }
+
+    for (const auto& path : inputs) {
+        std::ifstream input(path, std::ios::binary);
+        const std::vector<uint8_t> content(std::istreambuf_iterator<char>(input), {});
+        // SIGALRM ends the process, the input at fault is the last named
+        std::cerr << "running " << path.string() << "\n";
+        ::alarm(timeout);
+        LLVMFuzzerTestOneInput(content.data(), content.size());
+        ::alarm(0);
+    }
+    std::cerr << "ran " << inputs.size() << " inputs\n";
+    return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Stages of the pipeline allocations are charged to, the innermost
+// allocation_scope of the thread, other outside of any
+enum class allocation_stage : uint8_t {
+    other, reader, lexer, parser_base, parser, expression, encoder,
+};
+static constexpr size_t allocation_stage_count = 7;
+
+const char* stage_name(allocation_stage stage);
+
+struct allocation_counts_t {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    int64_t live = 0;   // bytes allocated and not freed yet, frees go to the allocating stage
+    int64_t peak = 0;
+};
+using allocation_table_t = std::array<allocation_counts_t, allocation_stage_count>;
+
+// In builds with the SASM_ALLOCATIONS option, the global operator new and
+// delete are replaced by counting ones
+constexpr bool allocations_counted() {
+#ifdef SASM_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Counts of every thread since the last reset, zero when not counted
+allocation_table_t allocation_counts();
+// Peaks restart from the bytes live now
+void reset_allocation_counts();
+// A line a stage, those with no allocation left out
+std::vector<std::string> allocation_report();
+
+#ifdef SASM_ALLOCATIONS
+// Charges the allocations of the thread to a stage while alive
+class allocation_scope {
+    allocation_stage m_previous;
+public:
+    explicit allocation_scope(allocation_stage stage);
+    ~allocation_scope();
+
+    allocation_scope(const allocation_scope&) = delete;
+    allocation_scope& operator=(const allocation_scope&) = delete;
+};
+#else
+class allocation_scope {
+public:
+    explicit allocation_scope(allocation_stage) {}
+};
+#endif
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <sasm/debug_map.h>
+#include <sasm/diagnostics.h>
+#include <sasm/encoder.h>
+#include <sasm/source_manager.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+struct assemble_options_t {
+    size_t origin = 0;
+    bool relocatable = false;   // object file rather than flat binary
+    parse_limits_t limits;
+    bool debug_map = false;     // in assembly_t::debug_map
+};
+
+// Result of assembling one source file
+struct assembly_t {
+    encoder output;
+    std::vector<std::string> dependencies;  // included files, absolute paths, and where missing ones were searched
+    diagnostics_sink errors;                // formatted by errors.messages()
+    std::vector<uint8_t> debug_map;         // when asked for, read by debug_map_view
+};
+
+// Assembles a source file, the file and its includes are read through the
+// source manager so that their tokens are shared with other assemblies.
+// Returns false if errors were found.
+bool assemble(const std::string& path,
+              source_manager& sources,
+              const assemble_options_t& options,
+              assembly_t& result);
+
+// Output bytes, an object file when relocatable, a flat binary otherwise
+bool serialize(const assembly_t& assembly, std::vector<uint8_t>& content);
+
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdio>
+#include <cstdlib>
+#ifdef SASM_EXCEPTIONS
 #include <exception>
 #include <sstream>
+#endif
 
 #undef assert
 #define assert(condition)           \
@@ -13,6 +17,7 @@
 
 namespace sasm {
 
+#ifdef SASM_EXCEPTIONS
 struct assertion_exception : public std::exception {
     std::string message;
     explicit assertion_exception(const char* msg,
@@ -37,14 +42,23 @@ struct assertion_exception : public std::exception {
         return message.c_str();
     }
 };
+#endif
 
+// A failed assertion is a bug of the assembler rather than of its input, it
+// aborts. Builds configured with SASM_EXCEPTIONS throw instead, to debug.
 static void assert_f(bool condition,
               const char *msg,
               const char *func,
               const char *file,
               int line) {
     if (!condition) {
+#ifdef SASM_EXCEPTIONS
         throw assertion_exception(msg, func, file, line);
+#else
+        std::fprintf(stderr, "Assertion failed: %s, function %s, file %s, line %d\n",
+                     msg, func, file, line);
+        std::abort();
+#endif
     }
 }
 
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <sasm/mapped_file.h>
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// On disk cache of assembled outputs
+//
+// Entries are found in two steps. The source key covers the bytes of the
+// main source, the assembler revision and the options; it names a manifest
+// listing the files the source included when it was last assembled, with
+// their hashes. When they all still match, the output key, which adds the
+// include hashes, names the cached output.
+//
+// The cache is bounded in size, the least recently used files are evicted
+// first. Using an entry updates the modification time of its files.
+class build_cache {
+    std::string m_directory;
+    uint64_t m_max_size;
+
+    std::string entry_path(uint64_t key, const char* extension) const;
+
+public:
+    // Bumped whenever the cache layout changes. The revision the assembler
+    // was built from and the object format version are part of the keys too,
+    // so that another build never reuses the outputs of this one.
+    static constexpr uint32_t version = 1;
+
+    build_cache(const std::string& directory, uint64_t max_size);
+
+    // Key of a source before its includes are known
+    static uint64_t source_key(std::span<const uint8_t> source, const std::string& options);
+
+    // Maps the cached output, returns false if there is none or it is stale
+    bool find(uint64_t source_key, mapped_file& output) const;
+
+    // Adds an output with the files it depends on, then evicts if needed
+    bool store(uint64_t source_key,
+               const std::vector<std::string>& dependencies,
+               std::span<const uint8_t> output);
+
+    // Removes the least recently used files until the cache fits
+    void evict();
+
+    // Total size of the cached files
+    uint64_t size() const;
+};
+
+}
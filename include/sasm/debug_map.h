@@ -0,0 +1,139 @@
+#pragma once
+
+#include <sasm/mapped_file.h>
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sasm {
+
+// Source of the output bytes from an address up to the next row's
+struct debug_row_t {
+    uint32_t address;
+    uint32_t file;      // index in the files of the map
+    uint32_t line;      // from 1, 0 if unknown
+    uint32_t column;    // from 1, 0 if unknown
+
+    bool operator==(const debug_row_t&) const = default;
+};
+
+// Map from output addresses to source lines
+//
+// The rows are stored as a line program in the manner of DWARF: opcodes
+// changing the registers of a row from the previous one, most rows a single
+// byte. Every checkpoint_interval rows, the registers and the offset of the
+// next opcode are kept in a fixed size checkpoint, so that a lookup is a
+// binary search in the checkpoints and the decoding of a few rows. Like
+// object files, the map is used in place once mapped.
+//
+//   header
+//   checkpoints    checkpoint[checkpoint_count], increasing addresses
+//   files          file[file_count]
+//   program        opcodes, program_size bytes
+//   strings        file paths, not null terminated
+namespace debug_format {
+
+static_assert(std::endian::native == std::endian::little,
+              "debug maps are used in place and are little endian");
+
+static constexpr char magic[8] = { 'S', 'A', 'S', 'M', 'D', 'B', 'G', '\0' };
+static constexpr uint32_t version = 1;
+static constexpr uint32_t table_alignment = 8;
+static constexpr uint32_t checkpoint_interval = 64;
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t end_address;       // after the last byte mapped
+    uint32_t row_count;
+    uint32_t checkpoint_count, checkpoint_offset;
+    uint32_t file_count, file_offset;
+    uint32_t program_size, program_offset;
+    uint32_t string_size, string_offset;
+};
+static_assert(sizeof(header) == 56);
+
+// Registers after a row, and where the program goes on
+struct checkpoint {
+    uint32_t address;
+    uint32_t file;
+    uint32_t line;
+    uint32_t column;
+    uint32_t program_offset;    // from the start of the program
+    uint32_t reserved;
+};
+static_assert(sizeof(checkpoint) == 24);
+
+struct file {
+    uint32_t name_offset;       // in the string table
+    uint32_t name_length;
+};
+static_assert(sizeof(file) == 8);
+
+// The registers start as address 0, file 0, line 1, column 1. Operands are
+// LEB128 encoded, unsigned but for advance_line.
+enum opcode : uint8_t {
+    copy,               // appends a row
+    advance_address,    // address += operand
+    advance_line,       // line += operand
+    set_file,           // file = operand
+    set_column,         // column = operand
+    first_special,
+};
+// A special opcode advances the address by (opcode - first_special) / line_range
+// and the line by line_base + (opcode - first_special) % line_range, then
+// appends a row
+static constexpr int32_t line_base = -3;
+static constexpr uint32_t line_range = 12;
+
+}
+
+// Serializes rows in strictly increasing addresses, below the end address
+// Returns false if they cannot be represented
+bool write_debug_map(std::span<const std::string> files, std::span<const debug_row_t> rows,
+                     uint32_t end_address, std::vector<uint8_t>& output);
+bool write_debug_map(std::span<const std::string> files, std::span<const debug_row_t> rows,
+                     uint32_t end_address, const std::string& path);
+// Replaces the file with a serialized map, by renaming a new one over it
+bool write_debug_map(std::span<const uint8_t> content, const std::string& path);
+
+// Debug map used in place
+class debug_map_view {
+    std::span<const uint8_t> m_data;
+
+    bool invalid();
+    const debug_format::header& header() const;
+    std::span<const debug_format::checkpoint> checkpoints() const;
+    std::span<const uint8_t> program() const;
+
+public:
+    // Validates the layout and decodes the program once, returns false if
+    // the content is not a valid debug map
+    bool open(std::span<const uint8_t> data);
+
+    size_t file_count() const;
+    std::string_view file(uint32_t index) const;
+    uint32_t end_address() const;
+
+    // Row of the byte at the address, false for addresses not mapped
+    bool find(uint32_t address, debug_row_t& row) const;
+    // Every row, by decoding the whole program
+    std::vector<debug_row_t> rows() const;
+};
+
+// Debug map mapped from disk
+class debug_map_file {
+    mapped_file m_file;
+    debug_map_view m_view;
+
+public:
+    bool open(const std::string& path);
+    const debug_map_view& view() const;
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <sasm/line_index.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+enum class diagnostic_code : uint8_t {
+    cannot_read_file,
+    invalid_statement,          // at its line, argument: index of the statement
+    unencodable_statement,      // at its line, argument: index of the statement
+    duplicate_definition,       // at its line, argument: index of the statement
+    unresolved_symbols,
+    nesting_too_deep,           // argument: the limit
+    line_too_long,              // argument: the limit
+    unmappable_output,          // beyond the addresses of a debug map
+    unterminated_conditional,   // at its .if, the file or expansion ends first
+    duplicate_else,             // at the second .else of a conditional block
+};
+
+// Error of an input, as numbers until it is printed
+struct diagnostic_t {
+    diagnostic_code code;
+    uint32_t source;            // index in the sources of the sink
+    size_t offset;
+    size_t length;
+    uint64_t argument;
+};
+
+// Errors of an assembly
+//
+// Reporting one appends a few numbers to storage reserved up front, so that
+// inputs made of errors cost no more than valid ones. Messages are only made
+// when asked for, with the paths of the sources and, for the sources whose
+// lines are known, the line and column of the offsets.
+class diagnostics_sink {
+    std::vector<diagnostic_t> m_entries;
+    std::vector<std::string> m_sources;
+    std::vector<std::shared_ptr<const line_index>> m_lines;    // of each source, if known
+
+    std::string format(const diagnostic_t& diagnostic, const line_column_t* position) const;
+
+public:
+    static constexpr uint32_t no_source = UINT32_MAX;
+
+    explicit diagnostics_sink(size_t capacity = 64);
+
+    // Index of a path, the same for the same path
+    uint32_t source(const std::string& path, std::shared_ptr<const line_index> lines = nullptr);
+
+    void report(diagnostic_code code, uint32_t source,
+                size_t offset = 0, size_t length = 0, uint64_t argument = 0);
+
+    const std::vector<diagnostic_t>& entries() const;
+    bool empty() const;
+    // Keeps the storage and the sources
+    void clear();
+
+    // Prefixed by the path of the source, if any. The messages of a source
+    // are located by one pass over its lines, in increasing offsets.
+    std::string message(const diagnostic_t& diagnostic) const;
+    std::vector<std::string> messages() const;
+};
+
+}
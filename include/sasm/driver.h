@@ -0,0 +1,54 @@
+#pragma once
+
+#include <sasm/assembler.h>
+#include <sasm/profile.h>
+#include <sasm/stats.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Command line of the sasm driver
+struct driver_options_t {
+    std::string source;
+    std::vector<std::string> sources;   // more than one with --watch
+    std::string output;
+    std::vector<std::string> include_paths;
+    assemble_options_t assemble;
+    std::string cache_directory;
+    uint64_t cache_size = 256 << 20;
+    std::string server_socket;
+    bool watch = false;
+    bool stats = false;
+    bool profile = false;
+    bool allocations = false;
+    std::string trace_path;             // Chrome trace events of the phases
+    std::string debug_map_path;         // source of each output address
+};
+
+// Returns false if the arguments, program name excluded, are not valid
+bool parse_arguments(const std::vector<std::string>& arguments, driver_options_t& options);
+const char* usage_text();
+
+// Makes every path of the options absolute from a directory
+void make_absolute(driver_options_t& options, const std::string& directory);
+
+// Text of the options which change the output for the same source bytes
+std::string output_settings(const driver_options_t& options);
+
+struct driver_result_t {
+    std::vector<uint8_t> output;            // bytes written
+    std::vector<std::string> dependencies;  // unknown when served from the build cache
+    bool cached = false;
+    std::vector<std::string> messages;
+    stats_t stats;                          // with --stats, the work of this run
+    parse_profile profile;                  // with --profile, the rules tried in this run
+};
+
+// Assembles as the command line asks, include paths are those of the
+// source manager. Returns false on errors, as reported in the messages.
+bool run_driver(const driver_options_t& options, source_manager& sources, driver_result_t& result);
+
+}
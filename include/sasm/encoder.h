@@ -0,0 +1,167 @@
+#pragma once
+
+#include <sasm/mapped_file.h>
+#include <sasm/parser.h>
+#include <sasm/statement.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Part of the output, either owned bytes or a range of a mapped file
+struct fragment_t {
+    std::vector<uint8_t> bytes;
+    std::shared_ptr<const mapped_file> file;
+    size_t file_offset = 0;
+    size_t file_size = 0;
+
+    bool is_file() const { return file != nullptr; }
+    size_t size() const { return is_file() ? file_size : bytes.size(); }
+    std::span<const uint8_t> content() const;
+};
+
+// Value written once its expression can be computed
+struct fixup_t {
+    enum field_kind {
+        u8,         // unsigned byte
+        u16,        // unsigned little endian word
+        i8,         // signed byte, value + bias
+        relative8,  // signed byte, value - address after the field
+    };
+    field_kind field;
+    size_t fragment;    // index in the fragments
+    size_t offset;      // in the fragment
+    size_t address;     // of the field, from the start of the output
+    expression_t expr;
+    value_t bias = 0;
+};
+
+// Writes a value into a field at data, address is the one of the field
+// Returns false if the value does not fit
+bool write_field(fixup_t::field_kind field, value_t value, value_t bias,
+                 size_t address, uint8_t* data);
+
+// Start of the bytes of a statement, up to the next position, at the source
+// position of the statement
+struct output_position_t {
+    size_t address;     // origin included
+    uint32_t source;    // parser_token::source
+    size_t offset;      // parser_token::offset
+};
+
+struct symbol_t {
+    enum symbol_kind {
+        label,      // address, origin included
+        define,     // value of an expression
+    };
+    symbol_kind kind;
+    value_t value;
+    expression_t expr;
+    bool fallen_into = true;    // for labels, if the code before may run into it
+};
+
+// Turns statements into bytes
+//
+// Values that cannot be computed yet are kept as fixups and patched by
+// finish(), binary includes are kept as references to the mapped file and
+// only copied when the output is written.
+//
+// A relocatable encoder does not know where its output will be placed: every
+// label reference is left to the linker, relative branches included, since
+// the linker may move the code between two exported labels.
+class encoder {
+    size_t m_origin;
+    bool m_relocatable;
+    size_t m_size;
+    std::vector<fragment_t> m_fragments;
+    std::vector<fixup_t> m_fixups;
+    std::map<std::string, symbol_t> m_symbols;
+    // Addresses of the local labels by scope and slot, of the anonymous
+    // labels by rank, undefined_label until defined
+    static constexpr value_t undefined_label = std::numeric_limits<value_t>::min();
+    std::vector<std::vector<value_t>> m_local_labels;
+    std::vector<value_t> m_anonymous_labels;
+    std::set<std::string> m_imports;
+    std::set<std::string> m_exports;
+    std::map<std::string, std::shared_ptr<const mapped_file>> m_files;
+    bool m_tracks_positions = false;
+    std::vector<output_position_t> m_positions;
+    bool m_redefined = false;
+    // False after an unconditional jump, until other bytes are emitted
+    bool m_falls_through = false;
+
+    std::vector<uint8_t>& owned_bytes();
+    void emit(uint8_t byte);
+    void emit_word(uint16_t word);
+    bool emit_field(fixup_t::field_kind field, const expression_t& expr, value_t bias = 0);
+    bool write_field(const fixup_t& fixup, value_t value);
+
+    bool lookup(const reference_t& name, value_t& value, bool with_labels, int depth) const;
+    bool evaluate(const expression_t& expr, value_t& value, bool with_labels, int depth) const;
+
+    bool encode_instruction(instruction_set::instruction_name name,
+                            instruction_set::addressing_style style,
+                            const operand_t& operand);
+    bool encode_data(const operand_t& value);
+    bool encode_data_block(const data_block_t& block);
+    bool encode_align(const operand_t& value);
+    bool define_symbol(std::string_view name, symbol_t symbol);
+    bool define_label(expression_item_t::ekind kind, uint32_t scope, value_t slot);
+    bool encode_binary_include(const std::string& path,
+                               const operand_t* offset, const operand_t* length);
+    bool encode_statement(const statement_t& statement, const statement_context& context);
+
+public:
+    explicit encoder(size_t origin = 0, bool relocatable = false);
+
+    // Returns false if the statement cannot be encoded
+    bool encode(const parser_token& token);
+    // Same for a compact statement, its payload in the context. The source
+    // and offset are those of its line, for the positions.
+    bool encode(const statement_t& statement, const statement_context& context,
+                uint32_t source = 0, size_t offset = 0);
+    // True if the last statement encoded failed as it defines a symbol or
+    // a label already defined
+    bool redefined() const;
+
+    // Records the source position of the statements encoded from now on
+    void track_positions();
+    // In increasing addresses, a statement emitting no bytes has none, the
+    // statements of a line share one
+    const std::vector<output_position_t>& positions() const;
+
+    // Patches the fixups which can now be computed
+    // Returns false if some of them remain
+    bool finish();
+
+    // Value of an expression from the symbols known so far
+    bool evaluate(const expression_t& expr, value_t& value) const;
+    bool evaluate(const expression_t& expr, value_t& value, bool with_labels) const;
+
+    size_t origin() const;
+    bool relocatable() const;
+    size_t size() const;
+    const std::vector<fragment_t>& fragments() const;
+    const std::vector<fixup_t>& fixups() const;
+    const std::map<std::string, symbol_t>& symbols() const;
+    // Address of a local or anonymous label, false until defined
+    bool label_address(const expression_item_t& label, value_t& address) const;
+    const std::set<std::string>& imports() const;
+    const std::set<std::string>& exports() const;
+    // Paths given to .incbin
+    std::vector<std::string> binary_includes() const;
+
+    // Output as a single buffer
+    std::vector<uint8_t> flatten() const;
+    // Output to a file, binary includes are copied file to file
+    bool write(const std::string& path) const;
+};
+
+}
@@ -1,42 +1,48 @@
 #pragma once
 
+#include <sasm/allocation.h>
 #include <sasm/assert.h>
 #include <sasm/dtype.h>
 #include <sasm/parser_base.h>
 
+#include <charconv>
+#include <cstdint>
 #include <string>
 #include <deque>
+#include <limits>
 #include <map>
 #include <vector>
 #include <optional>
+#include <utility>
 
 namespace sasm {
 
+// Zero when out of range, or for a prefix with no digits
 static int parse_literal(const std::string& content) {
-    size_t length;
-    if (content[0] == '$') {
-        try {
-            return std::stoi(content.substr(1), &length, 16);
-        }
-        catch (std::out_of_range & e) {
-            return 0;
-        }
-    } else if (content[0] == '%') {
-        try {
-            return std::stoi(content.substr(1), &length, 2);
-        }
-        catch (std::out_of_range & e) {
-            return 0;
-        }
-    } else {
-        try {
-            return std::stoi(content, &length, 10);
-        }
-        catch (std::out_of_range & e) {
-            return 0;
-        }
+    int base = 10;
+    size_t start = 0;
+    if (!content.empty() && (content[0] == '$')) {
+        base = 16;
+        start = 1;
+    } else if (!content.empty() && (content[0] == '%')) {
+        base = 2;
+        start = 1;
     }
-    return 0;
+    int value = 0;
+    const auto result = std::from_chars(content.data() + start, content.data() + content.size(), value, base);
+    return (result.ec == std::errc()) ? value : 0;
+}
+
+// Content of a quoted string literal, with escapes resolved
+inline std::string parse_string(const std::string& content) {
+    std::string result;
+    if (content.size() < 2) return result;
+    result.reserve(content.size() - 2);
+    for (size_t i = 1; i + 1 < content.size(); ++i) {
+        if ((content[i] == '\\') && (i + 2 < content.size())) ++i;
+        result.push_back(content[i]);
+    }
+    return result;
 }
 
 static int parse_sign(const std::string& content) {
@@ -65,53 +71,94 @@ struct operation_t {
     }
 };
 
+// Local labels, @name, are found by their slot in the array of their scope,
+// the global label they follow. Anonymous labels are found by their rank,
+// parsers other than sasm::parser leave them relative: 1 for :+, -2 for :--
 struct expression_item_t {
     enum ekind {
         value, reference, operation,
+        local_label, anonymous_label,
     } kind;
-    value_t val;
+    value_t val;        // value, slot of a local label, rank of an anonymous one
     reference_t ref;
     operation_t op;
+    uint32_t scope = 0; // of a local label
 
     template <ekind K> bool is() const { return kind == K; }
 };
 
 namespace operations {
-    static bool eval_failed(std::vector<expression_item_t>& stack) {
+    inline bool pop_value(std::vector<expression_item_t>& stack, value_t& value) {
+        if (stack.empty()) return false;
+        if (stack.back().kind != expression_item_t::value) return false;
+        value = stack.back().val;
+        stack.pop_back();
+        return true;
+    }
+    inline bool push_value(std::vector<expression_item_t>& stack, value_t value) {
+        expression_item_t item;
+        item.kind = expression_item_t::value;
+        item.val = value;
+        stack.push_back(item);
+        return true;
+    }
+    template <typename F>
+    inline bool eval_binary(std::vector<expression_item_t>& stack, F f) {
+        value_t lhs, rhs;
+        if (!pop_value(stack, rhs) || !pop_value(stack, lhs)) return false;
+        return f(lhs, rhs);
+    }
+
+    inline bool eval_failed(std::vector<expression_item_t>&) {
         return false;
     }
-    static bool eval_identity(std::vector<expression_item_t>& stack) {
+    inline bool eval_identity(std::vector<expression_item_t>& stack) {
         if (stack.size() == 0) return false;
         return true;
     }
-    static bool eval_negation(std::vector<expression_item_t>& stack) {
+    // Results out of the range of value_t fail the evaluation
+    inline bool eval_negation(std::vector<expression_item_t>& stack) {
         if (stack.size() == 0) return false;
-        return false;
+        value_t value, result;
+        return pop_value(stack, value) && !__builtin_sub_overflow(0, value, &result)
+            && push_value(stack, result);
     }
-    static bool eval_addition(std::vector<expression_item_t>& stack) {
+    inline bool eval_addition(std::vector<expression_item_t>& stack) {
         if (stack.size() == 0) return false;
-        return false;
+        return eval_binary(stack, [&] (value_t lhs, value_t rhs) {
+            value_t result;
+            return !__builtin_add_overflow(lhs, rhs, &result) && push_value(stack, result);
+        });
     }
-    static bool eval_subtraction(std::vector<expression_item_t>& stack) {
+    inline bool eval_subtraction(std::vector<expression_item_t>& stack) {
         if (stack.size() == 0) return false;
-        return false;
+        return eval_binary(stack, [&] (value_t lhs, value_t rhs) {
+            value_t result;
+            return !__builtin_sub_overflow(lhs, rhs, &result) && push_value(stack, result);
+        });
     }
-    static bool eval_multiplication(std::vector<expression_item_t>& stack) {
+    inline bool eval_multiplication(std::vector<expression_item_t>& stack) {
         if (stack.size() == 0) return false;
-        return false;
+        return eval_binary(stack, [&] (value_t lhs, value_t rhs) {
+            value_t result;
+            return !__builtin_mul_overflow(lhs, rhs, &result) && push_value(stack, result);
+        });
     }
-    static bool eval_division(std::vector<expression_item_t>& stack) {
+    inline bool eval_division(std::vector<expression_item_t>& stack) {
         if (stack.size() == 0) return false;
-        return false;
+        return eval_binary(stack, [&] (value_t lhs, value_t rhs) {
+            if ((rhs == 0) || ((lhs == std::numeric_limits<value_t>::min()) && (rhs == -1))) return false;
+            return push_value(stack, lhs / rhs);
+        });
     }
 
-    static const operation_t marker { &eval_failed, 100 };
-    static const operation_t identity { &eval_identity, 0, true };
-    static const operation_t negation { &eval_negation, 0, true };
-    static const operation_t addition { &eval_addition, 2 };
-    static const operation_t subtraction { &eval_subtraction, 2 };
-    static const operation_t multiplication { &eval_multiplication, 1 };
-    static const operation_t division { &eval_division, 1 };
+    inline const operation_t marker { &eval_failed, 100 };
+    inline const operation_t identity { &eval_identity, 0, true };
+    inline const operation_t negation { &eval_negation, 0, true };
+    inline const operation_t addition { &eval_addition, 2 };
+    inline const operation_t subtraction { &eval_subtraction, 2 };
+    inline const operation_t multiplication { &eval_multiplication, 1 };
+    inline const operation_t division { &eval_division, 1 };
 }
 
 static expression_item_t marker { expression_item_t::operation,
@@ -131,7 +178,7 @@ static expression_item_t division { expression_item_t::operation,
 
 struct expression_t {
     std::vector<expression_item_t> content;
-    dtype::etype type;
+    dtype::etype type = dtype::any;
 
     bool is_value() const {
         return (content.size() == 1)
@@ -163,7 +210,9 @@ static bool validate(const expression_t& expr) {
     for (const auto& item : expr.content) {
         switch (item.kind) {
             case expression_item_t::value:
-            case expression_item_t::reference: {
+            case expression_item_t::reference:
+            case expression_item_t::local_label:
+            case expression_item_t::anonymous_label: {
                 ++n;
                 break;
             }
@@ -178,6 +227,79 @@ static bool validate(const expression_t& expr) {
     return n == 1;
 }
 
+// Computes the value of an expression
+// lookup(const reference_t&, value_t&) resolves references and
+// label(const expression_item_t&, value_t&) local and anonymous labels,
+// evaluation fails when they return false
+template <typename Lookup, typename Label>
+static bool evaluate(const expression_t& expr, Lookup&& lookup, Label&& label, value_t& result) {
+    std::vector<expression_item_t> stack;
+    for (const auto& item : expr.content) {
+        switch (item.kind) {
+            case expression_item_t::value: {
+                stack.push_back(item);
+                break;
+            }
+            case expression_item_t::reference: {
+                value_t value;
+                if (!lookup(item.ref, value)) return false;
+                operations::push_value(stack, value);
+                break;
+            }
+            case expression_item_t::local_label:
+            case expression_item_t::anonymous_label: {
+                value_t value;
+                if (!label(item, value)) return false;
+                operations::push_value(stack, value);
+                break;
+            }
+            case expression_item_t::operation: {
+                if (!item.op.execute(stack)) return false;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    if ((stack.size() != 1) || !stack.front().is<expression_item_t::value>()) {
+        return false;
+    }
+    result = stack.front().val;
+    return true;
+}
+
+template <typename Lookup>
+static bool evaluate(const expression_t& expr, Lookup&& lookup, value_t& result) {
+    return evaluate(expr, std::forward<Lookup>(lookup),
+                    [] (const expression_item_t&, value_t&) { return false; }, result);
+}
+
+static bool evaluate(const expression_t& expr, value_t& result) {
+    return evaluate(expr, [] (const reference_t&, value_t&) { return false; }, result);
+}
+
+// :+ and :- with the sign repeated, without blanks, for each label skipped
+static bool try_parse_anonymous_label(parser_base_t& p, expression_item_t& item) {
+    using enum lexer_token::token_type;
+    const auto sign = p.stage_token();
+    if (!sign.is<symbol>("+", "-") || sign.whitespace_before) {
+        p.unstage_token();
+        return false;
+    }
+    value_t count = 1;
+    while (true) {
+        const auto next = p.stage_token();
+        if (!next.is<symbol>(sign.content) || next.whitespace_before) {
+            p.unstage_token();
+            break;
+        }
+        ++count;
+    }
+    item.kind = expression_item_t::anonymous_label;
+    item.val = sign.is<symbol>("+") ? count : -count;
+    return true;
+}
+
 static std::optional<expression_item_t> try_get_operation(const lexer_token& token, bool allow_unary) {
     using enum lexer_token::token_type;
     /*if (token.is<symbol>("(")) {
@@ -196,9 +318,12 @@ static std::optional<expression_item_t> try_get_operation(const lexer_token& tok
 
 static bool try_parse_expression(parser_base_t& p, expression_t& expr) {
     using enum lexer_token::token_type;
+    allocation_scope scope(allocation_stage::expression);
     p.push_scope();
     expr.content.clear();
     std::vector<expression_item_t> op_stack;
+    const auto max_nesting = p.limits().max_nesting;
+    size_t nesting = 0;
     {
         bool allow_unary = true;
         std::optional<expression_item_t> operation;
@@ -206,7 +331,14 @@ static bool try_parse_expression(parser_base_t& p, expression_t& expr) {
         bool keep_parsing = true;
         while (keep_parsing) {
             auto token = p.stage_token();
+            expression_item_t anonymous;
             if (token.is<symbol>("(")) {
+                // Given up at once, the rules trying the line again stop there too
+                if ((max_nesting > 0) && (++nesting > max_nesting)) {
+                    p.report_limit(token, diagnostic_code::nesting_too_deep, max_nesting);
+                    p.cancel_scope();
+                    return false;
+                }
                 op_stack.push_back(marker);
                 allow_unary = true;
             } else if (token.is<symbol>(")")) {
@@ -220,6 +352,7 @@ static bool try_parse_expression(parser_base_t& p, expression_t& expr) {
                     op_stack.pop_back();
                     assert(op.is<expression_item_t::operation>());
                     if (op.op == operations::marker) {
+                        --nesting;
                         break;
                     }
                     expr.content.push_back(op);
@@ -235,6 +368,9 @@ static bool try_parse_expression(parser_base_t& p, expression_t& expr) {
                 }
                 op_stack.push_back(*operation);
                 allow_unary = true;
+            } else if (token.is<symbol>(":") && try_parse_anonymous_label(p, anonymous)) {
+                expr.content.push_back(anonymous);
+                allow_unary = false;
             } else if (token.is<identifier>()) {
                 expression_item_t item;
                 item.kind = expression_item_t::reference;
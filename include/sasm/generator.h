@@ -0,0 +1,158 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace sasm {
+
+// Lazy sequence of values produced by a coroutine.
+//
+// The coroutine frame is allocated from the std::pmr::memory_resource passed
+// as the last coroutine argument (after the object for member coroutines),
+// or from the default resource when there is none. The resource is stored
+// right after the frame so that it can be found again on destruction.
+template <typename T>
+class generator {
+public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct promise_type {
+        T* m_value = nullptr;
+        std::exception_ptr m_exception;
+
+        generator get_return_object() {
+            return generator(handle_type::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        std::suspend_always yield_value(T& value) noexcept {
+            m_value = std::addressof(value);
+            return {};
+        }
+        std::suspend_always yield_value(T&& value) noexcept {
+            m_value = std::addressof(value);
+            return {};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { m_exception = std::current_exception(); }
+
+        static void* operator new(size_t size) {
+            return allocate(size, std::pmr::get_default_resource());
+        }
+        static void* operator new(size_t size,
+                                  std::pmr::memory_resource* resource) {
+            return allocate(size, resource);
+        }
+        // Object of a member coroutine, a template operator new would not be
+        // seen by GCC 12 as pairing with the operator delete
+        struct object_argument {
+            template <typename Self>
+            object_argument(Self&) {}
+        };
+        static void* operator new(size_t size,
+                                  object_argument,
+                                  std::pmr::memory_resource* resource) {
+            return allocate(size, resource);
+        }
+        static void operator delete(void* frame, size_t size) {
+            const auto offset = resource_offset(size);
+            auto resource = *reinterpret_cast<std::pmr::memory_resource**>(
+                static_cast<std::byte*>(frame) + offset);
+            resource->deallocate(frame, offset + sizeof(resource), frame_alignment);
+        }
+
+    private:
+        static constexpr size_t frame_alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+        static constexpr size_t resource_offset(size_t size) {
+            constexpr auto align = alignof(std::pmr::memory_resource*);
+            return (size + align - 1) & ~(align - 1);
+        }
+        static void* allocate(size_t size, std::pmr::memory_resource* resource) {
+            const auto offset = resource_offset(size);
+            void* frame = resource->allocate(offset + sizeof(resource), frame_alignment);
+            ::new (static_cast<std::byte*>(frame) + offset)
+                std::pmr::memory_resource*(resource);
+            return frame;
+        }
+    };
+
+    class iterator {
+        handle_type m_handle;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+        using reference = T&;
+        using pointer = T*;
+
+        iterator() = default;
+        explicit iterator(handle_type handle) : m_handle(handle) {}
+
+        reference operator*() const { return *m_handle.promise().m_value; }
+        pointer operator->() const { return m_handle.promise().m_value; }
+
+        iterator& operator++() {
+            m_handle.resume();
+            rethrow_if_failed(m_handle);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const {
+            return !m_handle || m_handle.done();
+        }
+    };
+
+    generator() = default;
+    generator(generator&& other) noexcept
+    : m_handle(std::exchange(other.m_handle, nullptr))
+    {}
+    generator& operator=(generator&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    generator(const generator&) = delete;
+    generator& operator=(const generator&) = delete;
+    ~generator() { destroy(); }
+
+    iterator begin() {
+        if (m_handle) {
+            m_handle.resume();
+            rethrow_if_failed(m_handle);
+        }
+        return iterator(m_handle);
+    }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    handle_type m_handle;
+
+    explicit generator(handle_type handle) : m_handle(handle) {}
+
+    void destroy() {
+        if (m_handle) m_handle.destroy();
+        m_handle = nullptr;
+    }
+
+    static void rethrow_if_failed(handle_type handle) {
+        if (handle.done() && handle.promise().m_exception) {
+            std::rethrow_exception(handle.promise().m_exception);
+        }
+    }
+};
+
+}
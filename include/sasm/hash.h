@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace sasm {
+
+// XXH64 of a buffer
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
+
+// Hash of several parts, each hashed on its own then combined
+class hash_builder {
+    std::vector<uint64_t> m_parts;
+
+public:
+    hash_builder& add(std::span<const uint8_t> bytes);
+    hash_builder& add(std::string_view text);
+    hash_builder& add(uint64_t value);
+
+    uint64_t digest() const;
+};
+
+}
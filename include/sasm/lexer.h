@@ -1,7 +1,11 @@
 #pragma once
 
+#include <sasm/generator.h>
 #include <sasm/reader.h>
 
+#include <cstdint>
+#include <memory_resource>
+
 namespace sasm {
 
 struct lexer_token {
@@ -15,6 +19,7 @@ struct lexer_token {
         literal,
         keyword,
         symbol,
+        string_literal,
     };
     token_type type;
     std::string content;
@@ -23,6 +28,7 @@ struct lexer_token {
     bool whitespace_before;
     bool first_on_line;
     bool is_trivia;
+    uint32_t source = 0;    // id of the file in the source manager, 0 if none
 
     bool eof() const;
     template <token_type kind> bool is() const {
@@ -56,11 +62,24 @@ class lexer {
     static bool is_binary_head(char c);
     static bool is_binary(char c);
     static bool is_symbol(char c);
+    static bool is_string_delimiter(char c);
+    static bool is_string_escape(char c);
+
+    lexer_token read();
 
 public:
     explicit lexer(reader* reader);
 
     lexer_token get();
+
+    // From the start of a line, skips the lines which do not start with a
+    // directive, looking only for line ends in the raw bytes
+    void skip_to_directive_line();
+
+    // Lazily yields every token up to, but not including, end of file.
+    // The coroutine frame is allocated from the given resource.
+    generator<lexer_token> tokens(
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 };
 
 }
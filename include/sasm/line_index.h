@@ -0,0 +1,54 @@
+#pragma once
+
+#include <sasm/mapped_file.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace sasm {
+
+// From 1, the column in bytes
+struct line_column_t {
+    size_t line;
+    size_t column;
+
+    bool operator==(const line_column_t&) const = default;
+};
+
+// Lines of a buffer, for the line and column of byte offsets
+//
+// The offsets at which lines start are found on first use, by a vectorized
+// scan for line feeds, so that a buffer without diagnostics is never
+// scanned. Each lookup is then a binary search. The index may be shared by
+// threads.
+class line_index {
+    std::shared_ptr<const mapped_file> m_file;  // kept mapped for the scan, if any
+    const char* m_data;
+    size_t m_size;
+    mutable std::once_flag m_built;
+    mutable std::vector<size_t> m_starts;
+
+    const std::vector<size_t>& starts() const;
+
+public:
+    // Lines of a file, which stays mapped as long as the index
+    explicit line_index(std::shared_ptr<const mapped_file> file);
+    // Lines of a buffer, which must outlive the index
+    line_index(const char* data, size_t size);
+
+    line_column_t locate(size_t offset) const;
+    // Offsets in increasing order are each searched from the line of the
+    // previous one, any other order is slower only
+    std::vector<line_column_t> locate(std::span<const size_t> offsets) const;
+
+    // A line feed ending the buffer starts an empty line
+    size_t lines() const;
+};
+
+// Appends the offset following each line feed of the buffer
+void find_line_starts(const char* data, size_t size, std::vector<size_t>& starts);
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <sasm/object.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sasm {
+
+// Exported symbol, by module and index in the module symbols
+struct export_ref_t {
+    uint32_t module;
+    uint32_t symbol;
+};
+
+// Concurrent map of exported symbols
+//
+// Names are spread over independently locked shards so that modules can
+// insert their exports in parallel. Names are views in the mapped objects.
+class export_table {
+    static constexpr size_t shard_count = 64;
+
+    struct alignas(64) shard_t {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, export_ref_t> symbols;
+    };
+    std::array<shard_t, shard_count> m_shards;
+
+    shard_t& shard(std::string_view name);
+    const shard_t& shard(std::string_view name) const;
+
+public:
+    // Returns false and the current entry if the name is already present
+    bool insert(std::string_view name, export_ref_t ref, export_ref_t& existing);
+    // Not synchronized with insert(), only used once all exports are in
+    const export_ref_t* find(std::string_view name) const;
+    void erase(std::string_view name);
+    void clear();
+    size_t size() const;
+};
+
+// Part of a section placed as a whole
+//
+// Without garbage collection a region is a whole section. With it, sections
+// are cut at the exported labels which follow an unconditional jump, so
+// that no code runs from one region into the next.
+struct region_t {
+    uint32_t section;
+    uint32_t offset;    // in the section
+    uint32_t size;
+    size_t address = 0;
+    bool live = true;
+};
+
+// Object file being linked
+struct link_module_t {
+    static constexpr size_t no_region = size_t(-1);
+
+    std::string path;
+    object_file file;
+    std::vector<region_t> regions;          // by section, then offset
+    std::vector<size_t> section_regions;    // first region of each section, then the count
+    std::vector<uint32_t> relocations;      // relocation indices by region
+    std::vector<size_t> region_relocations; // first of each region, then the count
+    std::vector<size_t> symbol_regions;     // region of each symbol, no_region for constants
+    std::vector<export_ref_t> imports;      // definition of each import
+};
+
+// Links relocatable objects into a flat binary
+//
+// Modules are placed one after the other from the origin, in the given
+// order. Loading, collecting exports, resolving imports and relocating are
+// each done on all modules in parallel, every module writing its own part
+// of the output.
+//
+// When entry symbols are given, only the regions reachable from them
+// through relocations are kept.
+class linker {
+    size_t m_origin;
+    size_t m_threads;
+    std::vector<std::string> m_entries;
+    std::vector<std::string> m_paths;
+    std::vector<std::unique_ptr<link_module_t>> m_modules;
+    export_table m_exports;
+    std::vector<uint8_t> m_output;
+    size_t m_reclaimed;
+    size_t m_reclaimed_regions;
+    size_t m_relocated;
+    bool m_linked;
+    std::mutex m_errors_mutex;
+    std::vector<std::string> m_errors;
+
+    void error(std::string message);
+    bool symbol_value(const link_module_t& module, uint32_t index, value_t& value) const;
+
+    bool load(const std::vector<std::string>& paths);
+    bool collect_exports();
+    bool resolve_imports();
+    void partition_module(link_module_t& module);
+    void partition();
+    bool collect_garbage();
+    void layout();
+    bool relocate(const std::vector<size_t>& modules);
+
+public:
+    // threads = 0 uses every core
+    explicit linker(size_t origin = 0, size_t threads = 0);
+
+    // Enables garbage collection, keeping what these exports reference
+    void add_entry(const std::string& name);
+
+    // Returns false if some objects cannot be loaded or linked
+    bool link(const std::vector<std::string>& paths);
+
+    // Reloads the objects of these modules after a successful link. When
+    // their sizes and exports did not change, only they are relocated,
+    // otherwise everything is linked again.
+    bool relink(const std::vector<size_t>& changed);
+    // True if the last link or relink succeeded
+    bool linked() const;
+
+    const std::vector<std::unique_ptr<link_module_t>>& modules() const;
+    const export_table& exports() const;
+    const std::vector<uint8_t>& output() const;
+    // Sorted, as they are found in parallel
+    const std::vector<std::string>& errors() const;
+
+    // Bytes and regions dropped by garbage collection
+    size_t reclaimed() const;
+    size_t reclaimed_regions() const;
+
+    // Modules relocated by the last link
+    size_t relocated() const;
+
+    bool write(const std::string& path) const;
+};
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Read-only view of a whole file, memory mapped where available
+class mapped_file {
+    const uint8_t* m_data;
+    size_t m_size;
+    int m_descriptor;
+    bool m_open;
+    std::vector<uint8_t> m_fallback;
+
+    void close();
+
+public:
+    mapped_file();
+    ~mapped_file();
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    // The descriptor is closed once the file is mapped, unless kept
+    bool open(const std::string& path, bool keep_descriptor = false);
+    bool is_open() const;
+
+    const uint8_t* data() const;
+    size_t size() const;
+    std::span<const uint8_t> bytes() const;
+
+    // Descriptor of the open file, -1 when not kept or not available
+    int descriptor() const;
+};
+
+}
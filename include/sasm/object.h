@@ -0,0 +1,238 @@
+#pragma once
+
+#include <sasm/encoder.h>
+#include <sasm/mapped_file.h>
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sasm {
+
+// Relocatable object file
+//
+// The file is designed to be used in place once mapped: every table is an
+// array of fixed size little endian records at an aligned offset from the
+// start of the file, and records refer to each other by index or offset,
+// never by address.
+//
+//   header
+//   sections       object_section[section_count]
+//   symbols        object_symbol[symbol_count], sorted by name
+//   imports        object_import[import_count]
+//   relocations    object_relocation[relocation_count]
+//   expressions    object_rpn_item[expression_count]
+//   strings        names, not null terminated
+//   section data
+namespace object_format {
+
+static_assert(std::endian::native == std::endian::little,
+              "object files are used in place and are little endian");
+
+static constexpr char magic[8] = { 'S', 'A', 'S', 'M', 'O', 'B', 'J', '\0' };
+static constexpr uint32_t version = 1;
+static constexpr uint32_t table_alignment = 8;
+static constexpr uint32_t data_alignment = 16;
+static constexpr uint16_t absolute_section = 0xFFFF;
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t section_count, section_offset;
+    uint32_t symbol_count, symbol_offset;
+    uint32_t import_count, import_offset;
+    uint32_t relocation_count, relocation_offset;
+    uint32_t expression_count, expression_offset;
+    uint32_t string_size, string_offset;
+};
+static_assert(sizeof(header) == 64);
+
+struct string_ref {
+    uint32_t offset;    // in the string table
+    uint32_t length;
+};
+
+struct section {
+    string_ref name;
+    uint32_t data_offset;   // from the start of the file
+    uint32_t size;
+};
+static_assert(sizeof(section) == 16);
+
+struct symbol {
+    enum symbol_kind : uint8_t {
+        label,      // value is an offset in the section
+        constant,   // value is absolute
+    };
+    enum symbol_flags : uint8_t {
+        exported = 1,
+        entered = 2,    // label the code before cannot run into
+    };
+    string_ref name;
+    int32_t value;
+    uint16_t section;       // absolute_section for constants
+    symbol_kind kind;
+    uint8_t flags;
+
+    bool is_exported() const { return (flags & exported) != 0; }
+    bool is_entered() const { return (flags & entered) != 0; }
+};
+static_assert(sizeof(symbol) == 16);
+
+struct import {
+    string_ref name;
+};
+static_assert(sizeof(import) == 8);
+
+struct relocation {
+    uint32_t section;
+    uint32_t offset;            // of the field, in the section
+    uint8_t field;              // fixup_t::field_kind
+    uint8_t reserved[3];
+    int32_t bias;
+    uint32_t expression;        // first item
+    uint32_t expression_count;
+};
+static_assert(sizeof(relocation) == 24);
+
+// Expression in reverse polish notation
+struct rpn_item {
+    enum item_kind : uint8_t {
+        value,      // val is the value
+        symbol,     // val is an index in the symbols
+        import,     // val is an index in the imports
+        operation,  // op is an operation_code
+    };
+    enum operation_code : uint8_t {
+        identity, negation,
+        addition, subtraction,
+        multiplication, division,
+    };
+    item_kind kind;
+    operation_code op;
+    uint8_t reserved[2];
+    int32_t val;
+};
+static_assert(sizeof(rpn_item) == 8);
+
+}
+
+// Serializes the output of a relocatable encoder, after finish()
+// Returns false if the content cannot be represented
+bool write_object(const encoder& encoder, std::vector<uint8_t>& output);
+bool write_object(const encoder& encoder, const std::string& path);
+
+// Object file used in place
+class object_view {
+    std::span<const uint8_t> m_data;
+
+    bool invalid();
+
+    template <typename T>
+    std::span<const T> table(uint32_t offset, uint32_t count) const {
+        return { reinterpret_cast<const T*>(m_data.data() + offset), count };
+    }
+
+public:
+    // Validates the layout, returns false if the content is not an object
+    bool open(std::span<const uint8_t> data);
+
+    const object_format::header& header() const;
+    std::span<const object_format::section> sections() const;
+    std::span<const object_format::symbol> symbols() const;
+    std::span<const object_format::import> imports() const;
+    std::span<const object_format::relocation> relocations() const;
+
+    std::span<const uint8_t> data(const object_format::section& section) const;
+    std::span<const object_format::rpn_item> expression(
+        const object_format::relocation& relocation) const;
+    std::string_view string(const object_format::string_ref& ref) const;
+
+    // Binary search in the sorted symbols, nullptr when not found
+    const object_format::symbol* find_symbol(std::string_view name) const;
+};
+
+// Object file mapped from disk
+class object_file {
+    mapped_file m_file;
+    object_view m_view;
+
+public:
+    bool open(const std::string& path);
+    const object_view& view() const;
+};
+
+// Computes a relocation expression
+// symbol(index, value&) and import(index, value&) resolve references
+template <typename SymbolLookup, typename ImportLookup>
+bool evaluate(std::span<const object_format::rpn_item> expression,
+              SymbolLookup&& symbol,
+              ImportLookup&& import,
+              value_t& result) {
+    using item_t = object_format::rpn_item;
+    static constexpr size_t max_stack = 64;
+    value_t stack[max_stack];
+    size_t size = 0;
+    for (const auto& item : expression) {
+        value_t value = item.val;
+        switch (item.kind) {
+            case item_t::value: break;
+            case item_t::symbol: {
+                if (!symbol(item.val, value)) return false;
+                break;
+            }
+            case item_t::import: {
+                if (!import(item.val, value)) return false;
+                break;
+            }
+            case item_t::operation: {
+                if (item.op <= item_t::negation) {
+                    if (size < 1) return false;
+                    if ((item.op == item_t::negation)
+                        && __builtin_sub_overflow(0, stack[size - 1], &stack[size - 1])) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (size < 2) return false;
+                const auto rhs = stack[--size];
+                auto& lhs = stack[size - 1];
+                switch (item.op) {
+                    case item_t::addition: {
+                        if (__builtin_add_overflow(lhs, rhs, &lhs)) return false;
+                        break;
+                    }
+                    case item_t::subtraction: {
+                        if (__builtin_sub_overflow(lhs, rhs, &lhs)) return false;
+                        break;
+                    }
+                    case item_t::multiplication: {
+                        if (__builtin_mul_overflow(lhs, rhs, &lhs)) return false;
+                        break;
+                    }
+                    case item_t::division: {
+                        if ((rhs == 0) || ((lhs == std::numeric_limits<value_t>::min()) && (rhs == -1))) return false;
+                        lhs = lhs / rhs;
+                        break;
+                    }
+                    default: return false;
+                }
+                continue;
+            }
+            default:
+                return false;
+        }
+        if (size == max_stack) return false;
+        stack[size++] = value;
+    }
+    if (size != 1) return false;
+    result = stack[0];
+    return true;
+}
+
+}
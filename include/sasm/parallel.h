@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace sasm {
+
+// Number of threads to use when none is given, at least 1
+inline size_t default_thread_count() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Calls f(i) for every i in [0, count) on up to `threads` threads
+//
+// Indices are handed out one at a time, so that items of uneven cost are
+// balanced. The calling thread takes part, and everything is done on return.
+template <typename F>
+void parallel_for(size_t count, F&& f, size_t threads = 0) {
+    if (threads == 0) threads = default_thread_count();
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) f(i);
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    const auto work = [&] {
+        for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1)) f(i);
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+}
+
+}
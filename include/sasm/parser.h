@@ -1,28 +1,47 @@
 #pragma once
 
+#include <sasm/allocation.h>
 #include <sasm/dtype.h>
 #include <sasm/lexer.h>
 #include <sasm/parser_base.h>
 #include <sasm/expression.h>
+#include <sasm/generator.h>
+#include <sasm/source_manager.h>
+#include <sasm/stats.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
-#include <deque>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
 #include <vector>
 
 namespace sasm {
 
 using operand_t = expression_t;
 
+// Contiguous run of plain .byte or .word values
+using data_block_t = std::variant<std::vector<uint8_t>, std::vector<uint16_t>>;
+
 class parser;
 class lighweight_parser {
     friend parser;
     parser& m_parser;
+    parser_base_t& m_base;
     explicit lighweight_parser(parser& p);
 public:
     void reset();
     lexer_token get();
     bool try_get_operand(operand_t& operand, dtype::etype type = dtype::any);
+
+    template <typename rule_f>
+    bool profile_rule(parse_rule rule, rule_f parse) {
+        return m_base.profile_rule(rule, parse);
+    }
 };
 
 namespace instruction_set {
@@ -83,7 +102,7 @@ static bool is_zeropage(int address) { return dtype::is_u8(address); }
 
 static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
     using enum lexer_token::token_type;
-    { // relative
+    if (p.profile_rule(parse_rule::relative, [&] { // relative
         lexer_token ident, sign, offset;
         if ((ident = p.get()).is<identifier>()
             && p.get().is<symbol>("*")
@@ -97,9 +116,10 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             }
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // indirect y
+    if (p.profile_rule(parse_rule::indirect_y, [&] { // indirect y
         lexer_token ident;
         if ((ident = p.get()).is<identifier>()
             && p.get().is<symbol>("(")
@@ -112,9 +132,10 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             instr.style = addressing_style::indirect_y;
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // indirect x
+    if (p.profile_rule(parse_rule::indirect_x, [&] { // indirect x
         lexer_token ident;
         if ((ident = p.get()).is<identifier>()
             && p.get().is<symbol>("(")
@@ -127,9 +148,10 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             instr.style = addressing_style::indirect_x;
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // indirect
+    if (p.profile_rule(parse_rule::indirect, [&] { // indirect
         lexer_token ident;
         if ((ident = p.get()).is<identifier>()
             && p.get().is<symbol>("(")
@@ -140,9 +162,10 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             instr.style = addressing_style::indirect;
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // absolute_x, absolute_y, zeropage_x, zeropage_y
+    if (p.profile_rule(parse_rule::direct_indexed, [&] { // absolute_x, absolute_y, zeropage_x, zeropage_y
         lexer_token ident, index;
         if ((ident = p.get()).is<identifier>()
             && p.try_get_operand(instr.operand)
@@ -162,9 +185,10 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             }
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // absolute, zeropage, relative
+    if (p.profile_rule(parse_rule::direct, [&] { // absolute, zeropage, relative
         lexer_token ident, index;
         if ((ident = p.get()).is<identifier>()
             && p.try_get_operand(instr.operand)
@@ -176,9 +200,10 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             }
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // immediate
+    if (p.profile_rule(parse_rule::immediate, [&] { // immediate
         lexer_token ident, index;
         operand_t address;
         if ((ident = p.get()).is<identifier>()
@@ -189,16 +214,18 @@ static bool try_parse_instruction(lighweight_parser& p, instruction& instr) {
             instr.style = addressing_style::immediate;
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
-    { // implied, accumulator
+    if (p.profile_rule(parse_rule::implied, [&] { // implied, accumulator
         lexer_token ident, address, index;
         if ((ident = p.get()).is<identifier>()) {
             instr.name = parse_operation(ident.content);
             instr.style = addressing_style::no_op;
             return true;
         }
-    }
+        return false;
+    })) return true;
     p.reset();
     return false;
 }
@@ -210,17 +237,27 @@ struct parser_token {
         unknown,
         end_of_file,
         instruction,
-        label,
-        define, align, data, import_symbol, export_symbol,
+        label, local_label, anonymous_label,
+        define, align, data, data_block, import_symbol, export_symbol,
+        binary_include,
     };
     statement_kind kind;
+    // First token of the line, in the file of that id in the source manager,
+    // and offset. Lines of macros and repeats are those of their bodies.
+    uint32_t source = 0;
+    size_t offset = 0;
 
     instruction_set::instruction instr;
     operand_t operand;
     std::string content;
+    // Values of a data block, or arguments of a binary include
+    std::variant<data_block_t, std::vector<operand_t>> payload;
 
     bool eof() const { return kind == end_of_file; }
 
+    const data_block_t& block() const { return std::get<data_block_t>(payload); }
+    const std::vector<operand_t>& arguments() const { return std::get<std::vector<operand_t>>(payload); }
+
     template <statement_kind K>
     static parser_token make() {
         parser_token token;
@@ -246,11 +283,28 @@ struct parser_token {
     static parser_token make_eof() { return make<end_of_file>(); }
 
     static parser_token make_label(const std::string& name) { return make<label>(name); }
+    // The operand is the label item, as references to it are
+    static parser_token make_local_label(const expression_item_t& item) {
+        auto token = make<local_label>(item.ref);
+        token.operand.content.push_back(item);
+        return token;
+    }
+    static parser_token make_anonymous_label(const expression_item_t& item) {
+        auto token = make<anonymous_label>();
+        token.operand.content.push_back(item);
+        return token;
+    }
     static parser_token make_import(const std::string& name) { return make<import_symbol>(name); }
     static parser_token make_export(const std::string& name) { return make<export_symbol>(name); }
 
     static parser_token make_alignment(const operand_t& value) { return make<align>(value); }
     static parser_token make_data(const operand_t& value) { return make<data>(value); }
+
+    static parser_token make_data_block(data_block_t&& block) {
+        auto token = make<data_block>();
+        token.payload = std::move(block);
+        return token;
+    }
     
     static parser_token make_define(const std::string& name, const operand_t& value) {
         auto token = make<define>(name);
@@ -258,6 +312,13 @@ struct parser_token {
         return token;
     }
 
+    static parser_token make_binary_include(const std::string& path,
+                                            const std::vector<operand_t>& arguments) {
+        auto token = make<binary_include>(path);
+        token.payload = arguments;
+        return token;
+    }
+
     static parser_token make_instruction(const instruction_set::instruction& instr) {
         auto token = make<instruction>();
         token.instr = instr;
@@ -266,33 +327,219 @@ struct parser_token {
 
 };
 
+// Body of a .macro, lexed once
+//
+// Expanding copies the body tokens, with the tokens of the arguments in place
+// of the parameters. The positions of the parameters are found when the macro
+// is defined, an expansion only copies runs of tokens.
+struct macro_t {
+    struct substitution_t {
+        size_t position;    // in the body
+        size_t parameter;
+    };
+    std::vector<std::string> parameters;
+    token_array_t body;
+    std::vector<substitution_t> substitutions;
+
+    std::shared_ptr<const token_array_t> expand(const std::vector<token_array_t>& arguments) const {
+        auto expansion = std::make_shared<token_array_t>();
+        size_t size = body.size();
+        for (const auto& substitution : substitutions) {
+            size += arguments[substitution.parameter].size() - 1;
+        }
+        expansion->reserve(size);
+        size_t from = 0;
+        for (const auto& substitution : substitutions) {
+            const auto& argument = arguments[substitution.parameter];
+            expansion->insert(expansion->end(), body.begin() + from, body.begin() + substitution.position);
+            expansion->insert(expansion->end(), argument.begin(), argument.end());
+            from = substitution.position + 1;
+        }
+        expansion->insert(expansion->end(), body.begin() + from, body.end());
+        return expansion;
+    }
+};
+
 class parser : public parser_base_t {
 public:
-    explicit parser(lexer* lexer)
-    : parser_base_t(lexer)
+    explicit parser(lexer* lexer, source_manager* sources = nullptr,
+                    const parse_limits_t& limits = {})
+    : parser_base_t(lexer, limits)
+    , m_head(0)
+    , m_sources(sources)
     {}
 
-    std::deque<parser_token> m_tokens;
+    // Nesting of included files and macro expansions, against cycles
+    static constexpr size_t max_include_depth = 64;
+
+    // Statements of the current line, m_head is the next one to deliver.
+    // The storage is reused from one line to the next.
+    std::vector<parser_token> m_tokens;
+    size_t m_head;
+
+    // Files included so far, as resolved by the source manager, and the
+    // paths searched for those not found
+    source_manager* m_sources;
+    std::vector<std::string> m_includes;
+
+    std::unordered_map<std::string, std::shared_ptr<const macro_t>> m_macros;
+    // Names given to .define, and the plain values among them for the
+    // expressions computed while parsing
+    std::unordered_set<std::string> m_defines;
+    std::unordered_map<std::string, value_t> m_constants;
+    // Conditional blocks whose active branch is being parsed, innermost
+    // last. A block is closed in the file or expansion it was opened in.
+    struct condition_t {
+        uint64_t input;
+        uint32_t source;        // of the .if, for diagnostics
+        size_t offset;
+        bool else_seen;
+    };
+    std::vector<condition_t> m_conditions;
 
+    // Local labels get a slot in their scope as first seen, names are only
+    // kept for the current scope. Anonymous labels are counted.
+    uint32_t m_scope = 0;
+    uint32_t m_scope_count = 0;
+    std::unordered_map<std::string, uint32_t> m_local_slots;
+    value_t m_anonymous_labels = 0;
+
+    // Each macro expansion and repeat iteration has scopes of its own, those
+    // of the expansions or files around it are kept until it ends
+    struct label_scope_t {
+        uint64_t expansion;
+        uint32_t scope;
+        std::unordered_map<std::string, uint32_t> slots;
+    };
+    uint64_t m_expansion = 0;
+    std::vector<label_scope_t> m_outer_scopes;
+
+    void sync_label_scope() {
+        const auto current = current_expansion();
+        while ((current != m_expansion) && !m_outer_scopes.empty()
+               && (!expansion_active(m_expansion) || (m_outer_scopes.back().expansion == current))) {
+            auto& outer = m_outer_scopes.back();
+            m_expansion = outer.expansion;
+            m_scope = outer.scope;
+            m_local_slots = std::move(outer.slots);
+            m_outer_scopes.pop_back();
+        }
+        if (current == m_expansion) return;
+        m_outer_scopes.push_back({ m_expansion, m_scope, std::move(m_local_slots) });
+        m_expansion = current;
+        m_scope = ++m_scope_count;
+        m_local_slots.clear();
+    }
+
+    static bool is_local_label(const std::string& name) {
+        return !name.empty() && (name[0] == '@');
+    }
+    expression_item_t local_label(const std::string& name) {
+        sync_label_scope();
+        const auto slot = static_cast<uint32_t>(m_local_slots.size());
+        expression_item_t item;
+        item.kind = expression_item_t::local_label;
+        item.val = static_cast<value_t>(m_local_slots.try_emplace(name, slot).first->second);
+        item.ref = name;
+        item.scope = m_scope;
+        return item;
+    }
+
+    // Value of an expression of literals, loop variables and plain defines
+    bool constant_value(const expression_t& expression, value_t& value) const {
+        return evaluate(expression, [this] (const reference_t& name, value_t& result) {
+            const auto it = m_constants.find(name);
+            if (it == m_constants.end()) return false;
+            result = it->second;
+            return true;
+        }, value);
+    }
+
+    // A colon followed by a sign without blanks is an anonymous reference
+    bool parse_label_colon() {
+        using enum lexer_token::token_type;
+        if (!stage_token().is<symbol>(":")) return false;
+        const auto next = stage_token();
+        unstage_token();
+        return !next.is<symbol>("+", "-") || next.whitespace_before;
+    }
     bool parse_label() {
         using enum lexer_token::token_type;
         push_scope();
         lexer_token ident;
         if ((ident = stage_token()).is<identifier>()
-            && stage_token().is<symbol>(":")
+            && parse_label_colon()
         ) {
             accept();
+            if (is_local_label(ident.content)) {
+                m_tokens.push_back(
+                    parser_token::make_local_label(local_label(ident.content))
+                );
+                return true;
+            }
+            // Starts the scope of the local labels which follow
+            sync_label_scope();
+            m_scope = ++m_scope_count;
+            m_local_slots.clear();
             m_tokens.push_back(
                 parser_token::make_label(ident.content)
             );
             return true;
         }
         cancel_scope();
+        push_scope();
+        if (parse_label_colon()) {
+            accept();
+            expression_item_t item;
+            item.kind = expression_item_t::anonymous_label;
+            item.val = m_anonymous_labels++;
+            m_tokens.push_back(
+                parser_token::make_anonymous_label(item)
+            );
+            return true;
+        }
+        cancel_scope();
         return false;
     }
     bool try_parse_operand(operand_t& operand, dtype::etype type = dtype::any) {
         operand.type = type;
-        return try_parse_expression(*this, operand);
+        const auto valid = try_parse_expression(*this, operand);
+        if (valid) resolve_labels(operand);
+        if (valid && has_bound_variables()) bind_variables(operand);
+        return valid;
+    }
+    // Local labels get their slot, anonymous labels their rank
+    void resolve_labels(operand_t& operand) {
+        for (auto& item : operand.content) {
+            if (item.is<expression_item_t::reference>() && is_local_label(item.ref)) {
+                item = local_label(item.ref);
+            } else if (item.is<expression_item_t::anonymous_label>()) {
+                item.val += (item.val > 0) ? m_anonymous_labels - 1 : m_anonymous_labels;
+            }
+        }
+    }
+    // Loop variables become values, and the expressions they leave without
+    // references are computed
+    void bind_variables(operand_t& operand) const {
+        bool bound = false;
+        bool constant = true;
+        for (auto& item : operand.content) {
+            if (!item.is<expression_item_t::reference>()) continue;
+            size_t value;
+            if (bound_value(item.ref, value)) {
+                item.kind = expression_item_t::value;
+                item.val = static_cast<value_t>(value);
+                item.ref.clear();
+                bound = true;
+            } else {
+                constant = false;
+            }
+        }
+        value_t value;
+        if (bound && constant && operand.is_expression() && evaluate(operand, value)) {
+            operand.content.resize(1);
+            operand.content.front().val = value;
+        }
     }
     bool parse_define() {
         using enum lexer_token::token_type;
@@ -305,6 +552,10 @@ public:
             && try_parse_operand(definition)
         ) {
             accept();
+            m_defines.insert(name.content);
+            if (definition.is_value()) {
+                m_constants[name.content] = definition.get_value();
+            }
             m_tokens.push_back(
                 parser_token::make_define(name.content, definition)
             );
@@ -337,31 +588,80 @@ public:
             cancel_scope();
         }
     }
+    // Plain literal directly followed by a separator, which fits in type
+    bool try_parse_plain_value(dtype::etype type, value_t& value) {
+        using enum lexer_token::token_type;
+        push_scope();
+        const auto token = stage_token();
+        if (token.is<literal>()) {
+            const auto next = stage_token();
+            if (next.is<symbol>(",") || next.is<end_of_line, end_of_file>()) {
+                value = parse_literal(token.content);
+                const auto fits = (type == dtype::u8) ? dtype::is_u8(value)
+                                                      : dtype::is_u16(value);
+                if (fits) {
+                    unstage_token();
+                    accept_scope();
+                    return true;
+                }
+            }
+        }
+        cancel_scope();
+        return false;
+    }
+    void flush_data_block(data_block_t& block) {
+        std::visit([this] (auto& values) {
+            if (values.empty()) return;
+            m_tokens.push_back(
+                parser_token::make_data_block(data_block_t(std::move(values)))
+            );
+            values.clear();
+        }, block);
+    }
+    // Runs of plain values are gathered into a data block, any other
+    // expression ends the run and is emitted on its own
+    bool parse_data_item(dtype::etype type, data_block_t& block) {
+        value_t value;
+        if (try_parse_plain_value(type, value)) {
+            std::visit([value] (auto& values) { values.push_back(value); }, block);
+            return true;
+        }
+        operand_t data;
+        if (try_parse_operand(data, type)) {
+            flush_data_block(block);
+            m_tokens.push_back(parser_token::make_data(data));
+            return true;
+        }
+        return false;
+    }
     bool parse_data() {
         using enum lexer_token::token_type;
         push_scope();
         if (stage_token().is<symbol>(".")) {
             const auto data_type = stage_token();
             if (data_type.is<identifier>("byte", "word")) {
-                auto type = dtype::any;
-                if (data_type.is<identifier>("byte")) type = dtype::u8;
-                if (data_type.is<identifier>("word")) type = dtype::u16;
-
-                operand_t data;
-                if (try_parse_operand(data, type)) {
-                    m_tokens.push_back(parser_token::make_data(data));
+                auto type = dtype::u8;
+                data_block_t block = std::vector<uint8_t>();
+                if (data_type.is<identifier>("word")) {
+                    type = dtype::u16;
+                    block = std::vector<uint16_t>();
+                }
 
+                if (parse_data_item(type, block)) {
+                    // The directive is committed, consumed tokens are released
+                    // after each item to keep long lists in constant memory
+                    accept();
                     while (true) {
                         push_scope();
                         if (stage_token().is<symbol>(",")
-                            && try_parse_operand(data, type)) {
-                            m_tokens.push_back(parser_token::make_data(data));
+                            && parse_data_item(type, block)) {
+                            accept();
                         } else {
                             cancel_scope();
                             break;
                         }
                     }
-
+                    flush_data_block(block);
                     accept();
                     return true;
                 }
@@ -370,6 +670,357 @@ public:
         cancel_scope();
         return false;
     }
+    bool parse_incbin() {
+        using enum lexer_token::token_type;
+        push_scope();
+        lexer_token path;
+        if (stage_token().is<symbol>(".")
+            && stage_token().is<identifier>("incbin")
+            && (path = stage_token()).is<string_literal>()
+        ) {
+            // Optional offset and length
+            std::vector<operand_t> arguments;
+            while (arguments.size() < 2) {
+                push_scope();
+                operand_t argument;
+                if (stage_token().is<symbol>(",")
+                    && try_parse_operand(argument)) {
+                    accept_scope();
+                    arguments.push_back(argument);
+                } else {
+                    cancel_scope();
+                    break;
+                }
+            }
+            accept();
+            // Found as included sources are
+            auto file = parse_string(path.content);
+            if (m_sources) file = m_sources->resolve(file);
+            m_tokens.push_back(
+                parser_token::make_binary_include(file, arguments)
+            );
+            return true;
+        }
+        cancel_scope();
+        return false;
+    }
+    // The included tokens are replayed once the line is consumed
+    bool parse_include() {
+        using enum lexer_token::token_type;
+        push_scope();
+        lexer_token path;
+        if (stage_token().is<symbol>(".")
+            && stage_token().is<identifier>("include")
+            && (path = stage_token()).is<string_literal>()
+            && stage_token().is<end_of_line, end_of_file>()
+        ) {
+            accept();
+            std::shared_ptr<const source_t> source;
+            if (m_sources && (replay_depth() < max_include_depth)) {
+                const auto name = parse_string(path.content);
+                source = m_sources->get(name);
+                // A file created later at any of the places searched is a change
+                if (!source) {
+                    const auto paths = m_sources->candidates(name);
+                    m_includes.insert(m_includes.end(), paths.begin(), paths.end());
+                }
+            }
+            if (!source) {
+                m_tokens.push_back(parser_token::make_unknown());
+                return true;
+            }
+            m_includes.push_back(source->path);
+            replay(source->tokens, source->path, source->lines, source->directives);
+            return true;
+        }
+        cancel_scope();
+        return false;
+    }
+    // Tokens of the lines up to the one made of an end directive, which is
+    // consumed. Blocks opened by a begin directive nest.
+    // Returns false if the end of file comes first.
+    bool parse_block(const std::vector<std::string>& begin,
+                     const std::vector<std::string>& end,
+                     token_array_t& body) {
+        using enum lexer_token::token_type;
+        const auto is_one_of = [] (const lexer_token& token, const std::vector<std::string>& names) {
+            return token.is<identifier>()
+                && (std::find(names.begin(), names.end(), token.content) != names.end());
+        };
+        size_t depth = 0;
+        bool line_start = true;
+        while (true) {
+            auto token = stage_token();
+            if (token.eof()) {
+                unstage_token();
+                accept();
+                return false;
+            }
+            if (line_start && token.is<symbol>(".")) {
+                const auto directive = stage_token();
+                if (is_one_of(directive, end)) {
+                    const auto line_end = stage_token();
+                    if (line_end.is<end_of_line, end_of_file>()) {
+                        if (depth == 0) {
+                            if (line_end.eof()) unstage_token();
+                            accept();
+                            return true;
+                        }
+                        --depth;
+                    }
+                    unstage_token();
+                } else if (is_one_of(directive, begin)) {
+                    ++depth;
+                }
+                unstage_token();
+            }
+            accept();
+            line_start = token.is<end_of_line>();
+            body.push_back(std::move(token));
+        }
+    }
+    bool parse_macro() {
+        using enum lexer_token::token_type;
+        push_scope();
+        lexer_token name;
+        if (!(stage_token().is<symbol>(".")
+              && stage_token().is<identifier>("macro")
+              && (name = stage_token()).is<identifier>())) {
+            cancel_scope();
+            return false;
+        }
+        auto macro = std::make_shared<macro_t>();
+        auto token = stage_token();
+        while (token.is<identifier>()) {
+            macro->parameters.push_back(token.content);
+            token = stage_token();
+            if (!token.is<symbol>(",")) break;
+            token = stage_token();
+        }
+        if (!token.is<end_of_line>()) {
+            cancel_scope();
+            return false;
+        }
+        accept();
+
+        if (!parse_block({ "macro" }, { "endmacro" }, macro->body)) {
+            m_tokens.push_back(parser_token::make_unknown());
+            return true;
+        }
+        const auto& parameters = macro->parameters;
+        for (size_t i = 0; i < macro->body.size(); ++i) {
+            const auto& token = macro->body[i];
+            if (!token.is<identifier>()) continue;
+            const auto it = std::find(parameters.begin(), parameters.end(), token.content);
+            if (it != parameters.end()) {
+                macro->substitutions.push_back({ i, size_t(it - parameters.begin()) });
+            }
+        }
+        m_macros[name.content] = std::move(macro);
+        return true;
+    }
+    // The body is replayed count times from the same tokens, the variable
+    // is bound to the iteration by try_parse_operand
+    bool parse_repeat() {
+        using enum lexer_token::token_type;
+        push_scope();
+        operand_t count;
+        lexer_token variable;
+        if (!(stage_token().is<symbol>(".")
+              && stage_token().is<identifier>("repeat", "rept")
+              && try_parse_operand(count))) {
+            cancel_scope();
+            return false;
+        }
+        auto token = stage_token();
+        if (token.is<symbol>(",")) {
+            if (!(variable = stage_token()).is<identifier>()) {
+                cancel_scope();
+                return false;
+            }
+            token = stage_token();
+        }
+        if (!token.is<end_of_line>()) {
+            cancel_scope();
+            return false;
+        }
+        accept();
+
+        auto body = std::make_shared<token_array_t>();
+        const auto terminated = parse_block({ "repeat", "rept" }, { "endrepeat", "endr" }, *body);
+        value_t iterations;
+        if (!terminated
+            || !constant_value(count, iterations)
+            || (iterations < 0)
+            || (replay_depth() >= max_include_depth)) {
+            m_tokens.push_back(parser_token::make_unknown());
+            return true;
+        }
+        repeat(std::move(body), static_cast<size_t>(iterations), variable.content);
+        return true;
+    }
+    // End of the line, an end of file is left for parse_eof
+    bool parse_line_end() {
+        using enum lexer_token::token_type;
+        const auto token = stage_token();
+        if (token.eof()) unstage_token();
+        return token.is<end_of_line, end_of_file>();
+    }
+    // Rest of the line, whatever it contains, not beyond the current input
+    void skip_line() {
+        while (!input_ended() && !parse_line_end()) {}
+        accept();
+    }
+    void report_unterminated(const condition_t& condition) {
+        diagnostics().report(diagnostic_code::unterminated_conditional, condition.source, condition.offset);
+    }
+    enum class branch_end { else_branch, end_if, end_of_file };
+    // Skips an inactive branch up to the .else or .endif closing it, within
+    // the file or expansion it is in. Only lines starting with a directive
+    // are lexed, when tokens are not replayed.
+    branch_end skip_branch(bool to_endif) {
+        using enum lexer_token::token_type;
+        size_t depth = 0;
+        while (true) {
+            skip_to_directive_line();
+            if (input_ended()) return branch_end::end_of_file;
+            const auto token = stage_token();
+            if (token.eof()) {
+                unstage_token();
+                accept();
+                return branch_end::end_of_file;
+            }
+            if (token.is<symbol>(".")) {
+                const auto directive = stage_token();
+                if (directive.is<identifier>("if", "ifdef") || directive.is<identifier>("ifndef")) {
+                    ++depth;
+                } else if (directive.is<identifier>("endif") && (depth > 0)) {
+                    --depth;
+                } else if (directive.is<identifier>("else", "endif") && (depth == 0)) {
+                    const auto end_if = directive.is<identifier>("endif");
+                    if (end_if || !to_endif) {
+                        skip_line();
+                        return end_if ? branch_end::end_if : branch_end::else_branch;
+                    }
+                    diagnostics().report(diagnostic_code::duplicate_else, diagnostic_source(), token.offset);
+                }
+                unstage_token();
+            }
+            unstage_token();
+            skip_line();
+        }
+    }
+    // .if, .ifdef, .ifndef, .else and .endif lines, conditions are computed
+    // while parsing
+    bool parse_conditional() {
+        using enum lexer_token::token_type;
+        push_scope();
+        const auto start = stage_token();
+        if (!start.is<symbol>(".")) {
+            cancel_scope();
+            return false;
+        }
+        const auto directive = stage_token();
+        bool valid = true;
+        bool condition = false;
+        if (directive.is<identifier>("ifdef") || directive.is<identifier>("ifndef")) {
+            const auto name = stage_token();
+            if (!name.is<identifier>() || !parse_line_end()) {
+                cancel_scope();
+                return false;
+            }
+            const auto defined = (m_defines.count(name.content) > 0) || (m_macros.count(name.content) > 0);
+            condition = (defined == directive.is<identifier>("ifdef"));
+        } else if (directive.is<identifier>("if")) {
+            operand_t expression;
+            value_t value = 0;
+            if (!try_parse_operand(expression) || !parse_line_end()) {
+                cancel_scope();
+                return false;
+            }
+            valid = constant_value(expression, value);
+            condition = (value != 0);
+        } else if (directive.is<identifier>("else", "endif")) {
+            if (!parse_line_end()) {
+                cancel_scope();
+                return false;
+            }
+            accept();
+            // Those of a block opened in another file or expansion stray as well
+            if (m_conditions.empty() || (m_conditions.back().input != current_input())) {
+                m_tokens.push_back(parser_token::make_unknown());
+                return true;
+            }
+            const auto condition = m_conditions.back();
+            m_conditions.pop_back();
+            if (directive.is<identifier>("endif")) return true;
+            if (condition.else_seen) {
+                diagnostics().report(diagnostic_code::duplicate_else, diagnostic_source(), start.offset);
+            }
+            if (skip_branch(true) == branch_end::end_of_file) report_unterminated(condition);
+            return true;
+        } else {
+            cancel_scope();
+            return false;
+        }
+        accept();
+        if (!valid) {
+            m_tokens.push_back(parser_token::make_unknown());
+        }
+        condition_t opened{ current_input(), diagnostic_source(), start.offset, false };
+        if (condition) {
+            m_conditions.push_back(opened);
+            return true;
+        }
+        switch (skip_branch(false)) {
+            case branch_end::else_branch:
+                opened.else_seen = true;
+                m_conditions.push_back(opened);
+                break;
+            case branch_end::end_of_file:
+                report_unterminated(opened);
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+    // Arguments are the runs of tokens between commas, the expansion is
+    // replayed once the line is consumed
+    bool parse_macro_call() {
+        using enum lexer_token::token_type;
+        if (m_macros.empty()) return false;
+        push_scope();
+        const auto name = stage_token();
+        const auto it = name.is<identifier>() ? m_macros.find(name.content) : m_macros.end();
+        if (it == m_macros.end()) {
+            cancel_scope();
+            return false;
+        }
+        const auto& macro = *it->second;
+        std::vector<token_array_t> arguments;
+        int depth = 0;
+        for (auto token = stage_token(); !token.is<end_of_line, end_of_file>(); token = stage_token()) {
+            if (arguments.empty()) arguments.emplace_back();
+            if (token.is<symbol>("(")) ++depth;
+            if (token.is<symbol>(")")) --depth;
+            if ((depth == 0) && token.is<symbol>(",")) {
+                arguments.emplace_back();
+            } else {
+                arguments.back().push_back(std::move(token));
+            }
+        }
+        accept();
+        const auto valid = (arguments.size() == macro.parameters.size())
+            && std::none_of(arguments.begin(), arguments.end(),
+                            [] (const auto& argument) { return argument.empty(); });
+        if (!valid || (replay_depth() >= max_include_depth)) {
+            m_tokens.push_back(parser_token::make_unknown());
+            return true;
+        }
+        replay(macro.expand(arguments));
+        return true;
+    }
     bool parse_import() {
         using enum lexer_token::token_type;
         push_scope();
@@ -455,17 +1106,21 @@ public:
 
     bool parse_line() {
         if (parse_eof()) return false;
-        
+        if (parse_include()) return true;
+        if (parse_conditional() || parse_macro() || parse_repeat()) return true;
+        if (parse_macro_call()) return true;
+
         const auto has_parsed_directive = (
-            parse_define()
-            || parse_align()
-            || parse_data()
-            || parse_import()
-            || parse_export()
+            profile_rule(parse_rule::define, [this] { return parse_define(); })
+            || profile_rule(parse_rule::align, [this] { return parse_align(); })
+            || profile_rule(parse_rule::data, [this] { return parse_data(); })
+            || profile_rule(parse_rule::incbin, [this] { return parse_incbin(); })
+            || profile_rule(parse_rule::import_symbol, [this] { return parse_import(); })
+            || profile_rule(parse_rule::export_symbol, [this] { return parse_export(); })
         );
         if (!has_parsed_directive) {
-            parse_label();
-            parse_instruction();
+            profile_rule(parse_rule::label, [this] { return parse_label(); });
+            profile_rule(parse_rule::instruction, [this] { return parse_instruction(); });
         }
         if (parse_eol()) return true;
         if (parse_to_eol()) {
@@ -474,15 +1129,51 @@ public:
         return true;
     }
 
-    parser_token get() {
-        while (m_tokens.empty()) {
-            if (!parse_line()) return parser_token::make_eof();
+    bool next_line() {
+        allocation_scope scope(allocation_stage::parser);
+        m_tokens.clear();
+        m_head = 0;
+        const auto& first = peek_token();
+        // Blocks still open when their file or expansion ended
+        while (!m_conditions.empty() && (first.eof() || !input_active(m_conditions.back().input))) {
+            report_unterminated(m_conditions.back());
+            m_conditions.pop_back();
+        }
+        const auto source = first.source;
+        const auto offset = first.offset;
+        const auto parsed = parse_line();
+        for (auto& token : m_tokens) {
+            token.source = source;
+            token.offset = offset;
         }
+#ifdef SASM_STATS
+        for (const auto& token : m_tokens) SASM_STAT(statements[token.kind]);
+#endif
+        return parsed;
+    }
+
+    // Files included so far, as resolved by the source manager, and the
+    // paths searched for those not found
+    const std::vector<std::string>& includes() const {
+        return m_includes;
+    }
 
-        const auto head = m_tokens.front();
-        m_tokens.pop_front();
-        return head;
+    parser_token get() {
+        while (m_head == m_tokens.size()) {
+            if (!next_line()) return parser_token::make_eof();
+        }
+        return std::move(m_tokens[m_head++]);
     }
+
+    // Lazily yields every statement up to, but not including, end of file.
+    // The coroutine frame is allocated from the given resource.
+    // Statements are yielded from the line buffer rather than parsed from
+    // lexer::tokens(): the rules backtrack over the tokens of a line, make
+    // several statements of some lines, and read included files and
+    // expansions replayed ahead of the lexer. The buffer is reused from one
+    // line to the next, so it allocates nothing once grown.
+    generator<parser_token> statements(
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 };
 
 }
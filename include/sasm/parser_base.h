@@ -1,24 +1,96 @@
 #pragma once
 
+#include <sasm/diagnostics.h>
 #include <sasm/lexer.h>
+#include <sasm/profile.h>
 
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 namespace sasm {
 
+using token_array_t = std::vector<lexer_token>;
+
+// Indices of the tokens starting a line with a directive, in increasing order
+std::vector<size_t> find_directive_lines(const token_array_t& tokens);
+
+// Bounds of the input a parser accepts, zero for none. A line beyond them
+// is rejected as soon as the bound is reached, with a diagnostic.
+struct parse_limits_t {
+    size_t max_nesting = 256;               // parentheses open in an expression
+    size_t max_line_length = 1 << 20;       // bytes from the first token of a line to its end
+};
+
 class parser_base_t {
     lexer* m_lexer;
+    parse_limits_t m_limits;
     auto get_token();
 
+    // Start of the line being read from a source file
+    struct line_t {
+        size_t start = 0;
+        bool started = false;
+    };
+    line_t m_lexer_line;
+    // Follows the lines of a source file, true if the token ends beyond
+    // the line length limit
+    bool exceeds_line(line_t& line, const lexer_token& token) const;
+    // End of a line too long, delivered after the token standing for it
+    std::optional<lexer_token> m_line_end;
+
+    diagnostics_sink m_diagnostics;
+
     size_t m_current;
     std::vector<lexer_token> m_buffer;
     std::vector<size_t> m_scopes;
 
+    // Token arrays delivered before the lexer tokens, innermost last.
+    // A repeated array is delivered count times, the variable bound to the
+    // iteration.
+    struct replay_t {
+        std::shared_ptr<const token_array_t> tokens;
+        size_t next;
+        size_t count = 1;
+        size_t iteration = 0;
+        std::string variable;
+        uint32_t source = diagnostics_sink::no_source;  // file the tokens are, if any
+        line_t line;
+        uint64_t expansion = 0;     // of a macro or repeat iteration, 0 for files and pending tokens
+        std::shared_ptr<const std::vector<size_t>> directives;    // lines of a file, if known
+        uint64_t input = 0;         // numbered from 1, again for each iteration
+    };
+    std::vector<replay_t> m_replays;
+    size_t m_repeats;
+    uint64_t m_expansions = 0;
+    uint64_t m_inputs = 0;
+    // Rewinds the innermost replay when iterations remain, else drops it
+    void finish_replay();
+
+#ifdef SASM_PROFILE
+    uint64_t m_staged = 0;      // calls to stage_token, for the tokens rules waste
+    // Tokens of the innermost source file, nullptr for the lexer input
+    const void* current_source() const;
+#endif
+
 public:
-    explicit parser_base_t(lexer* lexer);
+    explicit parser_base_t(lexer* lexer, const parse_limits_t& limits = {});
+
+    const parse_limits_t& limits() const;
+    // Errors found while parsing, sources are those of replayed files
+    diagnostics_sink& diagnostics();
+    const diagnostics_sink& diagnostics() const;
+    // Records that the input exceeds a limit at the token, once per token
+    void report_limit(const lexer_token& token, diagnostic_code code, size_t limit);
+    // Index in the diagnostics of the innermost file the tokens come from
+    uint32_t diagnostic_source() const;
 
     lexer_token stage_token();
     void unstage_token();
+    // Token the next stage_token returns, valid until then
+    const lexer_token& peek_token();
 
     void push_scope();
     void accept_scope();
@@ -26,6 +98,62 @@ public:
 
     void accept();
     void reset();
+
+    // Delivers the tokens, which must not contain trivia, before any
+    // further token. Tokens staged but not accepted yet come after them.
+    // The source, when given, is the file the tokens were read from, and
+    // its lines locate the diagnostics. Its directive lines, when known,
+    // are jumped to when skipping.
+    void replay(std::shared_ptr<const token_array_t> tokens, const std::string& source = "",
+                std::shared_ptr<const line_index> lines = nullptr,
+                std::shared_ptr<const std::vector<size_t>> directives = nullptr);
+    // Same, count times, with no copy of the tokens. The variable, unless
+    // empty, is bound to the iteration while its tokens are delivered.
+    void repeat(std::shared_ptr<const token_array_t> tokens, size_t count,
+                const std::string& variable);
+    size_t replay_depth() const;
+    // Macro expansion or repeat iteration the tokens come from, each one
+    // numbered from 1, 0 for source files
+    uint64_t current_expansion() const;
+    // True while the tokens of the expansion are delivered, always for 0
+    bool expansion_active(uint64_t expansion) const;
+    // Replay the tokens come from, each iteration of a repeat apart, 0 for
+    // the lexer input
+    uint64_t current_input() const;
+    // True until the tokens of the input are all delivered, always for 0
+    bool input_active(uint64_t input) const;
+    // True once the innermost replay delivered all its tokens, with nothing
+    // staged. Never for the lexer input, which ends with an end of file.
+    bool input_ended() const;
+
+    // Skips the lines which cannot be directives, from the start of a line
+    // with nothing staged. Replayed files jump to their next directive line,
+    // other replayed tokens are scanned for line ends, lexer input is
+    // scanned as raw bytes. Stops at the end of the innermost replay, the
+    // tokens after it are not skipped.
+    void skip_to_directive_line();
+
+    // Iteration of the innermost repeat binding the variable
+    bool bound_value(const std::string& variable, size_t& value) const;
+    bool has_bound_variables() const;
+
+    // Runs a grammar rule, in builds with SASM_PROFILE its attempt is
+    // recorded in the thread profile
+    template <typename rule_f>
+    bool profile_rule(parse_rule rule, rule_f parse) {
+#ifdef SASM_PROFILE
+        const auto staged = m_staged;
+        const auto start = std::chrono::steady_clock::now();
+        const bool success = parse();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        thread_profile().record(rule, success, m_staged - staged,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        return success;
+#else
+        (void)rule;
+        return parse();
+#endif
+    }
 };
 
 }
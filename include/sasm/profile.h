@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sasm {
+
+// Grammar rules, as tried in order on each line, then the alternatives of
+// an instruction
+enum class parse_rule : uint8_t {
+    define, align, data, incbin, import_symbol, export_symbol, label, instruction,
+    relative, indirect_y, indirect_x, indirect, direct_indexed, direct, immediate, implied,
+};
+static constexpr size_t parse_rule_count = 16;
+
+const char* rule_name(parse_rule rule);
+
+struct rule_profile_t {
+    uint64_t attempts = 0;
+    uint64_t successes = 0;
+    uint64_t wasted_tokens = 0;     // staged by the attempts which failed
+    uint64_t nanoseconds = 0;       // nested rules included
+};
+
+// Attempts of each grammar rule and the lines staged again the most.
+// Recorded in builds with the SASM_PROFILE option only, each thread
+// records its own.
+class parse_profile {
+    std::array<rule_profile_t, parse_rule_count> m_rules {};
+    // Lines by token array and offset of their first token, the arrays by
+    // the source they were read from
+    std::map<std::pair<const void*, size_t>, uint64_t> m_restaged;
+    std::unordered_map<const void*, std::string> m_sources;
+
+public:
+    void record(parse_rule rule, bool success, uint64_t staged, uint64_t nanoseconds);
+    void restaged(const void* tokens, size_t offset);
+    void name_source(const void* tokens, const std::string& path);
+    void clear();
+
+    const rule_profile_t& rule(parse_rule rule) const;
+
+    // Rules by time, then the lines staged again the most, at their line
+    // numbers when the sources can be read
+    std::vector<std::string> report(size_t locations = 10) const;
+};
+
+constexpr bool profile_enabled() {
+#ifdef SASM_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Profile of the calling thread
+parse_profile& thread_profile();
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <sstream>
+#include <string>
+#include <string_view>
 
 namespace sasm {
 
@@ -13,13 +14,24 @@ struct character {
 };
 
 class reader {
-    std::istringstream m_input;
+    std::string m_storage;
+    std::string_view m_input;
     size_t m_offset;
 
 public:
     explicit reader(const std::string& content);
+    // Reads from a buffer owned by the caller, which must outlive the reader
+    reader(const char* data, size_t size);
+    // The input may view the reader's own storage
+    reader(const reader&) = delete;
+    reader& operator=(const reader&) = delete;
 
     character get();
+
+    // Offset of the first line, from the line starting at offset, whose
+    // first character other than blanks is a '.'. The input size if none.
+    size_t find_directive_line(size_t offset) const;
+    void seek(size_t offset);
 };
 
 }
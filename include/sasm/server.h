@@ -0,0 +1,84 @@
+#pragma once
+
+#include <sasm/driver.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Assembler kept running between builds
+//
+// Sources stay mapped and lexed in source managers, one per client directory
+// and set of include paths, and the output of every module is kept along with the size and
+// modification time of the files it was built from. A request whose files
+// did not change is answered from memory without reading any source.
+//
+// What is kept is bounded in bytes, the least recently used modules and
+// source managers are dropped first. A client which does not send its
+// request within the timeout is dropped, so that it does not hold the
+// others.
+class assembler_server {
+    struct file_state_t {
+        std::string path;
+        int64_t modification_time;
+        uint64_t size;
+
+        bool operator==(const file_state_t&) const = default;
+    };
+    struct module_t {
+        std::vector<file_state_t> inputs;
+        file_state_t written;
+        std::vector<uint8_t> output;
+        uint64_t used;
+    };
+    struct sources_t {
+        std::unique_ptr<source_manager> manager;
+        uint64_t used;
+    };
+    uint64_t m_max_size;
+    int m_timeout;
+    // By client directory and include paths
+    std::map<std::vector<std::string>, sources_t> m_sources;
+    std::map<std::string, module_t> m_modules;
+    uint64_t m_uses;
+    size_t m_hits;
+
+    source_manager& sources(const std::string& directory, const std::vector<std::string>& include_paths);
+    static bool file_state(const std::string& path, file_state_t& state);
+    void evict();
+
+public:
+    // timeout in milliseconds, for a client to send its request
+    explicit assembler_server(uint64_t max_size = 256 << 20, int timeout = 10000);
+
+    // Handles a command line of the driver, relative paths are taken from
+    // the client directory. Returns false on errors, as in the messages.
+    bool handle(const std::vector<std::string>& arguments,
+                const std::string& directory,
+                std::vector<std::string>& messages);
+
+    // Requests answered without assembling
+    size_t hits() const;
+    // Bytes of the kept outputs and sources
+    uint64_t size() const;
+
+    // Serves clients on a Unix domain socket until one asks to stop
+    bool serve(const std::string& socket_path);
+};
+
+// Sends a command line to a server, `success` is the result of the request
+// Returns false if the server cannot be reached
+bool send_request(const std::string& socket_path,
+                  const std::vector<std::string>& arguments,
+                  const std::string& directory,
+                  bool& success,
+                  std::vector<std::string>& messages);
+
+// Asks a server to stop, once its current request is done
+bool stop_server(const std::string& socket_path);
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <sasm/line_index.h>
+#include <sasm/mapped_file.h>
+#include <sasm/parser_base.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sasm {
+
+// Source file, mapped and lexed once
+struct source_t {
+    std::string path;
+    uint32_t id;                                // of the path, from 1, in its tokens
+    int64_t modification_time;
+    uint64_t size;
+    std::shared_ptr<const mapped_file> file;
+    std::shared_ptr<const token_array_t> tokens;
+    std::shared_ptr<const line_index> lines;    // of the file, built on first use
+    std::shared_ptr<const std::vector<size_t>> directives;  // lines of the tokens, for skipping
+};
+
+// Process wide cache of source files
+//
+// Each file is mapped and lexed on first use, and again only when its
+// modification time or size changed. Lexed tokens do not contain trivia and
+// always end with an end of line, so that they can be replayed by the parser.
+//
+// The lock only covers the tables: a file is mapped and lexed by the first
+// thread asking for it, the others wait for that one file only.
+class source_manager {
+    // Version of a file, ready once loaded, nullptr if it could not be read
+    struct entry_t {
+        int64_t modification_time;
+        uint64_t size;
+        std::shared_future<std::shared_ptr<const source_t>> source;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<entry_t>> m_sources;
+    std::unordered_map<std::string, uint32_t> m_ids;
+    std::vector<std::string> m_paths;           // by id - 1
+    std::vector<std::string> m_include_paths;
+    std::string m_directory;
+    size_t m_lex_count;
+
+    std::string resolve_path(const std::string& path) const;
+
+public:
+    source_manager();
+
+    // Directory relative paths are taken from before the include paths are
+    // searched, the current one by default
+    void set_directory(const std::string& directory);
+    // Absolute path of that directory
+    std::string directory() const;
+    // Directories searched for relative paths not found as given
+    void add_include_path(const std::string& directory);
+
+    // Absolute path of a file as get would find it, the path as given if
+    // it is not found
+    std::string resolve(const std::string& path) const;
+    // Absolute paths at which get would look for a file, in order
+    std::vector<std::string> candidates(const std::string& path) const;
+
+    // nullptr if the file cannot be read
+    std::shared_ptr<const source_t> get(const std::string& path);
+
+    // Source last read for an id, nullptr if none, whether or not its file
+    // changed since
+    std::shared_ptr<const source_t> find(uint32_t id) const;
+
+    // Number of times a file was lexed
+    size_t lex_count() const;
+    // Bytes of the files kept
+    uint64_t size() const;
+};
+
+}
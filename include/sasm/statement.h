@@ -0,0 +1,94 @@
+#pragma once
+
+#include <sasm/parser.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+
+namespace sasm {
+
+// Identifier of an interned name
+using name_t = uint32_t;
+
+// Stores each distinct name once
+class name_table {
+    std::deque<std::string> m_names;
+    std::unordered_map<std::string_view, name_t> m_ids;
+
+public:
+    name_t intern(std::string_view name);
+    std::string_view operator[](name_t id) const;
+    size_t size() const;
+};
+
+// Owns the expressions referenced by statements
+// Addresses are stable, plain values are stored once per (value, type)
+class expression_arena {
+    std::deque<expression_t> m_expressions;
+    std::map<std::pair<value_t, dtype::etype>, const expression_t*> m_values;
+
+public:
+    const expression_t* store(const expression_t& expr);
+    const expression_t* store(expression_t&& expr);
+    size_t size() const;
+};
+
+struct statement_context {
+    name_table names;
+    expression_arena expressions;
+    std::deque<data_block_t> data_blocks;
+};
+
+namespace statement {
+
+struct unknown {};
+struct label { name_t name; };
+struct local_label { uint32_t scope; value_t slot; };
+struct anonymous_label { value_t rank; };
+struct instruction {
+    instruction_set::instruction_name name;
+    instruction_set::addressing_style style;
+    const operand_t* operand;   // nullptr without operand
+};
+struct data { const operand_t* value; };
+struct data_block { const data_block_t* values; };
+struct align { const operand_t* value; };
+struct define { name_t name; const operand_t* value; };
+struct import_symbol { name_t name; };
+struct export_symbol { name_t name; };
+struct binary_include {
+    name_t path;
+    const operand_t* offset;    // nullptr when absent
+    const operand_t* length;    // nullptr when absent
+};
+
+}
+
+using statement_t = std::variant<
+    statement::unknown,
+    statement::label,
+    statement::local_label,
+    statement::anonymous_label,
+    statement::instruction,
+    statement::data,
+    statement::data_block,
+    statement::align,
+    statement::define,
+    statement::import_symbol,
+    statement::export_symbol,
+    statement::binary_include
+>;
+
+// Compacts a parser statement, its payload is stored in the context
+// The token must not be end_of_file
+statement_t make_statement(const parser_token& token, statement_context& context);
+// Same, the operand and the data block are moved rather than copied
+statement_t make_statement(parser_token&& token, statement_context& context);
+
+}
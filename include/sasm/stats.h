@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Counters of the front end, to see where the work on a source goes.
+// They are compiled in with the SASM_STATS option only, otherwise every
+// SASM_STAT is an empty statement. Each thread counts on its own.
+struct stats_t {
+    static constexpr size_t token_types = 10;       // lexer_token::token_type
+    static constexpr size_t statement_kinds = 13;   // parser_token::statement_kind
+
+    uint64_t characters = 0;
+    std::array<uint64_t, token_types> tokens {};
+    uint64_t trivia = 0;
+    uint64_t scope_pushes = 0;
+    uint64_t scope_cancels = 0;
+    uint64_t scope_accepts = 0;
+    uint64_t resets = 0;
+    uint64_t restaged = 0;      // staged again after cancel_scope or reset
+    std::array<uint64_t, statement_kinds> statements {};
+
+    // Counts since an earlier copy
+    stats_t& operator-=(const stats_t& earlier);
+
+    // One line a counter, those at zero left out
+    std::vector<std::string> report() const;
+};
+
+constexpr bool stats_enabled() {
+#ifdef SASM_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Counters of the calling thread
+stats_t& thread_stats();
+
+}
+
+#ifdef SASM_STATS
+#define SASM_STAT(counter) (++::sasm::thread_stats().counter)
+#else
+#define SASM_STAT(counter) ((void)0)
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sasm {
+
+// Spans of the phases of a build, written as Chrome trace events which
+// chrome://tracing and Perfetto load
+//
+// Each thread appends to a buffer of its own, with no lock: buffers are
+// linked once into a global list, and handed to a new thread when theirs
+// ends. write_trace() appends the events recorded since the previous write
+// to the file, then forgets them; it is also called at exit while tracing.
+// It must be called when no other thread records, as between two
+// parallel_for.
+bool start_trace(const std::string& path);
+bool write_trace();
+// Writes the last events
+bool stop_trace();
+bool tracing();
+
+// Records the time from its construction to its destruction when tracing.
+// The name must outlive the trace, the detail is copied.
+class trace_span {
+    const char* m_name;
+    std::string m_detail;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_active;
+
+public:
+    explicit trace_span(const char* name, std::string_view detail = {});
+    ~trace_span();
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+};
+
+}
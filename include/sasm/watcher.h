@@ -0,0 +1,66 @@
+#pragma once
+
+#include <sasm/driver.h>
+#include <sasm/linker.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace sasm {
+
+// Rebuilds a program whenever one of its files changes
+//
+// Each source is assembled into an object next to it, and the objects are
+// linked into the output. The files read by every module are kept from one
+// build to the next: a change to a file reassembles only the modules which
+// read it, then the linker relocates only those when it can.
+class watcher {
+    driver_options_t m_options;
+    source_manager m_sources;
+    linker m_linker;
+    std::vector<std::string> m_objects;
+    std::vector<std::vector<std::string>> m_dependencies;   // files read by each module
+    std::map<std::string, std::set<size_t>> m_dependents;   // modules reading each file
+    std::vector<size_t> m_rebuilt;
+    // Modules whose last assembly failed, their objects are stale or missing
+    std::set<size_t> m_failed;
+    std::mutex m_messages_mutex;
+    std::vector<std::string> m_messages;
+    int m_inotify;
+    std::map<int, std::string> m_watches;                   // directory of each watch
+
+    bool assemble_modules(const std::vector<size_t>& modules);
+    bool link(const std::vector<size_t>& modules);
+    void watch_directories();
+
+public:
+    explicit watcher(const driver_options_t& options);
+    ~watcher();
+
+    watcher(const watcher&) = delete;
+    watcher& operator=(const watcher&) = delete;
+
+    // Assembles every module then links
+    bool build();
+
+    // Reassembles the modules reading these files and those which failed
+    // before, then relinks. False while any module fails.
+    bool rebuild(const std::vector<std::string>& files);
+
+    // False where files cannot be watched, inotify is Linux only
+    bool watching() const;
+
+    // Waits for changes to the files read by the modules, up to timeout_ms
+    // or forever when negative. Returns false if none were seen.
+    bool wait(int timeout_ms, std::vector<std::string>& files);
+
+    // Modules assembled by the last build
+    const std::vector<size_t>& rebuilt() const;
+    const std::vector<std::string>& messages() const;
+    const linker& program() const;
+};
+
+}
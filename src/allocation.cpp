@@ -0,0 +1,140 @@
+#include <sasm/allocation.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace sasm {
+
+const char* stage_name(allocation_stage stage) {
+    static const std::array<const char*, allocation_stage_count> names {
+        "other", "reader", "lexer", "parser_base", "parser", "expression", "encoder",
+    };
+    return names[static_cast<size_t>(stage)];
+}
+
+#ifdef SASM_ALLOCATIONS
+
+namespace {
+
+struct stage_counters_t {
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<int64_t> live = 0;
+    std::atomic<int64_t> peak = 0;
+};
+
+// Constant initialized, allocations may come before any constructor ran
+stage_counters_t g_counters[allocation_stage_count];
+thread_local allocation_stage t_stage = allocation_stage::other;
+
+// Placed before each block, keeps the alignment of malloc
+struct alignas(alignof(std::max_align_t)) block_header_t {
+    uint64_t size;
+    allocation_stage stage;
+};
+
+void* allocate(size_t size) {
+    auto* header = static_cast<block_header_t*>(std::malloc(sizeof(block_header_t) + size));
+    if (!header) return nullptr;
+    header->size = size;
+    header->stage = t_stage;
+    auto& counters = g_counters[static_cast<size_t>(header->stage)];
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    const auto live = counters.live.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed)
+        + static_cast<int64_t>(size);
+    auto peak = counters.peak.load(std::memory_order_relaxed);
+    while ((live > peak) && !counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    return header + 1;
+}
+
+void deallocate(void* pointer) {
+    if (!pointer) return;
+    auto* header = static_cast<block_header_t*>(pointer) - 1;
+    g_counters[static_cast<size_t>(header->stage)].live.fetch_sub(
+        static_cast<int64_t>(header->size), std::memory_order_relaxed);
+    std::free(header);
+}
+
+}
+
+allocation_scope::allocation_scope(allocation_stage stage)
+: m_previous(t_stage)
+{
+    t_stage = stage;
+}
+
+allocation_scope::~allocation_scope() {
+    t_stage = m_previous;
+}
+
+allocation_table_t allocation_counts() {
+    allocation_table_t table;
+    for (size_t i = 0; i < allocation_stage_count; ++i) {
+        table[i].count = g_counters[i].count.load();
+        table[i].bytes = g_counters[i].bytes.load();
+        table[i].live = g_counters[i].live.load();
+        table[i].peak = g_counters[i].peak.load();
+    }
+    return table;
+}
+
+void reset_allocation_counts() {
+    for (auto& counters : g_counters) {
+        counters.count = 0;
+        counters.bytes = 0;
+        counters.peak = counters.live.load();
+    }
+}
+
+#else
+
+allocation_table_t allocation_counts() {
+    return {};
+}
+
+void reset_allocation_counts() {}
+
+#endif
+
+std::vector<std::string> allocation_report() {
+    std::vector<std::string> lines;
+    const auto table = allocation_counts();
+    char line[128];
+    for (size_t i = 0; i < allocation_stage_count; ++i) {
+        const auto& counts = table[i];
+        if (counts.count == 0) continue;
+        std::snprintf(line, sizeof(line), "%-12s %10llu allocations %12llu bytes %12lld peak",
+            stage_name(static_cast<allocation_stage>(i)),
+            static_cast<unsigned long long>(counts.count),
+            static_cast<unsigned long long>(counts.bytes),
+            static_cast<long long>(counts.peak));
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+}
+
+#ifdef SASM_ALLOCATIONS
+
+void* operator new(size_t size) {
+    if (void* pointer = sasm::allocate(size ? size : 1)) return pointer;
+#ifdef __cpp_exceptions
+    throw std::bad_alloc();
+#else
+    std::abort();
+#endif
+}
+
+void operator delete(void* pointer) noexcept {
+    sasm::deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    sasm::deallocate(pointer);
+}
+
+#endif
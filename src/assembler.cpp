@@ -0,0 +1,154 @@
+#include <sasm/assembler.h>
+#include <sasm/object.h>
+#include <sasm/trace.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <variant>
+
+namespace sasm {
+
+// Rows of the output positions, each file located by one pass over its lines
+static bool make_debug_map(const encoder& output, source_manager& sources,
+                           std::vector<uint8_t>& content) {
+    const auto& positions = output.positions();
+    std::vector<debug_row_t> rows(positions.size());
+    std::vector<std::string> files;
+    std::map<uint32_t, std::vector<size_t>> by_source;
+    for (size_t i = 0; i < positions.size(); ++i) by_source[positions[i].source].push_back(i);
+    std::vector<size_t> offsets;
+    for (const auto& [id, indices] : by_source) {
+        const auto source = sources.find(id);
+        const auto file = static_cast<uint32_t>(files.size());
+        files.push_back(source ? source->path : std::string());
+        offsets.clear();
+        for (const auto i : indices) offsets.push_back(positions[i].offset);
+        const auto located = source ? source->lines->locate(offsets) : std::vector<line_column_t>(offsets.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            rows[indices[i]] = {
+                static_cast<uint32_t>(positions[indices[i]].address), file,
+                static_cast<uint32_t>(located[i].line), static_cast<uint32_t>(located[i].column) };
+        }
+    }
+    const auto end = output.origin() + output.size();
+    if (end > std::numeric_limits<uint32_t>::max()) return false;
+    return write_debug_map(files, rows, static_cast<uint32_t>(end), content);
+}
+
+bool assemble(const std::string& path,
+              source_manager& sources,
+              const assemble_options_t& options,
+              assembly_t& result) {
+    trace_span span("assemble", path);
+    result.output = encoder(options.origin, options.relocatable);
+    result.dependencies.clear();
+    result.errors.clear();
+    result.debug_map.clear();
+    if (options.debug_map) result.output.track_positions();
+
+    const auto source = sources.get(path);
+    if (!source) {
+        result.errors.report(diagnostic_code::cannot_read_file, result.errors.source(path));
+        return false;
+    }
+
+    // The main file is replayed from the cached tokens like any include
+    reader empty("");
+    lexer lexer(&empty);
+    parser parser(&lexer, &sources, options.limits);
+    parser.replay(source->tokens, source->path, source->lines, source->directives);
+    // Parse errors and those of the statements go to the same sink, in order
+    auto& errors = parser.diagnostics();
+    const auto main = errors.source(path);
+
+    // Statements are located in the file of their line, macros and repeats
+    // in that of their body
+    std::unordered_map<uint32_t, uint32_t> statement_sources;
+    const auto statement_source = [&] (uint32_t id) {
+        const auto it = statement_sources.find(id);
+        if (it != statement_sources.end()) return it->second;
+        const auto file = sources.find(id);
+        const auto index = file ? errors.source(file->path, file->lines) : main;
+        statement_sources.emplace(id, index);
+        return index;
+    };
+
+    // Parsed then encoded by batches, which traces show as spans of each.
+    // Statements are kept compact, their payload in the context of the batch.
+    struct located_statement_t {
+        statement_t statement;
+        uint32_t source;
+        size_t offset;
+    };
+    static constexpr size_t batch_size = 1024;
+    std::vector<located_statement_t> batch;
+    batch.reserve(batch_size);
+    statement_context context;
+    size_t index = 0;
+    for (bool end = false; !end; ) {
+        {
+            trace_span parse_span("parse", path);
+            batch.clear();
+            context = {};
+            while (batch.size() < batch_size) {
+                auto token = parser.get();
+                if (token.eof()) {
+                    end = true;
+                    break;
+                }
+                const auto source = token.source;
+                const auto offset = token.offset;
+                batch.push_back({ make_statement(std::move(token), context), source, offset });
+            }
+        }
+        trace_span encode_span("encode", path);
+        for (const auto& [statement, source, offset] : batch) {
+            ++index;
+            if (std::holds_alternative<statement::unknown>(statement)) {
+                errors.report(diagnostic_code::invalid_statement, statement_source(source), offset, 0, index);
+            } else if (!result.output.encode(statement, context, source, offset)) {
+                const auto code = result.output.redefined()
+                    ? diagnostic_code::duplicate_definition : diagnostic_code::unencodable_statement;
+                errors.report(code, statement_source(source), offset, 0, index);
+            }
+        }
+    }
+    {
+        trace_span evaluate_span("evaluate", path);
+        if (!result.output.finish() && !options.relocatable) {
+            errors.report(diagnostic_code::unresolved_symbols, main);
+        }
+    }
+    if (options.debug_map) {
+        trace_span debug_span("debug map", path);
+        if (!make_debug_map(result.output, sources, result.debug_map)) {
+            errors.report(diagnostic_code::unmappable_output, main);
+        }
+    }
+    result.errors = std::move(errors);
+
+    result.dependencies = parser.includes();
+    for (const auto& binary : result.output.binary_includes()) {
+        std::error_code error;
+        result.dependencies.push_back(
+            std::filesystem::absolute(binary, error).lexically_normal().string());
+    }
+    std::sort(result.dependencies.begin(), result.dependencies.end());
+    result.dependencies.erase(
+        std::unique(result.dependencies.begin(), result.dependencies.end()),
+        result.dependencies.end());
+    return result.errors.empty();
+}
+
+bool serialize(const assembly_t& assembly, std::vector<uint8_t>& content) {
+    if (assembly.output.relocatable()) {
+        return write_object(assembly.output, content);
+    }
+    content = assembly.output.flatten();
+    return true;
+}
+
+}
@@ -0,0 +1,169 @@
+#include <sasm/build_cache.h>
+#include <sasm/hash.h>
+#include <sasm/object.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+// Commit the library was configured from, empty outside of a git checkout
+#ifndef SASM_REVISION
+#define SASM_REVISION ""
+#endif
+
+namespace sasm {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string to_hex(uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016" PRIx64, value);
+    return text;
+}
+
+bool from_hex(const std::string& text, uint64_t& value) {
+    if (text.size() != 16) return false;
+    return std::sscanf(text.c_str(), "%" SCNx64, &value) == 1;
+}
+
+bool hash_file(const std::string& path, uint64_t& hash) {
+    mapped_file file;
+    if (!file.open(path)) return false;
+    hash = xxhash64(file.data(), file.size());
+    return true;
+}
+
+// Written next to its final path then renamed, so that concurrent builds
+// never see a partial file
+bool write_atomically(const std::string& path, const void* data, size_t size) {
+    const auto temporary = path + ".tmp" + std::to_string(std::random_device()());
+    {
+        std::ofstream output(temporary, std::ios::binary);
+        output.write(static_cast<const char*>(data), size);
+        if (!output) return false;
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error) fs::remove(temporary, error);
+    return !error;
+}
+
+void touch(const std::string& path) {
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+}
+
+}
+
+build_cache::build_cache(const std::string& directory, uint64_t max_size)
+: m_directory(directory)
+, m_max_size(max_size)
+{
+    std::error_code error;
+    fs::create_directories(m_directory, error);
+}
+
+std::string build_cache::entry_path(uint64_t key, const char* extension) const {
+    return (fs::path(m_directory) / (to_hex(key) + extension)).string();
+}
+
+uint64_t build_cache::source_key(std::span<const uint8_t> source, const std::string& options) {
+    return hash_builder()
+        .add(source)
+        .add(options)
+        .add(uint64_t(version))
+        .add(uint64_t(object_format::version))
+        .add(std::string_view(SASM_REVISION))
+        .digest();
+}
+
+bool build_cache::find(uint64_t source_key, mapped_file& output) const {
+    const auto manifest_path = entry_path(source_key, ".manifest");
+    std::ifstream manifest(manifest_path);
+    std::string line;
+    uint64_t output_key;
+    if (!std::getline(manifest, line) || !from_hex(line, output_key)) return false;
+
+    // Every dependency must still have the recorded content
+    while (std::getline(manifest, line)) {
+        uint64_t recorded, current;
+        if ((line.size() < 18) || !from_hex(line.substr(0, 16), recorded)) return false;
+        if (!hash_file(line.substr(17), current) || (current != recorded)) return false;
+    }
+
+    const auto output_path = entry_path(output_key, ".out");
+    if (!output.open(output_path)) return false;
+    touch(manifest_path);
+    touch(output_path);
+    return true;
+}
+
+bool build_cache::store(uint64_t source_key,
+                        const std::vector<std::string>& dependencies,
+                        std::span<const uint8_t> output) {
+    hash_builder key;
+    key.add(source_key);
+    std::ostringstream content;
+    for (const auto& path : dependencies) {
+        uint64_t hash;
+        if (!hash_file(path, hash)) return false;
+        key.add(hash).add(path);
+        content << to_hex(hash) << ' ' << path << '\n';
+    }
+    const auto output_key = key.digest();
+    const auto manifest = to_hex(output_key) + '\n' + content.str();
+
+    // Output first, a manifest always names an existing output
+    if (!write_atomically(entry_path(output_key, ".out"), output.data(), output.size())
+        || !write_atomically(entry_path(source_key, ".manifest"), manifest.data(), manifest.size())) {
+        return false;
+    }
+    evict();
+    return true;
+}
+
+void build_cache::evict() {
+    struct entry_t {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type time;
+    };
+    std::vector<entry_t> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for (const auto& item : fs::directory_iterator(m_directory, error)) {
+        if (!item.is_regular_file(error)) continue;
+        const auto size = item.file_size(error);
+        if (error) continue;
+        const auto time = item.last_write_time(error);
+        if (error) continue;
+        entries.push_back({ item.path(), size, time });
+        total += size;
+    }
+    if (total <= m_max_size) return;
+
+    std::sort(entries.begin(), entries.end(), [] (const entry_t& lhs, const entry_t& rhs) {
+        return lhs.time < rhs.time;
+    });
+    for (const auto& entry : entries) {
+        if (total <= m_max_size) break;
+        if (fs::remove(entry.path, error)) total -= entry.size;
+    }
+}
+
+uint64_t build_cache::size() const {
+    uint64_t total = 0;
+    std::error_code error;
+    for (const auto& item : fs::directory_iterator(m_directory, error)) {
+        if (item.is_regular_file(error)) total += item.file_size(error);
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,354 @@
+#include <sasm/debug_map.h>
+#include <sasm/trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace sasm {
+
+namespace {
+
+using namespace debug_format;
+
+size_t align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+void write_unsigned(std::vector<uint8_t>& program, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value != 0) byte |= 0x80;
+        program.push_back(byte);
+    } while (value != 0);
+}
+
+void write_signed(std::vector<uint8_t>& program, int64_t value) {
+    for (bool more = true; more; ) {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        more = !(((value == 0) && !(byte & 0x40)) || ((value == -1) && (byte & 0x40)));
+        if (more) byte |= 0x80;
+        program.push_back(byte);
+    }
+}
+
+bool read_unsigned(std::span<const uint8_t> program, size_t& offset, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (offset >= program.size()) return false;
+        const auto byte = program[offset++];
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool read_signed(std::span<const uint8_t> program, size_t& offset, int64_t& value) {
+    uint64_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+        if ((offset >= program.size()) || (shift >= 64)) return false;
+        byte = program[offset++];
+        result |= uint64_t(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    if ((shift < 64) && (byte & 0x40)) result |= ~uint64_t(0) << shift;
+    value = static_cast<int64_t>(result);
+    return true;
+}
+
+// Runs the opcode at the offset, appended is true if it appends a row
+// Returns false if the program is cut short
+bool execute(std::span<const uint8_t> program, size_t& offset, debug_row_t& registers, bool& appended) {
+    if (offset >= program.size()) return false;
+    const auto code = program[offset++];
+    appended = false;
+    uint64_t operand;
+    int64_t delta;
+    switch (code) {
+        case copy:
+            appended = true;
+            return true;
+        case advance_address:
+            if (!read_unsigned(program, offset, operand)) return false;
+            registers.address += static_cast<uint32_t>(operand);
+            return true;
+        case advance_line:
+            if (!read_signed(program, offset, delta)) return false;
+            registers.line += static_cast<uint32_t>(delta);
+            return true;
+        case set_file:
+            if (!read_unsigned(program, offset, operand)) return false;
+            registers.file = static_cast<uint32_t>(operand);
+            return true;
+        case set_column:
+            if (!read_unsigned(program, offset, operand)) return false;
+            registers.column = static_cast<uint32_t>(operand);
+            return true;
+        default:
+            break;
+    }
+    if (code < first_special) return false;
+    const uint32_t adjusted = code - first_special;
+    registers.address += adjusted / line_range;
+    registers.line += static_cast<uint32_t>(line_base + static_cast<int32_t>(adjusted % line_range));
+    appended = true;
+    return true;
+}
+
+constexpr debug_row_t initial_registers{ 0, 0, 1, 1 };
+
+}
+
+bool write_debug_map(std::span<const std::string> files, std::span<const debug_row_t> rows,
+                     uint32_t end_address, std::vector<uint8_t>& output) {
+    // Program
+    std::vector<uint8_t> program;
+    program.reserve(rows.size() * 2);
+    std::vector<checkpoint> marks;
+    auto registers = initial_registers;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const auto& row = rows[i];
+        if ((i > 0) && (row.address <= registers.address)) return false;
+        if ((row.address >= end_address) || (row.file >= files.size())) return false;
+        if (row.file != registers.file) {
+            program.push_back(set_file);
+            write_unsigned(program, row.file);
+        }
+        if (row.column != registers.column) {
+            program.push_back(set_column);
+            write_unsigned(program, row.column);
+        }
+        const uint64_t address_delta = row.address - registers.address;
+        auto line_delta = int64_t(row.line) - int64_t(registers.line);
+        if ((line_delta < line_base) || (line_delta >= line_base + int64_t(line_range))) {
+            program.push_back(advance_line);
+            write_signed(program, line_delta);
+            line_delta = 0;
+        }
+        const auto special = [&] (uint64_t delta) {
+            return first_special + uint64_t(line_delta - line_base) + line_range * delta;
+        };
+        if (special(address_delta) <= std::numeric_limits<uint8_t>::max()) {
+            program.push_back(static_cast<uint8_t>(special(address_delta)));
+        } else {
+            program.push_back(advance_address);
+            write_unsigned(program, address_delta);
+            program.push_back(static_cast<uint8_t>(special(0)));
+        }
+        registers = row;
+        if (i % checkpoint_interval == 0) {
+            marks.push_back({ row.address, row.file, row.line, row.column,
+                              static_cast<uint32_t>(program.size()), 0 });
+        }
+    }
+    std::string strings;
+    std::vector<file> entries;
+    for (const auto& path : files) {
+        entries.push_back({ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(path.size()) });
+        strings += path;
+    }
+
+    // Layout
+    header head {};
+    std::memcpy(head.magic, magic, sizeof(magic));
+    head.version = version;
+    head.end_address = end_address;
+    head.row_count = static_cast<uint32_t>(rows.size());
+    size_t offset = sizeof(header);
+    const auto place = [&] (uint32_t& table_offset, uint32_t& table_count,
+                            size_t count, size_t item_size) {
+        offset = align(offset, table_alignment);
+        table_offset = static_cast<uint32_t>(offset);
+        table_count = static_cast<uint32_t>(count);
+        offset += count * item_size;
+    };
+    place(head.checkpoint_offset, head.checkpoint_count, marks.size(), sizeof(checkpoint));
+    place(head.file_offset, head.file_count, entries.size(), sizeof(file));
+    place(head.program_offset, head.program_size, program.size(), 1);
+    place(head.string_offset, head.string_size, strings.size(), 1);
+    if (offset > std::numeric_limits<uint32_t>::max()) return false;
+    head.file_size = static_cast<uint32_t>(offset);
+
+    // Content
+    output.assign(offset, 0);
+    const auto write = [&] (size_t at, const void* data, size_t size) {
+        if (size > 0) std::memcpy(output.data() + at, data, size);
+    };
+    write(0, &head, sizeof(head));
+    write(head.checkpoint_offset, marks.data(), marks.size() * sizeof(checkpoint));
+    write(head.file_offset, entries.data(), entries.size() * sizeof(file));
+    write(head.program_offset, program.data(), program.size());
+    write(head.string_offset, strings.data(), strings.size());
+    return true;
+}
+
+bool write_debug_map(std::span<const std::string> files, std::span<const debug_row_t> rows,
+                     uint32_t end_address, const std::string& path) {
+    std::vector<uint8_t> content;
+    return write_debug_map(files, rows, end_address, content) && write_debug_map(content, path);
+}
+
+bool write_debug_map(std::span<const uint8_t> content, const std::string& path) {
+    trace_span span("write", path);
+    // Replaced rather than rewritten, a debugger may still have the old one mapped
+    const auto temporary = path + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary);
+        output.write(reinterpret_cast<const char*>(content.data()), content.size());
+        if (!output) return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool debug_map_view::open(std::span<const uint8_t> data) {
+    m_data = {};
+    if (data.size() < sizeof(debug_format::header)) return false;
+    if (reinterpret_cast<uintptr_t>(data.data()) % table_alignment != 0) return false;
+
+    const auto& head = *reinterpret_cast<const debug_format::header*>(data.data());
+    if (std::memcmp(head.magic, magic, sizeof(magic)) != 0) return false;
+    if (head.version != version) return false;
+    if (head.file_size > data.size()) return false;
+
+    const auto fits = [&] (uint32_t offset, uint64_t count, size_t item_size) {
+        return (offset % table_alignment == 0)
+            && (offset + count * item_size <= head.file_size);
+    };
+    if (!fits(head.checkpoint_offset, head.checkpoint_count, sizeof(checkpoint))
+        || !fits(head.file_offset, head.file_count, sizeof(debug_format::file))
+        || !fits(head.program_offset, head.program_size, 1)
+        || !fits(head.string_offset, head.string_size, 1)) {
+        return false;
+    }
+    m_data = data.first(head.file_size);
+
+    for (const auto& entry : checkpoints()) {
+        if (entry.program_offset > head.program_size) return invalid();
+    }
+    const auto entries = std::span<const debug_format::file>(
+        reinterpret_cast<const debug_format::file*>(m_data.data() + head.file_offset), head.file_count);
+    for (const auto& entry : entries) {
+        if (uint64_t(entry.name_offset) + entry.name_length > head.string_size) return invalid();
+    }
+
+    // The program is decoded once, so that a corrupt map is rejected rather
+    // than giving wrong rows: every opcode defined, rows in increasing
+    // addresses below the end, checkpoints on the rows they copy
+    const auto code = program();
+    const auto marks = checkpoints();
+    auto registers = initial_registers;
+    uint32_t rows = 0, previous = 0;
+    for (size_t offset = 0; offset < code.size(); ) {
+        bool appended;
+        if (!execute(code, offset, registers, appended)) return invalid();
+        if (!appended) continue;
+        if ((rows > 0) && (registers.address <= previous)) return invalid();
+        previous = registers.address;
+        if ((registers.address >= head.end_address) || (registers.file >= head.file_count)) return invalid();
+        if (rows % checkpoint_interval == 0) {
+            const auto index = rows / checkpoint_interval;
+            if (index >= marks.size()) return invalid();
+            const auto& mark = marks[index];
+            if ((debug_row_t{ mark.address, mark.file, mark.line, mark.column } != registers)
+                || (mark.program_offset != offset)) {
+                return invalid();
+            }
+        }
+        ++rows;
+    }
+    if ((rows != head.row_count)
+        || (marks.size() != (uint64_t(rows) + checkpoint_interval - 1) / checkpoint_interval)) {
+        return invalid();
+    }
+    return true;
+}
+
+bool debug_map_view::invalid() {
+    m_data = {};
+    return false;
+}
+
+const debug_format::header& debug_map_view::header() const {
+    return *reinterpret_cast<const debug_format::header*>(m_data.data());
+}
+
+std::span<const debug_format::checkpoint> debug_map_view::checkpoints() const {
+    if (m_data.empty()) return {};
+    return { reinterpret_cast<const checkpoint*>(m_data.data() + header().checkpoint_offset),
+             header().checkpoint_count };
+}
+
+std::span<const uint8_t> debug_map_view::program() const {
+    if (m_data.empty()) return {};
+    return m_data.subspan(header().program_offset, header().program_size);
+}
+
+size_t debug_map_view::file_count() const {
+    return m_data.empty() ? 0 : header().file_count;
+}
+
+std::string_view debug_map_view::file(uint32_t index) const {
+    if (index >= file_count()) return {};
+    const auto& entry = reinterpret_cast<const debug_format::file*>(
+        m_data.data() + header().file_offset)[index];
+    return { reinterpret_cast<const char*>(m_data.data()) + header().string_offset + entry.name_offset,
+             entry.name_length };
+}
+
+uint32_t debug_map_view::end_address() const {
+    return m_data.empty() ? 0 : header().end_address;
+}
+
+bool debug_map_view::find(uint32_t address, debug_row_t& row) const {
+    if (address >= end_address()) return false;
+    const auto marks = checkpoints();
+    auto mark = std::upper_bound(marks.begin(), marks.end(), address,
+        [] (uint32_t address, const checkpoint& entry) { return address < entry.address; });
+    if (mark == marks.begin()) return false;
+    --mark;
+
+    // The rows up to the next checkpoint, the last one not after the address
+    const auto code = program();
+    const size_t end = (mark + 1 != marks.end()) ? (mark + 1)->program_offset : code.size();
+    debug_row_t registers{ mark->address, mark->file, mark->line, mark->column };
+    row = registers;
+    for (size_t offset = mark->program_offset; offset < end; ) {
+        bool appended;
+        if (!execute(code, offset, registers, appended)) return false;
+        if (!appended) continue;
+        if (registers.address > address) break;
+        row = registers;
+    }
+    return true;
+}
+
+std::vector<debug_row_t> debug_map_view::rows() const {
+    std::vector<debug_row_t> result;
+    if (m_data.empty()) return result;
+    result.reserve(std::min<size_t>(header().row_count, header().program_size));
+    const auto code = program();
+    auto registers = initial_registers;
+    for (size_t offset = 0; offset < code.size(); ) {
+        bool appended;
+        if (!execute(code, offset, registers, appended)) break;
+        if (appended) result.push_back(registers);
+    }
+    return result;
+}
+
+bool debug_map_file::open(const std::string& path) {
+    if (!m_file.open(path)) return false;
+    return m_view.open(m_file.bytes());
+}
+
+const debug_map_view& debug_map_file::view() const {
+    return m_view;
+}
+
+}
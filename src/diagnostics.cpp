@@ -0,0 +1,139 @@
+#include <sasm/diagnostics.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace sasm {
+
+diagnostics_sink::diagnostics_sink(size_t capacity) {
+    m_entries.reserve(capacity);
+}
+
+uint32_t diagnostics_sink::source(const std::string& path, std::shared_ptr<const line_index> lines) {
+    const auto it = std::find(m_sources.begin(), m_sources.end(), path);
+    if (it != m_sources.end()) {
+        const auto index = static_cast<size_t>(it - m_sources.begin());
+        if (lines) m_lines[index] = std::move(lines);
+        return static_cast<uint32_t>(index);
+    }
+    m_sources.push_back(path);
+    m_lines.push_back(std::move(lines));
+    return static_cast<uint32_t>(m_sources.size() - 1);
+}
+
+void diagnostics_sink::report(diagnostic_code code, uint32_t source,
+                              size_t offset, size_t length, uint64_t argument) {
+    m_entries.push_back({ code, source, offset, length, argument });
+}
+
+const std::vector<diagnostic_t>& diagnostics_sink::entries() const {
+    return m_entries;
+}
+
+bool diagnostics_sink::empty() const {
+    return m_entries.empty();
+}
+
+void diagnostics_sink::clear() {
+    m_entries.clear();
+}
+
+// Codes whose offset is a position in the source
+static bool has_position(diagnostic_code code) {
+    switch (code) {
+        case diagnostic_code::invalid_statement:
+        case diagnostic_code::unencodable_statement:
+        case diagnostic_code::duplicate_definition:
+        case diagnostic_code::nesting_too_deep:
+        case diagnostic_code::line_too_long:
+        case diagnostic_code::unterminated_conditional:
+        case diagnostic_code::duplicate_else:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string diagnostics_sink::format(const diagnostic_t& diagnostic, const line_column_t* position) const {
+    std::string text;
+    if (diagnostic.source < m_sources.size()) text = m_sources[diagnostic.source];
+    if (position) {
+        text += ":" + std::to_string(position->line) + ":" + std::to_string(position->column);
+    }
+    if (!text.empty()) text += ": ";
+    if (has_position(diagnostic.code) && !position) {
+        text += "offset " + std::to_string(diagnostic.offset) + ": ";
+    }
+    const auto argument = std::to_string(diagnostic.argument);
+    switch (diagnostic.code) {
+        case diagnostic_code::cannot_read_file:
+            return text + "cannot read file";
+        case diagnostic_code::invalid_statement:
+            return text + "statement " + argument + " is invalid";
+        case diagnostic_code::unencodable_statement:
+            return text + "statement " + argument + " cannot be encoded";
+        case diagnostic_code::duplicate_definition:
+            return text + "statement " + argument + " defines a symbol already defined";
+        case diagnostic_code::unresolved_symbols:
+            return text + "unresolved symbols";
+        case diagnostic_code::nesting_too_deep:
+            return text + "parentheses nested deeper than " + argument;
+        case diagnostic_code::line_too_long:
+            return text + "line longer than " + argument + " bytes";
+        case diagnostic_code::unmappable_output:
+            return text + "output too large for a debug map";
+        case diagnostic_code::unterminated_conditional:
+            return text + "conditional block not closed by .endif";
+        case diagnostic_code::duplicate_else:
+            return text + "second .else in a conditional block";
+    }
+    return text + "error";
+}
+
+std::string diagnostics_sink::message(const diagnostic_t& diagnostic) const {
+    const auto* lines = (diagnostic.source < m_lines.size()) ? m_lines[diagnostic.source].get() : nullptr;
+    if (!lines || !has_position(diagnostic.code)) return format(diagnostic, nullptr);
+    const auto position = lines->locate(diagnostic.offset);
+    return format(diagnostic, &position);
+}
+
+std::vector<std::string> diagnostics_sink::messages() const {
+    // Entries with a position, by source then offset
+    std::vector<size_t> located;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        const auto& diagnostic = m_entries[i];
+        if (has_position(diagnostic.code) && (diagnostic.source < m_lines.size()) && m_lines[diagnostic.source]) {
+            located.push_back(i);
+        }
+    }
+    std::sort(located.begin(), located.end(), [this] (size_t a, size_t b) {
+        return std::tie(m_entries[a].source, m_entries[a].offset)
+             < std::tie(m_entries[b].source, m_entries[b].offset);
+    });
+    std::vector<line_column_t> positions(m_entries.size());
+    std::vector<bool> has_positions(m_entries.size());
+    std::vector<size_t> offsets;
+    for (size_t first = 0; first < located.size(); ) {
+        const auto source = m_entries[located[first]].source;
+        auto last = first;
+        offsets.clear();
+        while ((last < located.size()) && (m_entries[located[last]].source == source)) {
+            offsets.push_back(m_entries[located[last++]].offset);
+        }
+        const auto found = m_lines[source]->locate(offsets);
+        for (size_t i = first; i < last; ++i) {
+            positions[located[i]] = found[i - first];
+            has_positions[located[i]] = true;
+        }
+        first = last;
+    }
+
+    std::vector<std::string> lines;
+    lines.reserve(m_entries.size());
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        lines.push_back(format(m_entries[i], has_positions[i] ? &positions[i] : nullptr));
+    }
+    return lines;
+}
+
+}
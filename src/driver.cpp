@@ -0,0 +1,199 @@
+#include <sasm/driver.h>
+#include <sasm/build_cache.h>
+#include <sasm/trace.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace sasm {
+
+namespace fs = std::filesystem;
+
+static bool parse_number(const std::string& text, uint64_t& value) {
+    char* end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 0);
+    return !text.empty() && (*end == '\0');
+}
+
+static bool write_file(const std::string& path, std::span<const uint8_t> content) {
+    trace_span span("write", path);
+    std::ofstream output(path, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(content.data()), content.size());
+    return static_cast<bool>(output);
+}
+
+bool parse_arguments(const std::vector<std::string>& arguments, driver_options_t& options) {
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        const auto& arg = arguments[i];
+        const bool has_value = (i + 1 < arguments.size());
+        uint64_t number;
+        if ((arg == "-o") && has_value) {
+            options.output = arguments[++i];
+        } else if (arg == "-c") {
+            options.assemble.relocatable = true;
+        } else if ((arg == "-I") && has_value) {
+            options.include_paths.push_back(arguments[++i]);
+        } else if ((arg == "--origin") && has_value) {
+            if (!parse_number(arguments[++i], number)) return false;
+            options.assemble.origin = number;
+        } else if ((arg == "--max-nesting") && has_value) {
+            if (!parse_number(arguments[++i], number)) return false;
+            options.assemble.limits.max_nesting = number;
+        } else if ((arg == "--max-line-length") && has_value) {
+            if (!parse_number(arguments[++i], number)) return false;
+            options.assemble.limits.max_line_length = number;
+        } else if ((arg == "--cache") && has_value) {
+            options.cache_directory = arguments[++i];
+        } else if ((arg == "--cache-size") && has_value) {
+            if (!parse_number(arguments[++i], options.cache_size)) return false;
+        } else if ((arg == "--server") && has_value) {
+            options.server_socket = arguments[++i];
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg == "--allocations") {
+            options.allocations = true;
+        } else if ((arg == "--trace") && has_value) {
+            options.trace_path = arguments[++i];
+        } else if ((arg == "--debug-map") && has_value) {
+            options.debug_map_path = arguments[++i];
+            options.assemble.debug_map = true;
+        } else if (!arg.empty() && (arg[0] == '-')) {
+            return false;
+        } else {
+            options.sources.push_back(arg);
+        }
+    }
+    // Counts are those of the calling thread, which serves or watches many
+    const auto counted = options.stats || options.profile || options.allocations;
+    if (!options.server_socket.empty()) {
+        return options.sources.empty() && !options.watch && !counted && options.trace_path.empty();
+    }
+    if (options.watch) {
+        if (options.output.empty()) options.output = "a.bin";
+        return !options.sources.empty() && options.cache_directory.empty() && !counted
+            && options.debug_map_path.empty();
+    }
+    if (options.sources.size() != 1) return false;
+    options.source = options.sources.front();
+    if (options.output.empty()) {
+        options.output = fs::path(options.source)
+            .replace_extension(options.assemble.relocatable ? ".o" : ".bin").string();
+    }
+    return true;
+}
+
+const char* usage_text() {
+    return
+        "usage: sasm [options] source\n"
+        "       sasm --watch [options] sources...\n"
+        "       sasm --server <socket>\n"
+        "  -o <path>            output, the source name with .o or .bin by default\n"
+        "  -c                   relocatable object rather than flat binary\n"
+        "  -I <directory>       searched for included files, repeatable\n"
+        "  --origin <addr>      address of the output, 0 by default\n"
+        "  --max-nesting <n>    parentheses nested in an expression, 256 by default, 0 for\n"
+        "                       no limit\n"
+        "  --max-line-length <bytes>\n"
+        "                       length of a line, 1 MiB by default, 0 for no limit\n"
+        "  --cache <directory>  reuse outputs of identical inputs\n"
+        "  --cache-size <bytes> cache size bound, 256 MiB by default\n"
+        "  --server <socket>    serve requests from sasm-client, keeping sources in memory\n"
+        "  --watch              assemble and link the sources, again whenever a file changes\n"
+        "  --stats              counts of characters, tokens, scopes and statements, in builds\n"
+        "                       configured with SASM_STATS\n"
+        "  --profile            attempts and time of each grammar rule, lines staged again\n"
+        "                       the most, in builds configured with SASM_PROFILE\n"
+        "  --allocations        allocations by pipeline stage, in builds configured with\n"
+        "                       SASM_ALLOCATIONS\n"
+        "  --trace <path>       Chrome trace events of each phase, file and thread\n"
+        "  --debug-map <path>   source file, line and column of each output address, the\n"
+        "                       build cache is not used\n";
+}
+
+void make_absolute(driver_options_t& options, const std::string& directory) {
+    const auto absolute = [&] (std::string& path) {
+        if (!path.empty() && fs::path(path).is_relative()) {
+            path = (fs::path(directory) / path).lexically_normal().string();
+        }
+    };
+    absolute(options.source);
+    for (auto& path : options.sources) absolute(path);
+    absolute(options.output);
+    absolute(options.cache_directory);
+    absolute(options.debug_map_path);
+    for (auto& path : options.include_paths) absolute(path);
+}
+
+std::string output_settings(const driver_options_t& options) {
+    auto settings = "origin=" + std::to_string(options.assemble.origin)
+        + ";relocatable=" + std::to_string(options.assemble.relocatable)
+        + ";max_nesting=" + std::to_string(options.assemble.limits.max_nesting)
+        + ";max_line_length=" + std::to_string(options.assemble.limits.max_line_length);
+    for (const auto& path : options.include_paths) settings += ";include=" + path;
+    return settings;
+}
+
+bool run_driver(const driver_options_t& options, source_manager& sources, driver_result_t& result) {
+    result = {};
+
+    // Everything which changes the output for the same source bytes
+    // The cache keeps outputs only, a debug map needs the sources parsed
+    std::unique_ptr<build_cache> cache;
+    uint64_t key = 0;
+    if (!options.cache_directory.empty() && options.debug_map_path.empty()) {
+        cache = std::make_unique<build_cache>(options.cache_directory, options.cache_size);
+        mapped_file file;
+        if (!file.open(options.source)) {
+            result.messages.push_back(options.source + ": cannot read file");
+            return false;
+        }
+        // Relative includes resolve from the directory, the same bytes elsewhere
+        // may include other files
+        key = build_cache::source_key(file.bytes(), sources.resolve(options.source) + '\n'
+            + sources.directory() + '\n' + output_settings(options));
+        mapped_file cached;
+        if (cache->find(key, cached)) {
+            result.output.assign(cached.bytes().begin(), cached.bytes().end());
+            result.cached = true;
+            if (!write_file(options.output, result.output)) {
+                result.messages.push_back("cannot write " + options.output);
+                return false;
+            }
+            return true;
+        }
+    }
+
+    assembly_t assembly;
+    const auto before = thread_stats();
+    if (options.profile) thread_profile().clear();
+    const auto success = assemble(options.source, sources, options.assemble, assembly);
+    result.messages = assembly.errors.messages();
+    if (options.stats) {
+        result.stats = thread_stats();
+        result.stats -= before;
+    }
+    if (options.profile) result.profile = thread_profile();
+    if (!success) return false;
+
+    result.dependencies = std::move(assembly.dependencies);
+    if (!serialize(assembly, result.output) || !write_file(options.output, result.output)) {
+        result.messages.push_back("cannot write " + options.output);
+        return false;
+    }
+    if (!options.debug_map_path.empty()
+        && !write_debug_map(assembly.debug_map, options.debug_map_path)) {
+        result.messages.push_back("cannot write " + options.debug_map_path);
+        return false;
+    }
+    if (cache) {
+        cache->store(key, result.dependencies, result.output);
+    }
+    return true;
+}
+
+}
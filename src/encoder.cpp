@@ -0,0 +1,527 @@
+#include <sasm/encoder.h>
+#include <sasm/allocation.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SASM_HAS_POSIX_IO 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace sasm {
+
+namespace instruction_set {
+
+static std::optional<uint8_t> find_opcode(instruction_name operation, addressing_mode addressing) {
+    using name = instruction_name;
+    using mode = addressing_mode;
+    static const std::map<std::pair<instruction_name, addressing_mode>, uint8_t> opcodes {
+        { { name::ADC, mode::immediate }, 0x69 },
+        { { name::ADC, mode::zeropage }, 0x65 },
+        { { name::ADC, mode::zeropage_x }, 0x75 },
+        { { name::ADC, mode::absolute }, 0x6D },
+        { { name::ADC, mode::absolute_x }, 0x7D },
+        { { name::ADC, mode::absolute_y }, 0x79 },
+        { { name::ADC, mode::indexed_indirect }, 0x61 },
+        { { name::ADC, mode::indirect_indexed }, 0x71 },
+        { { name::BCC, mode::relative }, 0x90 },
+        { { name::JMP, mode::absolute }, 0x4C },
+        { { name::JMP, mode::indirect }, 0x6C },
+        { { name::LDX, mode::immediate }, 0xA2 },
+        { { name::LDX, mode::zeropage }, 0xA6 },
+        { { name::LDX, mode::zeropage_y }, 0xB6 },
+        { { name::LDX, mode::absolute }, 0xAE },
+        { { name::LDX, mode::absolute_y }, 0xBE },
+        { { name::LDY, mode::immediate }, 0xA0 },
+        { { name::LDY, mode::zeropage }, 0xA4 },
+        { { name::LDY, mode::zeropage_x }, 0xB4 },
+        { { name::LDY, mode::absolute }, 0xAC },
+        { { name::LDY, mode::absolute_x }, 0xBC },
+        { { name::NOP, mode::implied }, 0xEA },
+        { { name::ROL, mode::accumulator }, 0x2A },
+        { { name::ROL, mode::zeropage }, 0x26 },
+        { { name::ROL, mode::zeropage_x }, 0x36 },
+        { { name::ROL, mode::absolute }, 0x2E },
+        { { name::ROL, mode::absolute_x }, 0x3E },
+    };
+    const auto it = opcodes.find({ operation, addressing });
+    if (it != opcodes.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+}
+
+std::span<const uint8_t> fragment_t::content() const {
+    if (is_file()) return file->bytes().subspan(file_offset, file_size);
+    return bytes;
+}
+
+encoder::encoder(size_t origin, bool relocatable)
+: m_origin(origin)
+, m_relocatable(relocatable)
+, m_size(0)
+{}
+
+std::vector<uint8_t>& encoder::owned_bytes() {
+    if (m_fragments.empty() || m_fragments.back().is_file()) {
+        m_fragments.emplace_back();
+    }
+    return m_fragments.back().bytes;
+}
+
+void encoder::emit(uint8_t byte) {
+    owned_bytes().push_back(byte);
+    ++m_size;
+}
+
+void encoder::emit_word(uint16_t word) {
+    emit(word & 0xFF);
+    emit(word >> 8);
+}
+
+bool encoder::emit_field(fixup_t::field_kind field, const expression_t& expr, value_t bias) {
+    fixup_t fixup { field, 0, 0, m_size, expr, bias };
+    owned_bytes();
+    fixup.fragment = m_fragments.size() - 1;
+    fixup.offset = m_fragments.back().bytes.size();
+
+    if (field == fixup_t::u16) {
+        emit_word(0);
+    } else {
+        emit(0);
+    }
+
+    value_t value;
+    if (evaluate(fixup.expr, value)) {
+        return write_field(fixup, value);
+    }
+    // Without names, it fails for good
+    const auto named = std::any_of(expr.content.begin(), expr.content.end(), [] (const expression_item_t& item) {
+        return !item.is<expression_item_t::value>() && !item.is<expression_item_t::operation>();
+    });
+    if (!named) return false;
+    m_fixups.push_back(std::move(fixup));
+    return true;
+}
+
+bool write_field(fixup_t::field_kind field, value_t value, value_t bias,
+                 size_t address, uint8_t* data) {
+    switch (field) {
+        case fixup_t::u8: {
+            if (!dtype::is_u8(value) && !dtype::is_i8(value)) return false;
+            data[0] = value & 0xFF;
+            return true;
+        }
+        case fixup_t::u16: {
+            if (!dtype::is_u16(value) && !dtype::is_i16(value)) return false;
+            data[0] = value & 0xFF;
+            data[1] = (value >> 8) & 0xFF;
+            return true;
+        }
+        case fixup_t::i8: {
+            value_t offset;
+            if (__builtin_add_overflow(value, bias, &offset) || !dtype::is_i8(offset)) return false;
+            data[0] = offset & 0xFF;
+            return true;
+        }
+        case fixup_t::relative8: {
+            const auto next = static_cast<value_t>(address + 1);
+            value_t offset;
+            if (__builtin_sub_overflow(value, next, &offset) || !dtype::is_i8(offset)) return false;
+            data[0] = offset & 0xFF;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool encoder::write_field(const fixup_t& fixup, value_t value) {
+    auto& bytes = m_fragments[fixup.fragment].bytes;
+    return sasm::write_field(fixup.field, value, fixup.bias,
+                             m_origin + fixup.address, bytes.data() + fixup.offset);
+}
+
+bool encoder::lookup(const reference_t& name, value_t& value, bool with_labels, int depth) const {
+    const auto it = m_symbols.find(name);
+    if (it == m_symbols.end()) return false;
+    const auto& symbol = it->second;
+    if (symbol.kind == symbol_t::label) {
+        value = symbol.value;
+        return with_labels;
+    }
+    return evaluate(symbol.expr, value, with_labels, depth + 1);
+}
+
+bool encoder::evaluate(const expression_t& expr, value_t& value, bool with_labels, int depth) const {
+    // Guards against defines referencing each other
+    static constexpr int max_depth = 64;
+    if (depth > max_depth) return false;
+    return sasm::evaluate(expr, [&] (const reference_t& name, value_t& result) {
+        return lookup(name, result, with_labels, depth);
+    }, [&] (const expression_item_t& label, value_t& result) {
+        return label_address(label, result) && with_labels;
+    }, value);
+}
+
+bool encoder::evaluate(const expression_t& expr, value_t& value, bool with_labels) const {
+    return evaluate(expr, value, with_labels, 0);
+}
+
+bool encoder::evaluate(const expression_t& expr, value_t& value) const {
+    return evaluate(expr, value, !m_relocatable, 0);
+}
+
+bool encoder::define_symbol(std::string_view name, symbol_t symbol) {
+    m_redefined = !m_symbols.emplace(name, std::move(symbol)).second;
+    return !m_redefined;
+}
+
+bool encoder::define_label(expression_item_t::ekind kind, uint32_t scope, value_t label) {
+    if (label < 0) return false;
+    auto* addresses = &m_anonymous_labels;
+    if (kind == expression_item_t::local_label) {
+        if (scope >= m_local_labels.size()) m_local_labels.resize(scope + 1);
+        addresses = &m_local_labels[scope];
+    }
+    const auto slot = static_cast<size_t>(label);
+    if (slot >= addresses->size()) addresses->resize(slot + 1, undefined_label);
+    m_redefined = (*addresses)[slot] != undefined_label;
+    if (m_redefined) return false;
+    (*addresses)[slot] = static_cast<value_t>(m_origin + m_size);
+    return true;
+}
+
+bool encoder::label_address(const expression_item_t& label, value_t& address) const {
+    const auto* addresses = &m_anonymous_labels;
+    if (label.is<expression_item_t::local_label>()) {
+        if (label.scope >= m_local_labels.size()) return false;
+        addresses = &m_local_labels[label.scope];
+    }
+    if ((label.val < 0) || (size_t(label.val) >= addresses->size())) return false;
+    address = (*addresses)[label.val];
+    return address != undefined_label;
+}
+
+bool encoder::encode_instruction(instruction_set::instruction_name name,
+                                 instruction_set::addressing_style style,
+                                 const operand_t& operand) {
+    using namespace instruction_set;
+    using enum addressing_mode;
+
+    const auto emit_opcode = [&] (addressing_mode mode) {
+        const auto opcode = find_opcode(name, mode);
+        if (opcode) emit(*opcode);
+        return opcode.has_value();
+    };
+
+    // Zeropage when the operand is known to fit, absolute otherwise
+    const auto encode_direct = [&] (addressing_mode zeropage_mode,
+                                    addressing_mode absolute_mode) {
+        bool is_short = (operand.type == dtype::u8);
+        value_t value;
+        if ((operand.type == dtype::any) && evaluate(operand, value)) {
+            is_short = dtype::is_u8(value);
+        }
+        if (is_short && find_opcode(name, zeropage_mode)) {
+            return emit_opcode(zeropage_mode) && emit_field(fixup_t::u8, operand);
+        }
+        return emit_opcode(absolute_mode) && emit_field(fixup_t::u16, operand);
+    };
+
+    switch (style) {
+        case addressing_style::no_op: {
+            return emit_opcode(implied) || emit_opcode(accumulator);
+        }
+        case addressing_style::immediate: {
+            return emit_opcode(immediate) && emit_field(fixup_t::u8, operand);
+        }
+        case addressing_style::relative: {
+            // Offset from the instruction start, the branch is 2 bytes long
+            return emit_opcode(relative) && emit_field(fixup_t::i8, operand, -2);
+        }
+        case addressing_style::direct: {
+            if (find_opcode(name, relative)) {
+                return emit_opcode(relative) && emit_field(fixup_t::relative8, operand);
+            }
+            return encode_direct(zeropage, absolute);
+        }
+        case addressing_style::direct_x: {
+            return encode_direct(zeropage_x, absolute_x);
+        }
+        case addressing_style::direct_y: {
+            return encode_direct(zeropage_y, absolute_y);
+        }
+        case addressing_style::indirect: {
+            return emit_opcode(indirect) && emit_field(fixup_t::u16, operand);
+        }
+        case addressing_style::indirect_x: {
+            return emit_opcode(indexed_indirect) && emit_field(fixup_t::u8, operand);
+        }
+        case addressing_style::indirect_y: {
+            return emit_opcode(indirect_indexed) && emit_field(fixup_t::u8, operand);
+        }
+        default:
+            return false;
+    }
+}
+
+bool encoder::encode_data(const operand_t& value) {
+    if (value.type == dtype::u16) return emit_field(fixup_t::u16, value);
+    return emit_field(fixup_t::u8, value);
+}
+
+bool encoder::encode_data_block(const data_block_t& block) {
+    if (const auto bytes = std::get_if<std::vector<uint8_t>>(&block)) {
+        auto& output = owned_bytes();
+        output.insert(output.end(), bytes->begin(), bytes->end());
+        m_size += bytes->size();
+    } else {
+        for (const auto word : std::get<std::vector<uint16_t>>(block)) {
+            emit_word(word);
+        }
+    }
+    return true;
+}
+
+bool encoder::encode_align(const operand_t& value) {
+    value_t alignment;
+    if (!evaluate(value, alignment) || (alignment <= 0)) return false;
+    while ((m_origin + m_size) % alignment != 0) {
+        emit(0);
+    }
+    return true;
+}
+
+bool encoder::encode_binary_include(const std::string& path,
+                                    const operand_t* offset_operand, const operand_t* length_operand) {
+    auto& file = m_files[path];
+    if (!file) {
+        auto mapped = std::make_shared<mapped_file>();
+        // Kept open for the kernel side copy of write()
+        if (!mapped->open(path, true)) {
+            m_files.erase(path);
+            return false;
+        }
+        file = std::move(mapped);
+    }
+
+    value_t offset = 0;
+    if (offset_operand && !evaluate(*offset_operand, offset)) return false;
+    if ((offset < 0) || (static_cast<size_t>(offset) > file->size())) return false;
+
+    value_t length = static_cast<value_t>(file->size() - offset);
+    if (length_operand && !evaluate(*length_operand, length)) return false;
+    if ((length < 0) || (static_cast<size_t>(length) > file->size() - static_cast<size_t>(offset))) return false;
+
+    if (length > 0) {
+        fragment_t fragment;
+        fragment.file = file;
+        fragment.file_offset = offset;
+        fragment.file_size = length;
+        m_fragments.push_back(std::move(fragment));
+        m_size += length;
+    }
+    return true;
+}
+
+bool encoder::encode(const parser_token& token) {
+    if (token.eof()) return true;
+    statement_context context;
+    return encode(make_statement(token, context), context, token.source, token.offset);
+}
+
+bool encoder::encode(const statement_t& statement, const statement_context& context,
+                     uint32_t source, size_t offset) {
+    allocation_scope scope(allocation_stage::encoder);
+    m_redefined = false;
+    const auto start = m_size;
+    const bool success = encode_statement(statement, context);
+    // Padding after a jump is not run either
+    if ((m_size > start) && !std::holds_alternative<statement::align>(statement)) {
+        const auto* instruction = std::get_if<statement::instruction>(&statement);
+        m_falls_through = !instruction || (instruction->name != instruction_set::instruction_name::JMP);
+    }
+    if (!m_tracks_positions) return success;
+    const auto same_line = !m_positions.empty()
+        && (m_positions.back().source == source) && (m_positions.back().offset == offset);
+    if ((m_size > start) && !same_line) {
+        m_positions.push_back({ m_origin + start, source, offset });
+    }
+    return success;
+}
+
+void encoder::track_positions() {
+    m_tracks_positions = true;
+}
+
+const std::vector<output_position_t>& encoder::positions() const {
+    return m_positions;
+}
+
+bool encoder::redefined() const {
+    return m_redefined;
+}
+
+bool encoder::encode_statement(const statement_t& statement, const statement_context& context) {
+    static const operand_t no_operand;
+    return std::visit([&] (const auto& payload) {
+        using payload_t = std::decay_t<decltype(payload)>;
+        if constexpr (std::is_same_v<payload_t, statement::instruction>) {
+            return encode_instruction(payload.name, payload.style,
+                                      payload.operand ? *payload.operand : no_operand);
+        } else if constexpr (std::is_same_v<payload_t, statement::label>) {
+            return define_symbol(context.names[payload.name], {
+                symbol_t::label, static_cast<value_t>(m_origin + m_size), {}, m_falls_through });
+        } else if constexpr (std::is_same_v<payload_t, statement::local_label>) {
+            return define_label(expression_item_t::local_label, payload.scope, payload.slot);
+        } else if constexpr (std::is_same_v<payload_t, statement::anonymous_label>) {
+            return define_label(expression_item_t::anonymous_label, 0, payload.rank);
+        } else if constexpr (std::is_same_v<payload_t, statement::define>) {
+            return define_symbol(context.names[payload.name], {
+                symbol_t::define, 0, *payload.value, true });
+        } else if constexpr (std::is_same_v<payload_t, statement::align>) {
+            return encode_align(*payload.value);
+        } else if constexpr (std::is_same_v<payload_t, statement::data>) {
+            return encode_data(*payload.value);
+        } else if constexpr (std::is_same_v<payload_t, statement::data_block>) {
+            return encode_data_block(*payload.values);
+        } else if constexpr (std::is_same_v<payload_t, statement::binary_include>) {
+            return encode_binary_include(std::string(context.names[payload.path]),
+                                         payload.offset, payload.length);
+        } else if constexpr (std::is_same_v<payload_t, statement::import_symbol>) {
+            m_imports.emplace(context.names[payload.name]);
+            return true;
+        } else if constexpr (std::is_same_v<payload_t, statement::export_symbol>) {
+            m_exports.emplace(context.names[payload.name]);
+            return true;
+        } else {
+            return false;
+        }
+    }, statement);
+}
+
+bool encoder::finish() {
+    std::vector<fixup_t> remaining;
+    for (auto& fixup : m_fixups) {
+        value_t value;
+        if (!evaluate(fixup.expr, value) || !write_field(fixup, value)) {
+            remaining.push_back(std::move(fixup));
+        }
+    }
+    m_fixups = std::move(remaining);
+    return m_fixups.empty();
+}
+
+size_t encoder::origin() const {
+    return m_origin;
+}
+
+bool encoder::relocatable() const {
+    return m_relocatable;
+}
+
+size_t encoder::size() const {
+    return m_size;
+}
+
+const std::vector<fragment_t>& encoder::fragments() const {
+    return m_fragments;
+}
+
+const std::vector<fixup_t>& encoder::fixups() const {
+    return m_fixups;
+}
+
+const std::map<std::string, symbol_t>& encoder::symbols() const {
+    return m_symbols;
+}
+
+const std::set<std::string>& encoder::imports() const {
+    return m_imports;
+}
+
+const std::set<std::string>& encoder::exports() const {
+    return m_exports;
+}
+
+std::vector<std::string> encoder::binary_includes() const {
+    std::vector<std::string> paths;
+    for (const auto& [path, file] : m_files) {
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+std::vector<uint8_t> encoder::flatten() const {
+    std::vector<uint8_t> output(m_size);
+    size_t position = 0;
+    for (const auto& fragment : m_fragments) {
+        const auto content = fragment.content();
+        if (!content.empty()) {
+            std::memcpy(output.data() + position, content.data(), content.size());
+        }
+        position += content.size();
+    }
+    return output;
+}
+
+bool encoder::write(const std::string& path) const {
+#ifdef SASM_HAS_POSIX_IO
+    const int output = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output < 0) return false;
+
+    const auto write_all = [output] (const uint8_t* data, size_t size) {
+        while (size > 0) {
+            const auto written = ::write(output, data, size);
+            if (written <= 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    };
+
+    bool success = true;
+    for (const auto& fragment : m_fragments) {
+        if (!success) break;
+#ifdef __linux__
+        if (fragment.is_file() && (fragment.file->descriptor() >= 0)) {
+            // Kernel side copy, the content does not go through user space
+            loff_t offset = fragment.file_offset;
+            size_t remaining = fragment.file_size;
+            while (remaining > 0) {
+                const auto copied = ::copy_file_range(fragment.file->descriptor(), &offset,
+                                                      output, nullptr, remaining, 0);
+                if (copied <= 0) break;
+                remaining -= copied;
+            }
+            if (remaining == 0) continue;
+            const auto content = fragment.content();
+            const auto done = fragment.file_size - remaining;
+            success = write_all(content.data() + done, remaining);
+            continue;
+        }
+#endif
+        const auto content = fragment.content();
+        success = write_all(content.data(), content.size());
+    }
+    return (::close(output) == 0) && success;
+#else
+    std::ofstream output(path, std::ios::binary);
+    for (const auto& fragment : m_fragments) {
+        const auto content = fragment.content();
+        output.write(reinterpret_cast<const char*>(content.data()), content.size());
+    }
+    return static_cast<bool>(output);
+#endif
+}
+
+}
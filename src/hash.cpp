@@ -0,0 +1,111 @@
+#include <sasm/hash.h>
+
+#include <bit>
+#include <cstring>
+
+namespace sasm {
+
+namespace {
+
+constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) value = __builtin_bswap64(value);
+    return value;
+}
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) value = __builtin_bswap32(value);
+    return value;
+}
+
+uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * prime2;
+    accumulator = std::rotl(accumulator, 31);
+    return accumulator * prime1;
+}
+
+uint64_t merge_round(uint64_t accumulator, uint64_t value) {
+    accumulator ^= hash_round(0, value);
+    return accumulator * prime1 + prime4;
+}
+
+}
+
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    const auto* const end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        // Four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        for (const auto* limit = end - 32; p <= limit; p += 32) {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+        }
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += size;
+
+    for (; p + 8 <= end; p += 8) {
+        hash ^= hash_round(0, read64(p));
+        hash = std::rotl(hash, 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= read32(p) * prime1;
+        hash = std::rotl(hash, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * prime5;
+        hash = std::rotl(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+hash_builder& hash_builder::add(std::span<const uint8_t> bytes) {
+    m_parts.push_back(xxhash64(bytes.data(), bytes.size()));
+    return *this;
+}
+
+hash_builder& hash_builder::add(std::string_view text) {
+    m_parts.push_back(xxhash64(text.data(), text.size()));
+    return *this;
+}
+
+hash_builder& hash_builder::add(uint64_t value) {
+    m_parts.push_back(value);
+    return *this;
+}
+
+uint64_t hash_builder::digest() const {
+    return xxhash64(m_parts.data(), m_parts.size() * sizeof(uint64_t));
+}
+
+}
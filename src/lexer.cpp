@@ -1,5 +1,8 @@
 #include <sasm/lexer.h>
+#include <sasm/allocation.h>
+#include <sasm/stats.h>
 
+#include <algorithm>
 #include <vector>
 
 namespace sasm {
@@ -15,7 +18,8 @@ bool lexer::is_whitespace(char c) {
 
 bool lexer::is_identifier_head(char c) {
     return std::isalpha(c)
-        || (c == '_');
+        || (c == '_')
+        || (c == '@');
 }
 
 bool lexer::is_identifier(char c) {
@@ -57,6 +61,14 @@ bool lexer::is_symbol(char c) {
     return symbols.find(c) != std::string::npos;
 }
 
+bool lexer::is_string_delimiter(char c) {
+    return (c == '"');
+}
+
+bool lexer::is_string_escape(char c) {
+    return (c == '\\');
+}
+
 lexer::lexer(reader* reader)
 : m_reader(reader)
 , m_was_whitespace(false)
@@ -66,7 +78,16 @@ lexer::lexer(reader* reader)
 }
 
 lexer_token lexer::get() {
-    std::vector<char> buffer;
+    allocation_scope scope(allocation_stage::lexer);
+    auto token = read();
+    SASM_STAT(tokens[token.type]);
+    if (token.is_trivia) SASM_STAT(trivia);
+    return token;
+}
+
+lexer_token lexer::read() {
+    // Content of the short tokens stays in the string, with no allocation
+    std::string buffer;
     const size_t offset = m_current.offset;
     size_t width = 0;
 
@@ -80,12 +101,13 @@ lexer_token lexer::get() {
         width += m_current.width;
         buffer.push_back(m_current.value);
         m_current = m_reader->get();
+        SASM_STAT(characters);
     };
 
     const auto token = [&] (lexer_token::token_type type, bool is_trivia = false) -> lexer_token {
         return {
             type,
-            std::string(buffer.cbegin(), buffer.cend()),
+            std::move(buffer),
             offset,
             width,
             whitespace_before,
@@ -164,6 +186,28 @@ lexer_token lexer::get() {
         return token(lexer_token::literal);
     }
     
+    if (is_string_delimiter(m_current.value)) {
+        next();
+        const auto is_line_end = [&] () {
+            return m_current.eof()
+                || (m_current.value == '\r')
+                || (m_current.value == '\n');
+        };
+        while (!is_line_end() && !is_string_delimiter(m_current.value)) {
+            if (is_string_escape(m_current.value)) {
+                next();
+                if (is_line_end()) break;
+            }
+            next();
+        }
+        if (is_string_delimiter(m_current.value)) {
+            next();
+            return token(lexer_token::string_literal);
+        }
+        // Unterminated string
+        return token(lexer_token::unknown);
+    }
+
     if (is_symbol(m_current.value)) {
         next();
         return token(lexer_token::symbol);
@@ -183,4 +227,17 @@ lexer_token lexer::get() {
     return token(lexer_token::unknown);
 }
 
+void lexer::skip_to_directive_line() {
+    if (!m_was_end_of_line || m_current.eof()) return;
+    m_reader->seek(m_reader->find_directive_line(m_current.offset));
+    m_current = m_reader->get();
+    m_was_whitespace = false;
+}
+
+generator<lexer_token> lexer::tokens(std::pmr::memory_resource*) {
+    for (auto token = get(); !token.eof(); token = get()) {
+        co_yield token;
+    }
+}
+
 }
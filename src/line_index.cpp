@@ -0,0 +1,77 @@
+#include <sasm/line_index.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sasm {
+
+void find_line_starts(const char* data, size_t size, std::vector<size_t>& starts) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // Sixteen bytes compared at once, the mask has a bit for each line feed
+    const auto line_feed = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, line_feed)));
+        while (mask != 0) {
+            starts.push_back(i + std::countr_zero(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == '\n') starts.push_back(i + 1);
+    }
+}
+
+line_index::line_index(std::shared_ptr<const mapped_file> file)
+: m_file(std::move(file))
+, m_data(reinterpret_cast<const char*>(m_file->data()))
+, m_size(m_file->size())
+{}
+
+line_index::line_index(const char* data, size_t size)
+: m_data(data)
+, m_size(size)
+{}
+
+const std::vector<size_t>& line_index::starts() const {
+    std::call_once(m_built, [this] {
+        m_starts.push_back(0);
+        find_line_starts(m_data, m_size, m_starts);
+    });
+    return m_starts;
+}
+
+line_column_t line_index::locate(size_t offset) const {
+    const auto& lines = starts();
+    const auto next = std::upper_bound(lines.begin() + 1, lines.end(), offset);
+    const auto line = static_cast<size_t>(next - lines.begin());
+    return { line, offset - lines[line - 1] + 1 };
+}
+
+std::vector<line_column_t> line_index::locate(std::span<const size_t> offsets) const {
+    const auto& lines = starts();
+    std::vector<line_column_t> result;
+    result.reserve(offsets.size());
+    auto next = lines.begin() + 1;
+    for (const auto offset : offsets) {
+        if (offset < *(next - 1)) next = lines.begin() + 1;
+        next = std::upper_bound(next, lines.end(), offset);
+        const auto line = static_cast<size_t>(next - lines.begin());
+        result.push_back({ line, offset - lines[line - 1] + 1 });
+    }
+    return result;
+}
+
+size_t line_index::lines() const {
+    return starts().size();
+}
+
+}
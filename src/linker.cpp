@@ -0,0 +1,476 @@
+#include <sasm/linker.h>
+#include <sasm/parallel.h>
+#include <sasm/trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <tuple>
+
+namespace sasm {
+
+export_table::shard_t& export_table::shard(std::string_view name) {
+    const auto hash = std::hash<std::string_view>()(name);
+    // High bits, the low ones are used by the shard buckets
+    return m_shards[(hash >> 24) % shard_count];
+}
+
+const export_table::shard_t& export_table::shard(std::string_view name) const {
+    return const_cast<export_table*>(this)->shard(name);
+}
+
+bool export_table::insert(std::string_view name, export_ref_t ref, export_ref_t& existing) {
+    auto& target = shard(name);
+    std::lock_guard lock(target.mutex);
+    const auto [it, inserted] = target.symbols.emplace(name, ref);
+    if (!inserted) existing = it->second;
+    return inserted;
+}
+
+const export_ref_t* export_table::find(std::string_view name) const {
+    const auto& target = shard(name);
+    const auto it = target.symbols.find(name);
+    if (it == target.symbols.end()) return nullptr;
+    return &it->second;
+}
+
+void export_table::erase(std::string_view name) {
+    auto& target = shard(name);
+    std::lock_guard lock(target.mutex);
+    target.symbols.erase(name);
+}
+
+void export_table::clear() {
+    for (auto& shard : m_shards) shard.symbols.clear();
+}
+
+size_t export_table::size() const {
+    size_t size = 0;
+    for (const auto& shard : m_shards) size += shard.symbols.size();
+    return size;
+}
+
+// Region of a section containing an offset, the last one for the end
+static size_t region_at(const link_module_t& module, uint32_t section, int64_t offset) {
+    if (section + 1 >= module.section_regions.size()) return link_module_t::no_region;
+    const auto first = module.regions.begin() + module.section_regions[section];
+    const auto last = module.regions.begin() + module.section_regions[section + 1];
+    auto it = std::upper_bound(first, last, offset, [] (int64_t offset, const region_t& region) {
+        return offset < region.offset;
+    });
+    if (it != first) --it;
+    return static_cast<size_t>(it - module.regions.begin());
+}
+
+linker::linker(size_t origin, size_t threads)
+: m_origin(origin)
+, m_threads(threads)
+, m_reclaimed(0)
+, m_reclaimed_regions(0)
+, m_relocated(0)
+, m_linked(false)
+{}
+
+void linker::add_entry(const std::string& name) {
+    m_entries.push_back(name);
+}
+
+void linker::error(std::string message) {
+    std::lock_guard lock(m_errors_mutex);
+    m_errors.push_back(std::move(message));
+}
+
+bool linker::symbol_value(const link_module_t& module, uint32_t index, value_t& value) const {
+    const auto symbols = module.file.view().symbols();
+    if (index >= symbols.size()) return false;
+    const auto& symbol = symbols[index];
+    if (symbol.kind == object_format::symbol::constant) {
+        value = symbol.value;
+        return true;
+    }
+    const auto r = module.symbol_regions[index];
+    if ((r == link_module_t::no_region) || !module.regions[r].live) return false;
+    const auto& region = module.regions[r];
+    value = static_cast<value_t>(region.address) + symbol.value - static_cast<value_t>(region.offset);
+    return true;
+}
+
+bool linker::load(const std::vector<std::string>& paths) {
+    m_modules.clear();
+    for (const auto& path : paths) {
+        auto module = std::make_unique<link_module_t>();
+        module->path = path;
+        m_modules.push_back(std::move(module));
+    }
+    std::atomic<bool> success = true;
+    parallel_for(m_modules.size(), [&] (size_t i) {
+        auto& module = *m_modules[i];
+        trace_span span("link.load", module.path);
+        if (!module.file.open(module.path)) {
+            error(module.path + ": not a valid object file");
+            success = false;
+        }
+    }, m_threads);
+    return success;
+}
+
+bool linker::collect_exports() {
+    trace_span span("link.exports");
+    std::atomic<bool> success = true;
+    parallel_for(m_modules.size(), [&] (size_t i) {
+        const auto& view = m_modules[i]->file.view();
+        const auto symbols = view.symbols();
+        for (uint32_t s = 0; s < symbols.size(); ++s) {
+            if (!symbols[s].is_exported()) continue;
+            const auto name = view.string(symbols[s].name);
+            export_ref_t existing;
+            if (!m_exports.insert(name, { static_cast<uint32_t>(i), s }, existing)) {
+                const auto first = std::min<size_t>(i, existing.module);
+                const auto second = std::max<size_t>(i, existing.module);
+                error(std::string(name) + " exported by both " + m_modules[first]->path
+                      + " and " + m_modules[second]->path);
+                success = false;
+            }
+        }
+    }, m_threads);
+    return success;
+}
+
+bool linker::resolve_imports() {
+    trace_span span("link.imports");
+    std::atomic<bool> success = true;
+    parallel_for(m_modules.size(), [&] (size_t i) {
+        auto& module = *m_modules[i];
+        const auto& view = module.file.view();
+        const auto imports = view.imports();
+        module.imports.assign(imports.size(), {});
+        for (size_t m = 0; m < imports.size(); ++m) {
+            const auto name = view.string(imports[m].name);
+            const auto* ref = m_exports.find(name);
+            if (!ref) {
+                error(module.path + ": unresolved symbol " + std::string(name));
+                success = false;
+                continue;
+            }
+            module.imports[m] = *ref;
+        }
+    }, m_threads);
+    return success;
+}
+
+void linker::partition_module(link_module_t& module) {
+    const auto& view = module.file.view();
+    const auto sections = view.sections();
+    const auto symbols = view.symbols();
+
+    // Sections are cut at their exported labels only entered by jumps
+    std::vector<std::vector<uint32_t>> cuts(sections.size(), std::vector<uint32_t>(1, 0));
+    if (!m_entries.empty()) {
+        for (const auto& symbol : symbols) {
+            if (!symbol.is_exported() || !symbol.is_entered()) continue;
+            if (symbol.kind != object_format::symbol::label) continue;
+            if (symbol.section >= sections.size()) continue;
+            if ((symbol.value <= 0) || (uint32_t(symbol.value) >= sections[symbol.section].size)) continue;
+            cuts[symbol.section].push_back(static_cast<uint32_t>(symbol.value));
+        }
+    }
+    module.regions.clear();
+    module.section_regions.clear();
+    for (uint32_t s = 0; s < sections.size(); ++s) {
+        auto& points = cuts[s];
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+        module.section_regions.push_back(module.regions.size());
+        for (size_t k = 0; k < points.size(); ++k) {
+            const auto end = (k + 1 < points.size()) ? points[k + 1] : sections[s].size;
+            module.regions.push_back({ s, points[k], end - points[k] });
+        }
+    }
+    module.section_regions.push_back(module.regions.size());
+
+    module.symbol_regions.resize(symbols.size());
+    for (size_t s = 0; s < symbols.size(); ++s) {
+        module.symbol_regions[s] = (symbols[s].kind == object_format::symbol::label)
+            ? region_at(module, symbols[s].section, symbols[s].value)
+            : link_module_t::no_region;
+    }
+
+    // Relocations bucketed by region, in one pass
+    const auto relocations = view.relocations();
+    std::vector<size_t> regions(relocations.size());
+    module.region_relocations.assign(module.regions.size() + 1, 0);
+    for (size_t r = 0; r < relocations.size(); ++r) {
+        regions[r] = region_at(module, relocations[r].section, relocations[r].offset);
+        ++module.region_relocations[regions[r] + 1];
+    }
+    for (size_t r = 1; r < module.region_relocations.size(); ++r) {
+        module.region_relocations[r] += module.region_relocations[r - 1];
+    }
+    auto next = module.region_relocations;
+    module.relocations.resize(relocations.size());
+    for (size_t r = 0; r < relocations.size(); ++r) {
+        module.relocations[next[regions[r]]++] = static_cast<uint32_t>(r);
+    }
+}
+
+void linker::partition() {
+    trace_span span("link.partition");
+    parallel_for(m_modules.size(), [&] (size_t i) {
+        partition_module(*m_modules[i]);
+    }, m_threads);
+}
+
+bool linker::collect_garbage() {
+    trace_span span("link.gc");
+    m_reclaimed = 0;
+    m_reclaimed_regions = 0;
+    if (m_entries.empty()) return true;
+
+    // Marks regions as they are found, each one is walked once
+    for (auto& module : m_modules) {
+        for (auto& region : module->regions) region.live = false;
+    }
+    std::vector<std::pair<size_t, size_t>> pending;
+    const auto mark = [&] (size_t module, size_t region) {
+        if (region == link_module_t::no_region) return;
+        auto& target = m_modules[module]->regions[region];
+        if (target.live) return;
+        target.live = true;
+        pending.emplace_back(module, region);
+    };
+
+    bool success = true;
+    for (const auto& name : m_entries) {
+        const auto* ref = m_exports.find(name);
+        if (!ref) {
+            error("entry symbol " + name + " not found");
+            success = false;
+            continue;
+        }
+        mark(ref->module, m_modules[ref->module]->symbol_regions[ref->symbol]);
+    }
+    while (!pending.empty()) {
+        const auto [index, region] = pending.back();
+        pending.pop_back();
+        const auto& module = *m_modules[index];
+        const auto& view = module.file.view();
+        const auto relocations = view.relocations();
+        const auto symbol_count = module.symbol_regions.size();
+        for (auto r = module.region_relocations[region]; r < module.region_relocations[region + 1]; ++r) {
+            for (const auto& item : view.expression(relocations[module.relocations[r]])) {
+                const auto target = static_cast<uint32_t>(item.val);
+                if ((item.kind == object_format::rpn_item::symbol) && (target < symbol_count)) {
+                    mark(index, module.symbol_regions[target]);
+                } else if ((item.kind == object_format::rpn_item::import)
+                           && (target < module.imports.size())) {
+                    const auto& ref = module.imports[target];
+                    mark(ref.module, m_modules[ref.module]->symbol_regions[ref.symbol]);
+                }
+            }
+        }
+    }
+
+    for (const auto& module : m_modules) {
+        for (const auto& region : module->regions) {
+            if (region.live) continue;
+            m_reclaimed += region.size;
+            ++m_reclaimed_regions;
+        }
+    }
+    return success;
+}
+
+void linker::layout() {
+    trace_span span("link.layout");
+    auto address = m_origin;
+    for (auto& module : m_modules) {
+        for (auto& region : module->regions) {
+            if (!region.live) continue;
+            region.address = address;
+            address += region.size;
+        }
+    }
+    m_output.assign(address - m_origin, 0);
+}
+
+bool linker::relocate(const std::vector<size_t>& modules) {
+    m_relocated = modules.size();
+    std::atomic<bool> success = true;
+    parallel_for(modules.size(), [&] (size_t i) {
+        const auto& module = *m_modules[modules[i]];
+        trace_span span("link.relocate", module.path);
+        const auto& view = module.file.view();
+        const auto sections = view.sections();
+        const auto relocations = view.relocations();
+
+        const auto symbol = [&] (uint32_t index, value_t& value) {
+            return symbol_value(module, index, value);
+        };
+        const auto import = [&] (uint32_t index, value_t& value) {
+            if (index >= module.imports.size()) return false;
+            const auto& ref = module.imports[index];
+            return symbol_value(*m_modules[ref.module], ref.symbol, value);
+        };
+        for (size_t r = 0; r < module.regions.size(); ++r) {
+            const auto& region = module.regions[r];
+            if (!region.live) continue;
+            const auto data = view.data(sections[region.section]).subspan(region.offset, region.size);
+            if (!data.empty()) {
+                std::memcpy(m_output.data() + (region.address - m_origin), data.data(), data.size());
+            }
+
+            for (auto k = module.region_relocations[r]; k < module.region_relocations[r + 1]; ++k) {
+                const auto& relocation = relocations[module.relocations[k]];
+                const auto field = static_cast<fixup_t::field_kind>(relocation.field);
+                const size_t width = (field == fixup_t::u16) ? 2 : 1;
+                value_t value;
+                if ((uint64_t(relocation.offset) + width > uint64_t(region.offset) + region.size)
+                    || !evaluate(view.expression(relocation), symbol, import, value)) {
+                    error(module.path + ": invalid relocation at offset "
+                          + std::to_string(relocation.offset));
+                    success = false;
+                    continue;
+                }
+                const auto address = region.address + (relocation.offset - region.offset);
+                if (!write_field(field, value, relocation.bias, address,
+                                 m_output.data() + (address - m_origin))) {
+                    error(module.path + ": value out of range at offset "
+                          + std::to_string(relocation.offset));
+                    success = false;
+                }
+            }
+        }
+    }, m_threads);
+    return success;
+}
+
+bool linker::link(const std::vector<std::string>& paths) {
+    trace_span span("link");
+    m_paths = paths;
+    m_errors.clear();
+    m_exports.clear();
+    m_output.clear();
+    auto success = load(paths) && collect_exports() && resolve_imports();
+    if (success) {
+        partition();
+        success = collect_garbage();
+    }
+    if (success) {
+        layout();
+        std::vector<size_t> modules(m_modules.size());
+        std::iota(modules.begin(), modules.end(), 0);
+        success = relocate(modules);
+    }
+    std::sort(m_errors.begin(), m_errors.end());
+    m_linked = success;
+    return success;
+}
+
+bool linker::relink(const std::vector<size_t>& modules) {
+    // Regions kept by garbage collection may change with any module
+    if (!m_linked || !m_entries.empty()) return link(m_paths);
+
+    trace_span span("relink");
+    auto changed = modules;
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    using export_t = std::tuple<std::string, uint8_t, uint16_t, int32_t>;
+    const auto exports = [] (const object_view& view) {
+        std::vector<export_t> result;
+        for (const auto& symbol : view.symbols()) {
+            if (!symbol.is_exported()) continue;
+            result.emplace_back(view.string(symbol.name), symbol.kind, symbol.section, symbol.value);
+        }
+        return result;
+    };
+    const auto sizes = [] (const object_view& view) {
+        std::vector<uint32_t> result;
+        for (const auto& section : view.sections()) result.push_back(section.size);
+        return result;
+    };
+
+    m_errors.clear();
+    for (const auto index : changed) {
+        if (index >= m_modules.size()) return link(m_paths);
+        auto& module = *m_modules[index];
+        const auto previous_exports = exports(module.file.view());
+        const auto previous_sizes = sizes(module.file.view());
+        // The table refers to names in the mapping about to be replaced
+        for (const auto& symbol : previous_exports) {
+            m_exports.erase(std::get<0>(symbol));
+        }
+        if (!module.file.open(module.path)
+            || (exports(module.file.view()) != previous_exports)
+            || (sizes(module.file.view()) != previous_sizes)) {
+            return link(m_paths);
+        }
+
+        const auto& view = module.file.view();
+        const auto symbols = view.symbols();
+        for (uint32_t s = 0; s < symbols.size(); ++s) {
+            if (!symbols[s].is_exported()) continue;
+            export_ref_t existing;
+            if (!m_exports.insert(view.string(symbols[s].name),
+                                  { static_cast<uint32_t>(index), s }, existing)) {
+                return link(m_paths);
+            }
+        }
+
+        // Same sizes, the regions keep their addresses
+        const auto regions = std::move(module.regions);
+        partition_module(module);
+        for (size_t r = 0; r < regions.size(); ++r) {
+            module.regions[r].address = regions[r].address;
+        }
+    }
+
+    // Symbol indices may have changed, every module resolves again
+    const auto success = resolve_imports() && relocate(changed);
+    std::sort(m_errors.begin(), m_errors.end());
+    m_linked = success;
+    return success;
+}
+
+const std::vector<std::unique_ptr<link_module_t>>& linker::modules() const {
+    return m_modules;
+}
+
+const export_table& linker::exports() const {
+    return m_exports;
+}
+
+const std::vector<uint8_t>& linker::output() const {
+    return m_output;
+}
+
+const std::vector<std::string>& linker::errors() const {
+    return m_errors;
+}
+
+size_t linker::reclaimed() const {
+    return m_reclaimed;
+}
+
+size_t linker::reclaimed_regions() const {
+    return m_reclaimed_regions;
+}
+
+bool linker::linked() const {
+    return m_linked;
+}
+
+size_t linker::relocated() const {
+    return m_relocated;
+}
+
+bool linker::write(const std::string& path) const {
+    trace_span span("write", path);
+    std::ofstream output(path, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(m_output.data()), m_output.size());
+    return static_cast<bool>(output);
+}
+
+}
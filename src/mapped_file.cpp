@@ -0,0 +1,129 @@
+#include <sasm/mapped_file.h>
+
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SASM_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sasm {
+
+mapped_file::mapped_file()
+: m_data(nullptr)
+, m_size(0)
+, m_descriptor(-1)
+, m_open(false)
+{}
+
+mapped_file::~mapped_file() {
+    close();
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+: m_data(std::exchange(other.m_data, nullptr))
+, m_size(std::exchange(other.m_size, 0))
+, m_descriptor(std::exchange(other.m_descriptor, -1))
+, m_open(std::exchange(other.m_open, false))
+, m_fallback(std::move(other.m_fallback))
+{
+    if (!m_fallback.empty()) m_data = m_fallback.data();
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_descriptor = std::exchange(other.m_descriptor, -1);
+        m_open = std::exchange(other.m_open, false);
+        m_fallback = std::move(other.m_fallback);
+        if (!m_fallback.empty()) m_data = m_fallback.data();
+    }
+    return *this;
+}
+
+void mapped_file::close() {
+#ifdef SASM_HAS_MMAP
+    if (m_fallback.empty() && (m_data != nullptr)) {
+        ::munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    if (m_descriptor >= 0) {
+        ::close(m_descriptor);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_descriptor = -1;
+    m_open = false;
+    m_fallback.clear();
+}
+
+bool mapped_file::open(const std::string& path, bool keep_descriptor) {
+    close();
+#ifdef SASM_HAS_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    const auto size = static_cast<size_t>(info.st_size);
+    void* data = (size > 0) ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    if (data != MAP_FAILED) {
+        // A mapping does not need its descriptor, long lived caches would
+        // otherwise hold one per file
+        if (keep_descriptor) {
+            m_descriptor = fd;
+        } else {
+            ::close(fd);
+        }
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = size;
+        m_open = true;
+        return true;
+    }
+    ::close(fd);
+#endif
+    // Not mappable, read it instead
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        close();
+        return false;
+    }
+    m_fallback.assign(std::istreambuf_iterator<char>(input),
+                      std::istreambuf_iterator<char>());
+    m_data = m_fallback.data();
+    m_size = m_fallback.size();
+    m_open = true;
+    return true;
+}
+
+bool mapped_file::is_open() const {
+    return m_open;
+}
+
+const uint8_t* mapped_file::data() const {
+    return m_data;
+}
+
+size_t mapped_file::size() const {
+    return m_size;
+}
+
+std::span<const uint8_t> mapped_file::bytes() const {
+    return { m_data, m_size };
+}
+
+int mapped_file::descriptor() const {
+    return m_descriptor;
+}
+
+}
@@ -0,0 +1,439 @@
+#include <sasm/object.h>
+#include <sasm/trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+namespace sasm {
+
+namespace {
+
+using namespace object_format;
+
+size_t align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+class string_table {
+    std::string m_content;
+    std::unordered_map<std::string, uint32_t> m_offsets;
+
+public:
+    string_ref add(const std::string& text) {
+        auto it = m_offsets.find(text);
+        if (it == m_offsets.end()) {
+            it = m_offsets.emplace(text, static_cast<uint32_t>(m_content.size())).first;
+            m_content += text;
+        }
+        return { it->second, static_cast<uint32_t>(text.size()) };
+    }
+    const std::string& content() const { return m_content; }
+};
+
+std::optional<rpn_item::operation_code> operation_code(const operation_t& op) {
+    using namespace operations;
+    if (op == operations::identity) return rpn_item::identity;
+    if (op == operations::negation) return rpn_item::negation;
+    if (op == operations::addition) return rpn_item::addition;
+    if (op == operations::subtraction) return rpn_item::subtraction;
+    if (op == operations::multiplication) return rpn_item::multiplication;
+    if (op == operations::division) return rpn_item::division;
+    return std::nullopt;
+}
+
+class object_writer {
+    const encoder& m_encoder;
+    string_table m_strings;
+    std::vector<section> m_sections;
+    std::vector<symbol> m_symbols;
+    std::map<std::string, uint32_t> m_symbol_indices;
+    std::map<value_t, uint32_t> m_label_indices;    // unnamed, by address
+    std::vector<import> m_imports;
+    std::map<std::string, uint32_t> m_import_indices;
+    std::vector<relocation> m_relocations;
+    std::vector<rpn_item> m_expressions;
+
+    uint32_t import_index(const std::string& name) {
+        const auto it = m_import_indices.find(name);
+        if (it != m_import_indices.end()) return it->second;
+        const auto index = static_cast<uint32_t>(m_imports.size());
+        m_imports.push_back({ m_strings.add(name) });
+        m_import_indices.emplace(name, index);
+        return index;
+    }
+
+    bool add_expression(const expression_t& expr, int depth) {
+        // Guards against defines referencing each other
+        static constexpr int max_depth = 64;
+        if (depth > max_depth) return false;
+        for (const auto& item : expr.content) {
+            rpn_item rpn {};
+            switch (item.kind) {
+                case expression_item_t::value: {
+                    rpn.kind = rpn_item::value;
+                    rpn.val = item.val;
+                    break;
+                }
+                case expression_item_t::reference: {
+                    const auto symbol = m_symbol_indices.find(item.ref);
+                    if (symbol != m_symbol_indices.end()) {
+                        rpn.kind = rpn_item::symbol;
+                        rpn.val = symbol->second;
+                        break;
+                    }
+                    const auto& symbols = m_encoder.symbols();
+                    const auto define = symbols.find(item.ref);
+                    if (define != symbols.end()) {
+                        // Not representable as a symbol, inline its definition
+                        if (!add_expression(define->second.expr, depth + 1)) return false;
+                        continue;
+                    }
+                    rpn.kind = rpn_item::import;
+                    rpn.val = import_index(item.ref);
+                    break;
+                }
+                case expression_item_t::local_label:
+                case expression_item_t::anonymous_label: {
+                    value_t address;
+                    if (!m_encoder.label_address(item, address)) return false;
+                    rpn.kind = rpn_item::symbol;
+                    rpn.val = m_label_indices.at(address);
+                    break;
+                }
+                case expression_item_t::operation: {
+                    const auto code = operation_code(item.op);
+                    if (!code) return false;
+                    rpn.kind = rpn_item::operation;
+                    rpn.op = *code;
+                    break;
+                }
+                default:
+                    return false;
+            }
+            m_expressions.push_back(rpn);
+        }
+        return true;
+    }
+
+    // Local and anonymous labels referenced by relocations, defines included
+    void add_labels(const expression_t& expr, int depth) {
+        static constexpr int max_depth = 64;
+        if (depth > max_depth) return;
+        const auto origin = static_cast<value_t>(m_encoder.origin());
+        for (const auto& item : expr.content) {
+            value_t address;
+            if (item.is<expression_item_t::reference>()) {
+                const auto it = m_encoder.symbols().find(item.ref);
+                if ((it != m_encoder.symbols().end()) && (it->second.kind == symbol_t::define)) {
+                    add_labels(it->second.expr, depth + 1);
+                }
+            } else if ((item.is<expression_item_t::local_label>() || item.is<expression_item_t::anonymous_label>())
+                       && m_encoder.label_address(item, address)
+                       && m_label_indices.emplace(address, static_cast<uint32_t>(m_symbols.size())).second) {
+                symbol entry {};
+                entry.name = m_strings.add("");
+                entry.kind = symbol::label;
+                entry.section = 0;
+                entry.value = address - origin;
+                m_symbols.push_back(entry);
+            }
+        }
+    }
+
+    // Net count of the labels in an expression, 1 for a label plus a
+    // constant, 0 for a difference of labels. False if labels are not only
+    // added or subtracted, or the expression refers to imports.
+    bool label_terms(const expression_t& expr, int depth, value_t& terms) const {
+        static constexpr int max_depth = 64;
+        if (depth > max_depth) return false;
+        std::vector<value_t> stack;
+        for (const auto& item : expr.content) {
+            switch (item.kind) {
+                case expression_item_t::value:
+                    stack.push_back(0);
+                    break;
+                case expression_item_t::reference: {
+                    const auto it = m_encoder.symbols().find(item.ref);
+                    if (it == m_encoder.symbols().end()) return false;
+                    value_t inner = 1;
+                    if ((it->second.kind == symbol_t::define)
+                        && !label_terms(it->second.expr, depth + 1, inner)) {
+                        return false;
+                    }
+                    stack.push_back(inner);
+                    break;
+                }
+                case expression_item_t::local_label:
+                case expression_item_t::anonymous_label:
+                    stack.push_back(1);
+                    break;
+                case expression_item_t::operation: {
+                    const size_t arity = item.op.is_unary ? 1 : 2;
+                    if (stack.size() < arity) return false;
+                    const auto rhs = stack.back();
+                    const auto lhs = stack[stack.size() - arity];
+                    stack.resize(stack.size() - arity);
+                    const auto code = operation_code(item.op);
+                    if (code == rpn_item::identity) {
+                        stack.push_back(rhs);
+                    } else if (code == rpn_item::negation) {
+                        stack.push_back(-rhs);
+                    } else if (code == rpn_item::addition) {
+                        stack.push_back(lhs + rhs);
+                    } else if (code == rpn_item::subtraction) {
+                        stack.push_back(lhs - rhs);
+                    } else if ((lhs == 0) && (rhs == 0)) {
+                        stack.push_back(0);
+                    } else {
+                        return false;
+                    }
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        if (stack.size() != 1) return false;
+        terms = stack.front();
+        return true;
+    }
+
+    bool add_symbols() {
+        // Unnamed symbols come first, the table is sorted by name
+        for (const auto& fixup : m_encoder.fixups()) {
+            add_labels(fixup.expr, 0);
+        }
+        const auto origin = static_cast<value_t>(m_encoder.origin());
+        const auto& exports = m_encoder.exports();
+        std::vector<std::pair<std::string, symbol>> symbols;
+        for (const auto& [name, definition] : m_encoder.symbols()) {
+            symbol entry {};
+            value_t value;
+            if (definition.kind == symbol_t::label) {
+                entry.kind = symbol::label;
+                entry.section = 0;
+                entry.value = definition.value - origin;
+            } else if (m_encoder.evaluate(definition.expr, value, false)) {
+                entry.kind = symbol::constant;
+                entry.section = absolute_section;
+                entry.value = value;
+            } else if (value_t terms; m_encoder.evaluate(definition.expr, value, true)
+                       && label_terms(definition.expr, 0, terms) && (terms == 0 || terms == 1)) {
+                // A label plus a constant moves with the section, a difference
+                // of labels does not
+                entry.kind = (terms == 1) ? symbol::label : symbol::constant;
+                entry.section = (terms == 1) ? 0 : absolute_section;
+                entry.value = (terms == 1) ? value - origin : value;
+            } else {
+                // Left to the relocations, which inline its definition
+                if (exports.count(name) > 0) return false;
+                continue;
+            }
+            entry.name = m_strings.add(name);
+            entry.flags = (exports.count(name) > 0) ? symbol::exported : 0;
+            if ((definition.kind == symbol_t::label) && !definition.fallen_into) entry.flags |= symbol::entered;
+            symbols.emplace_back(name, entry);
+        }
+        for (const auto& name : exports) {
+            if (m_encoder.symbols().count(name) == 0) return false;
+        }
+
+        // Sorted by name, as std::map is
+        for (const auto& [name, entry] : symbols) {
+            m_symbol_indices.emplace(name, static_cast<uint32_t>(m_symbols.size()));
+            m_symbols.push_back(entry);
+        }
+        return true;
+    }
+
+public:
+    explicit object_writer(const encoder& encoder)
+    : m_encoder(encoder)
+    {}
+
+    bool write(std::vector<uint8_t>& output) {
+        if (!add_symbols()) return false;
+        for (const auto& name : m_encoder.imports()) {
+            import_index(name);
+        }
+        for (const auto& fixup : m_encoder.fixups()) {
+            relocation entry {};
+            entry.section = 0;
+            entry.offset = static_cast<uint32_t>(fixup.address);
+            entry.field = static_cast<uint8_t>(fixup.field);
+            entry.bias = fixup.bias;
+            entry.expression = static_cast<uint32_t>(m_expressions.size());
+            if (!add_expression(fixup.expr, 0)) return false;
+            entry.expression_count = static_cast<uint32_t>(m_expressions.size()) - entry.expression;
+            m_relocations.push_back(entry);
+        }
+        const auto content = m_encoder.flatten();
+        m_sections.push_back({ m_strings.add("code"), 0, static_cast<uint32_t>(content.size()) });
+
+        // Layout
+        header head {};
+        std::memcpy(head.magic, magic, sizeof(magic));
+        head.version = version;
+        size_t offset = sizeof(header);
+        const auto place = [&] (uint32_t& table_offset, uint32_t& table_count,
+                                size_t count, size_t item_size) {
+            offset = align(offset, table_alignment);
+            table_offset = static_cast<uint32_t>(offset);
+            table_count = static_cast<uint32_t>(count);
+            offset += count * item_size;
+        };
+        place(head.section_offset, head.section_count, m_sections.size(), sizeof(section));
+        place(head.symbol_offset, head.symbol_count, m_symbols.size(), sizeof(symbol));
+        place(head.import_offset, head.import_count, m_imports.size(), sizeof(import));
+        place(head.relocation_offset, head.relocation_count, m_relocations.size(), sizeof(relocation));
+        place(head.expression_offset, head.expression_count, m_expressions.size(), sizeof(rpn_item));
+        place(head.string_offset, head.string_size, m_strings.content().size(), 1);
+        for (auto& entry : m_sections) {
+            offset = align(offset, data_alignment);
+            entry.data_offset = static_cast<uint32_t>(offset);
+            offset += entry.size;
+        }
+        head.file_size = static_cast<uint32_t>(offset);
+
+        // Content
+        output.assign(offset, 0);
+        const auto copy = [&] (size_t at, const void* data, size_t size) {
+            if (size > 0) std::memcpy(output.data() + at, data, size);
+        };
+        copy(0, &head, sizeof(head));
+        copy(head.section_offset, m_sections.data(), m_sections.size() * sizeof(section));
+        copy(head.symbol_offset, m_symbols.data(), m_symbols.size() * sizeof(symbol));
+        copy(head.import_offset, m_imports.data(), m_imports.size() * sizeof(import));
+        copy(head.relocation_offset, m_relocations.data(), m_relocations.size() * sizeof(relocation));
+        copy(head.expression_offset, m_expressions.data(), m_expressions.size() * sizeof(rpn_item));
+        copy(head.string_offset, m_strings.content().data(), m_strings.content().size());
+        copy(m_sections.front().data_offset, content.data(), content.size());
+        return true;
+    }
+};
+
+}
+
+bool write_object(const encoder& encoder, std::vector<uint8_t>& output) {
+    object_writer writer(encoder);
+    return writer.write(output);
+}
+
+bool write_object(const encoder& encoder, const std::string& path) {
+    trace_span span("write", path);
+    std::vector<uint8_t> content;
+    if (!write_object(encoder, content)) return false;
+    // Replaced rather than rewritten, a linker may still have the old one mapped
+    const auto temporary = path + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary);
+        output.write(reinterpret_cast<const char*>(content.data()), content.size());
+        if (!output) return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool object_view::open(std::span<const uint8_t> data) {
+    using namespace object_format;
+    m_data = {};
+    if (data.size() < sizeof(object_format::header)) return false;
+    if (reinterpret_cast<uintptr_t>(data.data()) % table_alignment != 0) return false;
+
+    const auto& head = *reinterpret_cast<const object_format::header*>(data.data());
+    if (std::memcmp(head.magic, magic, sizeof(magic)) != 0) return false;
+    if (head.version != version) return false;
+    if (head.file_size > data.size()) return false;
+
+    const auto fits = [&] (uint32_t offset, uint64_t count, size_t item_size) {
+        return (offset % table_alignment == 0)
+            && (offset + count * item_size <= head.file_size);
+    };
+    if (!fits(head.section_offset, head.section_count, sizeof(object_format::section))
+        || !fits(head.symbol_offset, head.symbol_count, sizeof(object_format::symbol))
+        || !fits(head.import_offset, head.import_count, sizeof(object_format::import))
+        || !fits(head.relocation_offset, head.relocation_count, sizeof(object_format::relocation))
+        || !fits(head.expression_offset, head.expression_count, sizeof(object_format::rpn_item))
+        || !fits(head.string_offset, head.string_size, 1)) {
+        return false;
+    }
+    m_data = data.first(head.file_size);
+
+    for (const auto& entry : sections()) {
+        if (uint64_t(entry.data_offset) + entry.size > head.file_size) return invalid();
+    }
+    for (const auto& entry : relocations()) {
+        if (entry.section >= head.section_count) return invalid();
+        if (uint64_t(entry.expression) + entry.expression_count > head.expression_count) {
+            return invalid();
+        }
+    }
+    return true;
+}
+
+bool object_view::invalid() {
+    m_data = {};
+    return false;
+}
+
+const object_format::header& object_view::header() const {
+    return *reinterpret_cast<const object_format::header*>(m_data.data());
+}
+
+std::span<const object_format::section> object_view::sections() const {
+    return table<object_format::section>(header().section_offset, header().section_count);
+}
+
+std::span<const object_format::symbol> object_view::symbols() const {
+    return table<object_format::symbol>(header().symbol_offset, header().symbol_count);
+}
+
+std::span<const object_format::import> object_view::imports() const {
+    return table<object_format::import>(header().import_offset, header().import_count);
+}
+
+std::span<const object_format::relocation> object_view::relocations() const {
+    return table<object_format::relocation>(header().relocation_offset, header().relocation_count);
+}
+
+std::span<const uint8_t> object_view::data(const object_format::section& section) const {
+    return m_data.subspan(section.data_offset, section.size);
+}
+
+std::span<const object_format::rpn_item> object_view::expression(
+    const object_format::relocation& relocation) const {
+    return table<object_format::rpn_item>(
+        header().expression_offset, header().expression_count)
+        .subspan(relocation.expression, relocation.expression_count);
+}
+
+std::string_view object_view::string(const object_format::string_ref& ref) const {
+    if (uint64_t(ref.offset) + ref.length > header().string_size) return {};
+    return { reinterpret_cast<const char*>(m_data.data()) + header().string_offset + ref.offset,
+             ref.length };
+}
+
+const object_format::symbol* object_view::find_symbol(std::string_view name) const {
+    const auto table = symbols();
+    const auto it = std::lower_bound(table.begin(), table.end(), name,
+        [this] (const object_format::symbol& entry, std::string_view name) {
+            return string(entry.name) < name;
+        });
+    if ((it == table.end()) || (string(it->name) != name)) return nullptr;
+    return &*it;
+}
+
+bool object_file::open(const std::string& path) {
+    if (!m_file.open(path)) return false;
+    return m_view.open(m_file.bytes());
+}
+
+const object_view& object_file::view() const {
+    return m_view;
+}
+
+}
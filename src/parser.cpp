@@ -4,6 +4,7 @@ namespace sasm {
 
 lighweight_parser::lighweight_parser(parser& p)
 : m_parser(p)
+, m_base(p)
 {}
 
 void lighweight_parser::reset() {
@@ -18,4 +19,14 @@ bool lighweight_parser::try_get_operand(operand_t& operand, dtype::etype type) {
     return m_parser.try_parse_operand(operand, type);
 }
 
+generator<parser_token> parser::statements(std::pmr::memory_resource*) {
+    while (true) {
+        while (m_head < m_tokens.size()) {
+            const auto head = m_head++;
+            co_yield m_tokens[head];
+        }
+        if (!next_line()) co_return;
+    }
+}
+
 }
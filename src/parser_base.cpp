@@ -1,27 +1,132 @@
 #include <sasm/parser_base.h>
+#include <sasm/allocation.h>
 #include <sasm/assert.h>
+#include <sasm/stats.h>
+
+#include <algorithm>
 
 namespace sasm {
 
+// Tokens of source files are checked against the line length limit, those
+// of macros and repeats were as the lines defining them were read. The rest
+// of a line too long is skipped, an unknown token standing for it.
 auto parser_base_t::get_token() {
+    using enum lexer_token::token_type;
+    if (m_line_end) {
+        auto end = std::move(*m_line_end);
+        m_line_end.reset();
+        return end;
+    }
+    while (!m_replays.empty()) {
+        auto& replay = m_replays.back();
+        if (replay.next < replay.tokens->size()) {
+            const auto& tokens = *replay.tokens;
+            auto token = tokens[replay.next++];
+            if ((replay.source == diagnostics_sink::no_source) || !exceeds_line(replay.line, token)) return token;
+            report_limit(token, diagnostic_code::line_too_long, m_limits.max_line_length);
+            auto end = token;
+            while (!end.is<end_of_line>() && (replay.next < tokens.size())) end = tokens[replay.next++];
+            replay.line.started = false;
+            m_line_end = std::move(end);
+            return lexer_token{ unknown, "", token.offset, 0, false, false, false, token.source };
+        }
+        finish_replay();
+    }
     auto token = m_lexer->get();
     while (token.is_trivia) token = m_lexer->get();
-    return token;
+    if (!exceeds_line(m_lexer_line, token)) return token;
+    report_limit(token, diagnostic_code::line_too_long, m_limits.max_line_length);
+    auto end = token;
+    while (!end.is<end_of_line>() && !end.eof()) end = m_lexer->get();
+    m_lexer_line.started = false;
+    m_line_end = std::move(end);
+    return lexer_token{ unknown, "", token.offset, 0, false, false, false, token.source };
+}
+
+bool parser_base_t::exceeds_line(line_t& line, const lexer_token& token) const {
+    if (m_limits.max_line_length == 0) return false;
+    if (!line.started) {
+        line.start = token.offset;
+        line.started = true;
+    }
+    const auto end = token.offset + token.width;
+    if (token.is<lexer_token::end_of_line>() || token.eof()) line.started = false;
+    return (end > line.start) && (end - line.start > m_limits.max_line_length);
 }
 
-parser_base_t::parser_base_t(lexer* lexer)
+void parser_base_t::finish_replay() {
+    auto& replay = m_replays.back();
+    if ((++replay.iteration < replay.count) && !replay.tokens->empty()) {
+        replay.next = 0;
+        replay.input = ++m_inputs;
+        if (replay.expansion != 0) replay.expansion = ++m_expansions;
+        return;
+    }
+    if (!replay.variable.empty()) --m_repeats;
+    m_replays.pop_back();
+}
+
+parser_base_t::parser_base_t(lexer* lexer, const parse_limits_t& limits)
 : m_lexer(lexer)
+, m_limits(limits)
 , m_current(0)
+, m_repeats(0)
 {}
 
+const parse_limits_t& parser_base_t::limits() const {
+    return m_limits;
+}
+
+diagnostics_sink& parser_base_t::diagnostics() {
+    return m_diagnostics;
+}
+
+const diagnostics_sink& parser_base_t::diagnostics() const {
+    return m_diagnostics;
+}
+
+uint32_t parser_base_t::diagnostic_source() const {
+    for (auto it = m_replays.rbegin(); it != m_replays.rend(); ++it) {
+        if (it->source != diagnostics_sink::no_source) return it->source;
+    }
+    return diagnostics_sink::no_source;
+}
+
+void parser_base_t::report_limit(const lexer_token& token, diagnostic_code code, size_t limit) {
+    const auto source = diagnostic_source();
+    // Rules trying the line again reach the same token
+    const auto& entries = m_diagnostics.entries();
+    if (!entries.empty() && (entries.back().code == code)
+        && (entries.back().source == source) && (entries.back().offset == token.offset)) {
+        return;
+    }
+    m_diagnostics.report(code, source, token.offset, token.width, limit);
+}
+
 lexer_token parser_base_t::stage_token() {
+    allocation_scope scope(allocation_stage::parser_base);
     assert(m_current <= m_buffer.size());
+#ifdef SASM_PROFILE
+    ++m_staged;
+#endif
     if (m_current == m_buffer.size()) {
         m_buffer.push_back(get_token());
+    } else {
+        SASM_STAT(restaged);
+#ifdef SASM_PROFILE
+        thread_profile().restaged(current_source(), m_buffer.front().offset);
+#endif
     }
     return m_buffer[m_current++];
 }
 
+const lexer_token& parser_base_t::peek_token() {
+    allocation_scope scope(allocation_stage::parser_base);
+    assert(m_current <= m_buffer.size());
+    if (m_current == m_buffer.size()) m_buffer.push_back(get_token());
+    return m_buffer[m_current];
+}
+
 void parser_base_t::unstage_token() {
     if (m_scopes.empty()) {
         assert(m_current > 0);
@@ -32,17 +137,21 @@ void parser_base_t::unstage_token() {
 }
 
 void parser_base_t::push_scope() {
+    allocation_scope scope(allocation_stage::parser_base);
+    SASM_STAT(scope_pushes);
     m_scopes.push_back(m_current);
 }
 
 void parser_base_t::accept_scope() {
     assert(!m_scopes.empty());
+    SASM_STAT(scope_accepts);
     m_scopes.pop_back();
     if (m_scopes.empty()) accept();
 }
 
 void parser_base_t::cancel_scope() {
     assert(!m_scopes.empty());
+    SASM_STAT(scope_cancels);
     m_current = m_scopes.back();
     m_scopes.pop_back();
 }
@@ -61,7 +170,126 @@ void parser_base_t::accept() {
 
 void parser_base_t::reset() {
     assert(!m_scopes.empty());
+    SASM_STAT(resets);
     m_current = m_scopes.back();
 }
 
+std::vector<size_t> find_directive_lines(const token_array_t& tokens) {
+    std::vector<size_t> lines;
+    bool line_start = true;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (line_start && tokens[i].is<lexer_token::symbol>(".")) lines.push_back(i);
+        line_start = tokens[i].is<lexer_token::end_of_line>();
+    }
+    return lines;
+}
+
+void parser_base_t::replay(std::shared_ptr<const token_array_t> tokens, const std::string& source,
+                           std::shared_ptr<const line_index> lines,
+                           std::shared_ptr<const std::vector<size_t>> directives) {
+#ifdef SASM_PROFILE
+    if (!source.empty()) thread_profile().name_source(tokens.get(), source);
+#endif
+    repeat(std::move(tokens), 1, "");
+    if (!source.empty() && !m_replays.empty()) {
+        m_replays.back().source = m_diagnostics.source(source, std::move(lines));
+        m_replays.back().expansion = 0;
+        m_replays.back().directives = std::move(directives);
+    }
+}
+
+void parser_base_t::repeat(std::shared_ptr<const token_array_t> tokens, size_t count,
+                           const std::string& variable) {
+    assert(m_scopes.empty());
+    if (count == 0) return;
+    allocation_scope scope(allocation_stage::parser_base);
+    if ((m_current < m_buffer.size()) || m_line_end) {
+        auto pending = std::make_shared<token_array_t>(
+            m_buffer.begin() + m_current, m_buffer.end());
+        if (m_line_end) {
+            pending->push_back(std::move(*m_line_end));
+            m_line_end.reset();
+        }
+        m_buffer.resize(m_current);
+        m_replays.push_back({ std::move(pending), 0, 1, 0, "", diagnostics_sink::no_source, {}, 0, nullptr, ++m_inputs });
+    }
+    m_replays.push_back({ std::move(tokens), 0, count, 0, variable, diagnostics_sink::no_source, {}, ++m_expansions,
+                          nullptr, ++m_inputs });
+    if (!variable.empty()) ++m_repeats;
+}
+
+size_t parser_base_t::replay_depth() const {
+    return m_replays.size();
+}
+
+uint64_t parser_base_t::current_expansion() const {
+    for (auto it = m_replays.rbegin(); it != m_replays.rend(); ++it) {
+        if (it->source != diagnostics_sink::no_source) return 0;
+        if (it->expansion != 0) return it->expansion;
+    }
+    return 0;
+}
+
+bool parser_base_t::expansion_active(uint64_t expansion) const {
+    if (expansion == 0) return true;
+    return std::any_of(m_replays.begin(), m_replays.end(),
+        [&] (const replay_t& replay) { return replay.expansion == expansion; });
+}
+
+uint64_t parser_base_t::current_input() const {
+    return m_replays.empty() ? 0 : m_replays.back().input;
+}
+
+bool parser_base_t::input_active(uint64_t input) const {
+    if (input == 0) return true;
+    return std::any_of(m_replays.begin(), m_replays.end(),
+        [&] (const replay_t& replay) { return replay.input == input; });
+}
+
+bool parser_base_t::input_ended() const {
+    if ((m_current < m_buffer.size()) || m_line_end || m_replays.empty()) return false;
+    return m_replays.back().next == m_replays.back().tokens->size();
+}
+
+void parser_base_t::skip_to_directive_line() {
+    if (!m_scopes.empty() || !m_buffer.empty() || m_line_end) return;
+    if (m_replays.empty()) {
+        m_lexer->skip_to_directive_line();
+        return;
+    }
+    auto& replay = m_replays.back();
+    const auto& tokens = *replay.tokens;
+    if (replay.directives) {
+        const auto& lines = *replay.directives;
+        const auto line = std::lower_bound(lines.begin(), lines.end(), replay.next);
+        replay.next = (line != lines.end()) ? *line : tokens.size();
+    }
+    while ((replay.next < tokens.size()) && !tokens[replay.next].is<lexer_token::symbol>(".")) {
+        while ((replay.next < tokens.size()) && !tokens[replay.next++].is<lexer_token::end_of_line>()) {}
+    }
+}
+
+bool parser_base_t::bound_value(const std::string& variable, size_t& value) const {
+    for (auto it = m_replays.rbegin(); it != m_replays.rend(); ++it) {
+        if (it->variable == variable) {
+            value = it->iteration;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parser_base_t::has_bound_variables() const {
+    return m_repeats > 0;
+}
+
+#ifdef SASM_PROFILE
+const void* parser_base_t::current_source() const {
+    for (auto it = m_replays.rbegin(); it != m_replays.rend(); ++it) {
+        if (it->source != diagnostics_sink::no_source) return it->tokens.get();
+    }
+    return nullptr;
+}
+#endif
+
 }
@@ -0,0 +1,125 @@
+#include <sasm/profile.h>
+#include <sasm/allocation.h>
+#include <sasm/line_index.h>
+#include <sasm/mapped_file.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+
+namespace sasm {
+
+const char* rule_name(parse_rule rule) {
+    static const std::array<const char*, parse_rule_count> names {
+        "define", "align", "data", "incbin", "import", "export", "label", "instruction",
+        "instruction.relative", "instruction.indirect_y", "instruction.indirect_x",
+        "instruction.indirect", "instruction.direct_indexed", "instruction.direct",
+        "instruction.immediate", "instruction.implied",
+    };
+    return names[static_cast<size_t>(rule)];
+}
+
+void parse_profile::record(parse_rule rule, bool success, uint64_t staged, uint64_t nanoseconds) {
+    auto& profile = m_rules[static_cast<size_t>(rule)];
+    ++profile.attempts;
+    if (success) {
+        ++profile.successes;
+    } else {
+        profile.wasted_tokens += staged;
+    }
+    profile.nanoseconds += nanoseconds;
+}
+
+// The profile is not part of the stage it measures
+void parse_profile::restaged(const void* tokens, size_t offset) {
+    allocation_scope scope(allocation_stage::other);
+    ++m_restaged[{ tokens, offset }];
+}
+
+void parse_profile::name_source(const void* tokens, const std::string& path) {
+    allocation_scope scope(allocation_stage::other);
+    m_sources[tokens] = path;
+}
+
+void parse_profile::clear() {
+    m_rules = {};
+    m_restaged.clear();
+    m_sources.clear();
+}
+
+const rule_profile_t& parse_profile::rule(parse_rule rule) const {
+    return m_rules[static_cast<size_t>(rule)];
+}
+
+std::vector<std::string> parse_profile::report(size_t locations) const {
+    std::vector<std::string> lines;
+    char line[256];
+
+    std::vector<size_t> rules(parse_rule_count);
+    std::iota(rules.begin(), rules.end(), 0);
+    std::stable_sort(rules.begin(), rules.end(), [&] (size_t a, size_t b) {
+        return m_rules[a].nanoseconds > m_rules[b].nanoseconds;
+    });
+    lines.push_back("rule                        attempts  successes     wasted        time");
+    for (const auto index : rules) {
+        const auto& profile = m_rules[index];
+        if (profile.attempts == 0) continue;
+        std::snprintf(line, sizeof(line), "%-26s %9llu  %9llu  %9llu  %8.3f ms",
+            rule_name(static_cast<parse_rule>(index)),
+            static_cast<unsigned long long>(profile.attempts),
+            static_cast<unsigned long long>(profile.successes),
+            static_cast<unsigned long long>(profile.wasted_tokens),
+            profile.nanoseconds / 1e6);
+        lines.push_back(line);
+    }
+
+    if (m_restaged.empty()) return lines;
+
+    // Offsets become line numbers where the source can be read again, the
+    // statements of a line are summed
+    struct indexed_file_t {
+        std::shared_ptr<mapped_file> file;
+        std::unique_ptr<line_index> index;
+    };
+    std::map<const void*, indexed_file_t> files;
+    std::map<std::string, uint64_t> places;
+    for (const auto& [location, count] : m_restaged) {
+        const auto [tokens, offset] = location;
+        const auto source = m_sources.find(tokens);
+        if (source == m_sources.end()) {
+            places["<input>:+" + std::to_string(offset)] += count;
+            continue;
+        }
+        const auto [it, inserted] = files.try_emplace(tokens);
+        auto& indexed = it->second;
+        if (inserted) {
+            indexed.file = std::make_shared<mapped_file>();
+            if (indexed.file->open(source->second)) indexed.index = std::make_unique<line_index>(indexed.file);
+        }
+        if (indexed.index && (offset <= indexed.file->size())) {
+            places[source->second + ":" + std::to_string(indexed.index->locate(offset).line)] += count;
+        } else {
+            places[source->second + ":+" + std::to_string(offset)] += count;
+        }
+    }
+    std::vector<std::pair<std::string, uint64_t>> restaged(places.begin(), places.end());
+    std::stable_sort(restaged.begin(), restaged.end(), [] (const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+    if (restaged.size() > locations) restaged.resize(locations);
+    lines.push_back("most restaged lines");
+    for (const auto& [place, count] : restaged) {
+        std::snprintf(line, sizeof(line), "%9llu  %s",
+            static_cast<unsigned long long>(count), place.c_str());
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+parse_profile& thread_profile() {
+    thread_local parse_profile profile;
+    return profile;
+}
+
+}
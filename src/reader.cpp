@@ -1,10 +1,13 @@
 #include <sasm/reader.h>
+#include <sasm/allocation.h>
 
+#include <algorithm>
+#include <cstring>
 #include <tuple>
 
 namespace sasm {
 
-static const character end_of_file{-1, -1, -1};
+static const character end_of_file{size_t(-1), size_t(-1), -1};
 
 auto ctuple(const character& c) {
     return std::tie(c.offset, c.width, c.value);
@@ -14,19 +17,47 @@ bool character::eof() const {
     return ctuple(*this) == ctuple(end_of_file);
 }
 
+static std::string stored(const std::string& content) {
+    allocation_scope scope(allocation_stage::reader);
+    return content;
+}
+
 reader::reader(const std::string& content)
-: m_input(content)
+: m_storage(stored(content))
+, m_input(m_storage)
+, m_offset(0)
+{}
+
+reader::reader(const char* data, size_t size)
+: m_input(data, size)
 , m_offset(0)
 {}
 
 character reader::get() {
-    char c;
-    if (m_input.get(c)) {
-        character result{m_offset, 1, c};
+    if (m_offset < m_input.size()) {
+        character result{m_offset, 1, m_input[m_offset]};
         ++m_offset;
         return result;
     }
     return end_of_file;
 }
 
+size_t reader::find_directive_line(size_t offset) const {
+    const auto* data = m_input.data();
+    const auto size = m_input.size();
+    while (offset < size) {
+        auto i = offset;
+        while ((i < size) && ((data[i] == ' ') || (data[i] == '\t'))) ++i;
+        if ((i < size) && (data[i] == '.')) return offset;
+        const auto* end_of_line = static_cast<const char*>(std::memchr(data + i, '\n', size - i));
+        if (!end_of_line) return size;
+        offset = end_of_line - data + 1;
+    }
+    return size;
+}
+
+void reader::seek(size_t offset) {
+    m_offset = std::min(offset, m_input.size());
+}
+
 }
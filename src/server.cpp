@@ -0,0 +1,347 @@
+#include <sasm/server.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SASM_HAS_SOCKETS 1
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace sasm {
+
+namespace fs = std::filesystem;
+
+#ifdef SASM_HAS_SOCKETS
+
+// Messages are lists of strings, each one sent as its length then its bytes
+namespace {
+
+constexpr uint32_t max_strings = 4096;
+constexpr uint32_t max_string_size = 1 << 20;
+
+bool send_all(int fd, const void* data, size_t size) {
+    const auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+#ifdef MSG_NOSIGNAL
+        const auto sent = ::send(fd, p, size, MSG_NOSIGNAL);
+#else
+        const auto sent = ::send(fd, p, size, 0);
+#endif
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        p += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+using deadline_t = std::chrono::steady_clock::time_point;
+
+// Fails once the deadline passed without the data
+bool receive_all(int fd, void* data, size_t size, deadline_t deadline) {
+    auto* p = static_cast<char*>(data);
+    while (size > 0) {
+        if (deadline != deadline_t::max()) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            pollfd item { fd, POLLIN, 0 };
+            const auto ready = (left > 0) ? ::poll(&item, 1, static_cast<int>(left)) : 0;
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return false;
+        }
+        const auto received = ::recv(fd, p, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        p += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool send_strings(int fd, const std::vector<std::string>& strings) {
+    std::string buffer;
+    const auto append = [&] (uint32_t value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(static_cast<uint32_t>(strings.size()));
+    for (const auto& text : strings) {
+        append(static_cast<uint32_t>(text.size()));
+        buffer += text;
+    }
+    return send_all(fd, buffer.data(), buffer.size());
+}
+
+bool receive_strings(int fd, std::vector<std::string>& strings,
+                     deadline_t deadline = deadline_t::max()) {
+    uint32_t count;
+    if (!receive_all(fd, &count, sizeof(count), deadline) || (count > max_strings)) return false;
+    strings.resize(count);
+    for (auto& text : strings) {
+        uint32_t size;
+        if (!receive_all(fd, &size, sizeof(size), deadline) || (size > max_string_size)) return false;
+        text.resize(size);
+        if (!receive_all(fd, text.data(), size, deadline)) return false;
+    }
+    return true;
+}
+
+bool make_address(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool exchange(const std::string& socket_path,
+              const std::vector<std::string>& request,
+              std::vector<std::string>& response) {
+    sockaddr_un address;
+    if (!make_address(socket_path, address)) return false;
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    const auto success =
+        (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+        && send_strings(fd, request)
+        && receive_strings(fd, response)
+        && !response.empty();
+    ::close(fd);
+    return success;
+}
+
+}
+
+#endif
+
+assembler_server::assembler_server(uint64_t max_size, int timeout)
+: m_max_size(max_size)
+, m_timeout(timeout)
+, m_uses(0)
+, m_hits(0)
+{}
+
+source_manager& assembler_server::sources(const std::string& directory,
+                                          const std::vector<std::string>& include_paths) {
+    auto key = include_paths;
+    key.insert(key.begin(), directory);
+    auto& sources = m_sources[key];
+    sources.used = ++m_uses;
+    if (!sources.manager) {
+        sources.manager = std::make_unique<source_manager>();
+        // Included files are found from the client directory, as by the driver
+        // run there, rather than from that of the server
+        sources.manager->set_directory(directory);
+        for (const auto& path : include_paths) {
+            sources.manager->add_include_path(path);
+        }
+    }
+    return *sources.manager;
+}
+
+void assembler_server::evict() {
+    auto total = size();
+    if (total <= m_max_size) return;
+    // Modules and source managers by last use, the oldest first. The map
+    // iterators stay valid as the others are erased.
+    struct entry_t {
+        uint64_t used;
+        decltype(m_modules)::iterator module;
+        decltype(m_sources)::iterator sources;
+    };
+    std::vector<entry_t> entries;
+    for (auto it = m_modules.begin(); it != m_modules.end(); ++it) {
+        entries.push_back({ it->second.used, it, m_sources.end() });
+    }
+    for (auto it = m_sources.begin(); it != m_sources.end(); ++it) {
+        entries.push_back({ it->second.used, m_modules.end(), it });
+    }
+    std::sort(entries.begin(), entries.end(), [] (const entry_t& a, const entry_t& b) {
+        return a.used < b.used;
+    });
+    for (const auto& entry : entries) {
+        if (total <= m_max_size) break;
+        if (entry.module != m_modules.end()) {
+            total -= entry.module->second.output.size();
+            m_modules.erase(entry.module);
+        } else {
+            total -= entry.sources->second.manager->size();
+            m_sources.erase(entry.sources);
+        }
+    }
+}
+
+bool assembler_server::file_state(const std::string& path, file_state_t& state) {
+    std::error_code error;
+    state.path = path;
+    state.size = fs::file_size(path, error);
+    if (error) return false;
+    const auto time = fs::last_write_time(path, error);
+    if (error) return false;
+    state.modification_time = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+bool assembler_server::handle(const std::vector<std::string>& arguments,
+                              const std::string& directory,
+                              std::vector<std::string>& messages) {
+    messages.clear();
+    driver_options_t options;
+    if (!parse_arguments(arguments, options) || !options.server_socket.empty() || options.watch
+        || options.stats || options.profile || options.allocations || !options.trace_path.empty()) {
+        messages.push_back(usage_text());
+        return false;
+    }
+    make_absolute(options, directory);
+
+    // Unchanged inputs, the kept output is written unless already there. A
+    // debug map needs the sources parsed, as with the build cache.
+    const auto key = options.source + '\n' + directory + '\n' + output_settings(options);
+    auto it = options.debug_map_path.empty() ? m_modules.find(key) : m_modules.end();
+    if (it != m_modules.end()) {
+        auto& module = it->second;
+        const auto unchanged = std::all_of(module.inputs.begin(), module.inputs.end(),
+            [] (const file_state_t& input) {
+                file_state_t current;
+                return file_state(input.path, current) && (current == input);
+            });
+        if (unchanged) {
+            ++m_hits;
+            module.used = ++m_uses;
+            file_state_t current;
+            if (file_state(options.output, current) && (current == module.written)) return true;
+            std::ofstream output(options.output, std::ios::binary);
+            output.write(reinterpret_cast<const char*>(module.output.data()), module.output.size());
+            output.close();
+            if (!output) {
+                messages.push_back("cannot write " + options.output);
+                return false;
+            }
+            file_state(options.output, module.written);
+            return true;
+        }
+        m_modules.erase(it);
+    }
+
+    driver_result_t result;
+    const auto success = run_driver(options, sources(directory, options.include_paths), result);
+    messages = std::move(result.messages);
+    if (!success || result.cached) {
+        evict();
+        return success;
+    }
+
+    module_t module;
+    auto inputs = std::move(result.dependencies);
+    inputs.push_back(options.source);
+    bool known = file_state(options.output, module.written);
+    for (const auto& path : inputs) {
+        module.inputs.emplace_back();
+        known = known && file_state(path, module.inputs.back());
+    }
+    if (known) {
+        module.output = std::move(result.output);
+        module.used = ++m_uses;
+        m_modules[key] = std::move(module);
+    }
+    evict();
+    return true;
+}
+
+size_t assembler_server::hits() const {
+    return m_hits;
+}
+
+uint64_t assembler_server::size() const {
+    uint64_t size = 0;
+    for (const auto& [key, module] : m_modules) size += module.output.size();
+    for (const auto& [key, sources] : m_sources) size += sources.manager->size();
+    return size;
+}
+
+bool assembler_server::serve(const std::string& socket_path) {
+#ifdef SASM_HAS_SOCKETS
+    sockaddr_un address;
+    if (!make_address(socket_path, address)) return false;
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    ::unlink(socket_path.c_str());
+    if ((::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        || (::listen(fd, 64) != 0)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Requests are handled one at a time, in the order they arrive
+    bool running = true;
+    while (running) {
+        const int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // A stalled client is dropped, as is one which does not read the answer
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout);
+        timeval send_timeout { m_timeout / 1000, (m_timeout % 1000) * 1000 };
+        ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+        std::vector<std::string> request;
+        if (receive_strings(client, request, deadline) && (request.size() >= 2)) {
+            std::vector<std::string> response;
+            if (request[0] == "stop") {
+                running = false;
+                response.push_back("ok");
+            } else if (request[0] == "assemble") {
+                std::vector<std::string> messages;
+                const std::vector<std::string> arguments(request.begin() + 2, request.end());
+                const auto success = handle(arguments, request[1], messages);
+                response.push_back(success ? "ok" : "error");
+                response.insert(response.end(), messages.begin(), messages.end());
+            }
+            if (!response.empty()) send_strings(client, response);
+        }
+        ::close(client);
+    }
+    ::close(fd);
+    ::unlink(socket_path.c_str());
+    return !running;
+#else
+    return false;
+#endif
+}
+
+bool send_request(const std::string& socket_path,
+                  const std::vector<std::string>& arguments,
+                  const std::string& directory,
+                  bool& success,
+                  std::vector<std::string>& messages) {
+#ifdef SASM_HAS_SOCKETS
+    std::vector<std::string> request = { "assemble", directory };
+    request.insert(request.end(), arguments.begin(), arguments.end());
+    std::vector<std::string> response;
+    if (!exchange(socket_path, request, response)) return false;
+    success = (response[0] == "ok");
+    messages.assign(response.begin() + 1, response.end());
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool stop_server(const std::string& socket_path) {
+#ifdef SASM_HAS_SOCKETS
+    std::vector<std::string> response;
+    return exchange(socket_path, { "stop", "" }, response);
+#else
+    return false;
+#endif
+}
+
+}
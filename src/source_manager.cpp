@@ -0,0 +1,166 @@
+#include <sasm/source_manager.h>
+#include <sasm/trace.h>
+
+#include <filesystem>
+
+namespace sasm {
+
+namespace fs = std::filesystem;
+
+static std::shared_ptr<const token_array_t> lex(const mapped_file& file, const std::string& path, uint32_t id) {
+    trace_span span("lex", path);
+    auto tokens = std::make_shared<token_array_t>();
+    reader reader(reinterpret_cast<const char*>(file.data()), file.size());
+    lexer lexer(&reader);
+    for (auto token = lexer.get(); !token.eof(); token = lexer.get()) {
+        if (token.is_trivia) continue;
+        token.source = id;
+        tokens->push_back(std::move(token));
+    }
+    if (!tokens->empty() && !tokens->back().is<lexer_token::end_of_line>()) {
+        const lexer_token end_of_line{ lexer_token::end_of_line, "", file.size(), 0, false, false, false, id };
+        tokens->push_back(end_of_line);
+    }
+    return tokens;
+}
+
+source_manager::source_manager()
+: m_lex_count(0)
+{}
+
+void source_manager::add_include_path(const std::string& directory) {
+    std::lock_guard lock(m_mutex);
+    m_include_paths.push_back(directory);
+}
+
+void source_manager::set_directory(const std::string& directory) {
+    std::lock_guard lock(m_mutex);
+    m_directory = directory;
+}
+
+std::string source_manager::directory() const {
+    std::lock_guard lock(m_mutex);
+    std::error_code error;
+    return fs::absolute(m_directory.empty() ? fs::path(".") : fs::path(m_directory), error)
+        .lexically_normal().string();
+}
+
+std::string source_manager::resolve(const std::string& path) const {
+    std::lock_guard lock(m_mutex);
+    return resolve_path(path);
+}
+
+std::vector<std::string> source_manager::candidates(const std::string& path) const {
+    std::lock_guard lock(m_mutex);
+    std::error_code error;
+    const auto given = fs::path(m_directory) / path;
+    std::vector<std::string> result{ fs::absolute(given, error).lexically_normal().string() };
+    if (given.is_absolute()) return result;
+    for (const auto& directory : m_include_paths) {
+        result.push_back(fs::absolute(fs::path(directory) / path, error).lexically_normal().string());
+    }
+    return result;
+}
+
+std::string source_manager::resolve_path(const std::string& path) const {
+    std::error_code error;
+    const auto given = fs::path(m_directory) / path;
+    if (fs::is_regular_file(given, error) || given.is_absolute()) {
+        return fs::absolute(given, error).lexically_normal().string();
+    }
+    for (const auto& directory : m_include_paths) {
+        const auto candidate = fs::path(directory) / path;
+        if (fs::is_regular_file(candidate, error)) {
+            return fs::absolute(candidate, error).lexically_normal().string();
+        }
+    }
+    return path;
+}
+
+std::shared_ptr<const source_t> source_manager::get(const std::string& path) {
+    std::unique_lock lock(m_mutex);
+    const auto resolved = resolve_path(path);
+    lock.unlock();
+
+    std::error_code error;
+    const auto size = fs::file_size(resolved, error);
+    if (error) return nullptr;
+    const auto time = fs::last_write_time(resolved, error);
+    if (error) return nullptr;
+    const auto modification_time = static_cast<int64_t>(
+        time.time_since_epoch().count());
+
+    lock.lock();
+    auto& entry = m_sources[resolved];
+    if (entry && (entry->modification_time == modification_time) && (entry->size == size)) {
+        const auto current = entry;
+        lock.unlock();
+        return current->source.get();
+    }
+    // A path keeps its id when read again
+    auto& id = m_ids[resolved];
+    if (id == 0) {
+        m_paths.push_back(resolved);
+        id = static_cast<uint32_t>(m_paths.size());
+    }
+    const auto loading = std::make_shared<entry_t>();
+    loading->modification_time = modification_time;
+    loading->size = size;
+    std::promise<std::shared_ptr<const source_t>> promise;
+    loading->source = promise.get_future().share();
+    entry = loading;
+    const auto source_id = id;
+    lock.unlock();
+
+    auto file = std::make_shared<mapped_file>();
+    bool opened;
+    {
+        trace_span span("read", resolved);
+        opened = file->open(resolved);
+    }
+    if (!opened) {
+        promise.set_value(nullptr);
+        lock.lock();
+        const auto it = m_sources.find(resolved);
+        if ((it != m_sources.end()) && (it->second == loading)) m_sources.erase(it);
+        return nullptr;
+    }
+    auto loaded = std::make_shared<source_t>();
+    loaded->path = resolved;
+    loaded->id = source_id;
+    loaded->modification_time = modification_time;
+    loaded->size = size;
+    loaded->tokens = lex(*file, resolved, source_id);
+    loaded->directives = std::make_shared<const std::vector<size_t>>(find_directive_lines(*loaded->tokens));
+    loaded->lines = std::make_shared<line_index>(file);
+    loaded->file = std::move(file);
+    promise.set_value(loaded);
+
+    lock.lock();
+    ++m_lex_count;
+    return loaded;
+}
+
+std::shared_ptr<const source_t> source_manager::find(uint32_t id) const {
+    std::unique_lock lock(m_mutex);
+    if ((id == 0) || (id > m_paths.size())) return nullptr;
+    const auto it = m_sources.find(m_paths[id - 1]);
+    if (it == m_sources.end()) return nullptr;
+    const auto entry = it->second;
+    lock.unlock();
+    return entry->source.get();
+}
+
+size_t source_manager::lex_count() const {
+    std::lock_guard lock(m_mutex);
+    return m_lex_count;
+}
+
+uint64_t source_manager::size() const {
+    std::lock_guard lock(m_mutex);
+    uint64_t size = 0;
+    for (const auto& [path, entry] : m_sources) size += entry->size;
+    return size;
+}
+
+}
@@ -0,0 +1,104 @@
+#include <sasm/statement.h>
+#include <sasm/assert.h>
+
+#include <utility>
+
+namespace sasm {
+
+name_t name_table::intern(std::string_view name) {
+    const auto it = m_ids.find(name);
+    if (it != m_ids.end()) return it->second;
+
+    const auto id = static_cast<name_t>(m_names.size());
+    const auto& stored = m_names.emplace_back(name);
+    m_ids.emplace(stored, id);
+    return id;
+}
+
+std::string_view name_table::operator[](name_t id) const {
+    assert(id < m_names.size());
+    return m_names[id];
+}
+
+size_t name_table::size() const {
+    return m_names.size();
+}
+
+const expression_t* expression_arena::store(const expression_t& expr) {
+    if (expr.is_value()) {
+        const auto key = std::make_pair(expr.get_value(), expr.type);
+        const auto it = m_values.find(key);
+        if (it != m_values.end()) return it->second;
+
+        const auto stored = &m_expressions.emplace_back(expr);
+        m_values.emplace(key, stored);
+        return stored;
+    }
+    return &m_expressions.emplace_back(expr);
+}
+
+const expression_t* expression_arena::store(expression_t&& expr) {
+    if (expr.is_value()) return store(std::as_const(expr));
+    return &m_expressions.emplace_back(std::move(expr));
+}
+
+size_t expression_arena::size() const {
+    return m_expressions.size();
+}
+
+namespace {
+
+// Payloads are copied from an lvalue token, moved from an rvalue one
+template <typename token_t>
+statement_t compact(token_t&& token, statement_context& context) {
+    const auto name = [&] () { return context.names.intern(token.content); };
+    const auto operand = [&] () { return context.expressions.store(std::forward<token_t>(token).operand); };
+    switch (token.kind) {
+        case parser_token::instruction: {
+            const auto& instr = token.instr;
+            const auto has_operand = !instr.operand.content.empty();
+            return statement::instruction{
+                instr.name,
+                instr.style,
+                has_operand ? context.expressions.store(std::forward<token_t>(token).instr.operand) : nullptr
+            };
+        }
+        case parser_token::label: return statement::label{ name() };
+        case parser_token::local_label: {
+            const auto& item = token.operand.content.front();
+            return statement::local_label{ item.scope, item.val };
+        }
+        case parser_token::anonymous_label:
+            return statement::anonymous_label{ token.operand.content.front().val };
+        case parser_token::define: return statement::define{ name(), operand() };
+        case parser_token::align: return statement::align{ operand() };
+        case parser_token::data: return statement::data{ operand() };
+        case parser_token::data_block:
+            return statement::data_block{ &context.data_blocks.emplace_back(std::get<data_block_t>(std::forward<token_t>(token).payload)) };
+        case parser_token::import_symbol: return statement::import_symbol{ name() };
+        case parser_token::export_symbol: return statement::export_symbol{ name() };
+        case parser_token::binary_include: {
+            const auto argument = [&] (size_t i) -> const operand_t* {
+                if (i >= token.arguments().size()) return nullptr;
+                return context.expressions.store(token.arguments()[i]);
+            };
+            return statement::binary_include{ name(), argument(0), argument(1) };
+        }
+        case parser_token::unknown: return statement::unknown{};
+        case parser_token::end_of_file: break;
+    }
+    assert(false);
+    return statement::unknown{};
+}
+
+}
+
+statement_t make_statement(const parser_token& token, statement_context& context) {
+    return compact(token, context);
+}
+
+statement_t make_statement(parser_token&& token, statement_context& context) {
+    return compact(std::move(token), context);
+}
+
+}
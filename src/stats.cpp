@@ -0,0 +1,55 @@
+#include <sasm/stats.h>
+#include <sasm/parser.h>
+
+namespace sasm {
+
+static_assert(stats_t::token_types == lexer_token::string_literal + 1);
+static_assert(stats_t::statement_kinds == parser_token::binary_include + 1);
+
+stats_t& stats_t::operator-=(const stats_t& earlier) {
+    characters -= earlier.characters;
+    for (size_t i = 0; i < token_types; ++i) tokens[i] -= earlier.tokens[i];
+    trivia -= earlier.trivia;
+    scope_pushes -= earlier.scope_pushes;
+    scope_cancels -= earlier.scope_cancels;
+    scope_accepts -= earlier.scope_accepts;
+    resets -= earlier.resets;
+    restaged -= earlier.restaged;
+    for (size_t i = 0; i < statement_kinds; ++i) statements[i] -= earlier.statements[i];
+    return *this;
+}
+
+std::vector<std::string> stats_t::report() const {
+    static const std::array<const char*, token_types> token_names {
+        "unknown", "end_of_file", "end_of_line", "whitespace", "identifier",
+        "comment", "literal", "keyword", "symbol", "string_literal",
+    };
+    static const std::array<const char*, statement_kinds> statement_names {
+        "unknown", "end_of_file", "instruction", "label", "local_label",
+        "anonymous_label", "define", "align", "data", "data_block",
+        "import_symbol", "export_symbol", "binary_include",
+    };
+    std::vector<std::string> lines;
+    const auto add = [&] (const std::string& name, uint64_t value) {
+        if (value > 0) lines.push_back(name + " " + std::to_string(value));
+    };
+    add("characters", characters);
+    for (size_t i = 0; i < token_types; ++i) add(std::string("tokens.") + token_names[i], tokens[i]);
+    add("trivia", trivia);
+    add("scope.pushes", scope_pushes);
+    add("scope.cancels", scope_cancels);
+    add("scope.accepts", scope_accepts);
+    add("scope.resets", resets);
+    add("restaged", restaged);
+    for (size_t i = 0; i < statement_kinds; ++i) {
+        add(std::string("statements.") + statement_names[i], statements[i]);
+    }
+    return lines;
+}
+
+stats_t& thread_stats() {
+    thread_local stats_t stats;
+    return stats;
+}
+
+}
@@ -0,0 +1,163 @@
+#include <sasm/trace.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace sasm {
+
+namespace {
+
+using trace_clock = std::chrono::steady_clock;
+
+struct trace_event_t {
+    const char* name;
+    std::string detail;
+    int64_t start;      // nanoseconds since start_trace
+    int64_t duration;
+};
+
+// Events of one thread, only ever appended to by that thread
+struct trace_buffer_t {
+    uint32_t thread;
+    std::vector<trace_event_t> events;
+    trace_buffer_t* next;
+};
+
+std::atomic<bool> g_tracing = false;
+std::atomic<trace_buffer_t*> g_buffers = nullptr;
+std::atomic<uint32_t> g_threads = 0;
+trace_clock::time_point g_start;
+std::string g_path;
+size_t g_written = 0;
+
+// Buffers of the threads which ended, handed to the next new threads
+std::mutex g_free_mutex;
+std::vector<trace_buffer_t*> g_free;
+
+constexpr std::string_view header = "{\"traceEvents\":[";
+constexpr std::string_view trailer = "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+// Buffer of a thread while it runs
+struct buffer_lease_t {
+    trace_buffer_t* buffer = nullptr;
+
+    ~buffer_lease_t() {
+        if (!buffer) return;
+        std::lock_guard lock(g_free_mutex);
+        g_free.push_back(buffer);
+    }
+};
+
+trace_buffer_t& thread_buffer() {
+    thread_local buffer_lease_t lease;
+    if (!lease.buffer) {
+        // The events of a thread are written after it ended, its buffer
+        // stays listed and goes, with its row, to a thread started later
+        std::lock_guard lock(g_free_mutex);
+        if (!g_free.empty()) {
+            lease.buffer = g_free.back();
+            g_free.pop_back();
+        } else {
+            lease.buffer = new trace_buffer_t { g_threads.fetch_add(1), {}, g_buffers.load() };
+            while (!g_buffers.compare_exchange_weak(lease.buffer->next, lease.buffer)) {}
+        }
+    }
+    return *lease.buffer;
+}
+
+void escape(std::ostream& output, const std::string& text) {
+    for (const auto c : text) {
+        if ((c == '"') || (c == '\\')) {
+            output << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            output << code;
+        } else {
+            output << c;
+        }
+    }
+}
+
+void write_at_exit() {
+    if (g_tracing) write_trace();
+}
+
+}
+
+bool start_trace(const std::string& path) {
+    static std::once_flag registered;
+    std::call_once(registered, [] { std::atexit(write_at_exit); });
+    g_path = path;
+    g_start = trace_clock::now();
+    g_written = 0;
+    std::ofstream output(g_path, std::ios::binary);
+    output << header << trailer;
+    if (!output) return false;
+    g_tracing = true;
+    return true;
+}
+
+// Appends the events recorded since the last write before the trailer,
+// so that the file is complete after each write
+bool write_trace() {
+    if (g_path.empty()) return false;
+    std::fstream output(g_path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!output) return false;
+    output.seekp(-static_cast<std::streamoff>(trailer.size()), std::ios::end);
+    for (auto* buffer = g_buffers.load(); buffer; buffer = buffer->next) {
+        for (const auto& event : buffer->events) {
+            char times[64];
+            std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f",
+                          event.start / 1e3, event.duration / 1e3);
+            output << ((g_written++ == 0) ? "\n" : ",\n")
+                   << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                   << buffer->thread << "," << times;
+            if (!event.detail.empty()) {
+                output << ",\"args\":{\"file\":\"";
+                escape(output, event.detail);
+                output << "\"}";
+            }
+            output << "}";
+        }
+        buffer->events.clear();
+    }
+    output << trailer;
+    return static_cast<bool>(output);
+}
+
+bool stop_trace() {
+    const auto written = write_trace();
+    g_tracing = false;
+    g_path.clear();
+    return written;
+}
+
+bool tracing() {
+    return g_tracing.load(std::memory_order_relaxed);
+}
+
+trace_span::trace_span(const char* name, std::string_view detail)
+: m_name(name)
+, m_active(tracing())
+{
+    if (!m_active) return;
+    m_detail = detail;
+    m_start = trace_clock::now();
+}
+
+trace_span::~trace_span() {
+    if (!m_active) return;
+    const auto end = trace_clock::now();
+    const auto since = [] (trace_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - g_start).count();
+    };
+    thread_buffer().events.push_back({ m_name, std::move(m_detail), since(m_start), since(end) - since(m_start) });
+}
+
+}
@@ -0,0 +1,186 @@
+#include <sasm/watcher.h>
+#include <sasm/object.h>
+#include <sasm/parallel.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+
+#ifdef __linux__
+#define SASM_HAS_INOTIFY 1
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace sasm {
+
+namespace fs = std::filesystem;
+
+watcher::watcher(const driver_options_t& options)
+: m_options(options)
+, m_linker(options.assemble.origin)
+, m_inotify(-1)
+{
+    for (const auto& path : m_options.include_paths) {
+        m_sources.add_include_path(path);
+    }
+    for (auto& source : m_options.sources) {
+        std::error_code error;
+        source = fs::absolute(source, error).lexically_normal().string();
+        m_objects.push_back(fs::path(source).replace_extension(".o").string());
+    }
+    m_dependencies.resize(m_options.sources.size());
+#ifdef SASM_HAS_INOTIFY
+    m_inotify = ::inotify_init1(IN_CLOEXEC);
+#endif
+}
+
+watcher::~watcher() {
+#ifdef SASM_HAS_INOTIFY
+    if (m_inotify >= 0) ::close(m_inotify);
+#endif
+}
+
+bool watcher::assemble_modules(const std::vector<size_t>& modules) {
+    std::vector<std::vector<std::string>> dependencies(modules.size());
+    std::vector<char> failed(modules.size(), false);   // set by the workers, not a vector<bool>
+    parallel_for(modules.size(), [&] (size_t i) {
+        const auto index = modules[i];
+        assembly_t assembly;
+        assemble_options_t options;
+        options.relocatable = true;
+        options.limits = m_options.assemble.limits;
+        const auto& source = m_options.sources[index];
+        const auto assembled = assemble(source, m_sources, options, assembly);
+        if (!assembled || !write_object(assembly.output, m_objects[index])) {
+            std::lock_guard lock(m_messages_mutex);
+            const auto errors = assembly.errors.messages();
+            m_messages.insert(m_messages.end(), errors.begin(), errors.end());
+            if (assembled) m_messages.push_back("cannot write " + m_objects[index]);
+            failed[i] = true;
+        }
+        dependencies[i] = std::move(assembly.dependencies);
+        dependencies[i].push_back(source);
+    });
+
+    // The graph is updated even on failure, a fix may be in any of the files
+    for (size_t i = 0; i < modules.size(); ++i) {
+        const auto index = modules[i];
+        if (failed[i]) {
+            m_failed.insert(index);
+        } else {
+            m_failed.erase(index);
+        }
+        for (const auto& path : m_dependencies[index]) {
+            m_dependents[path].erase(index);
+        }
+        m_dependencies[index] = std::move(dependencies[i]);
+        for (const auto& path : m_dependencies[index]) {
+            m_dependents[path].insert(index);
+        }
+    }
+    std::erase_if(m_dependents, [] (const auto& entry) { return entry.second.empty(); });
+    watch_directories();
+    return m_failed.empty();
+}
+
+bool watcher::link(const std::vector<size_t>& modules) {
+    // Linked in full until a link succeeds, the first build may have failed
+    const auto linked = (modules.empty() || !m_linker.linked())
+        ? m_linker.link(m_objects)
+        : m_linker.relink(modules);
+    m_messages.insert(m_messages.end(), m_linker.errors().begin(), m_linker.errors().end());
+    if (!linked) return false;
+    if (!m_linker.write(m_options.output)) {
+        m_messages.push_back("cannot write " + m_options.output);
+        return false;
+    }
+    return true;
+}
+
+void watcher::watch_directories() {
+#ifdef SASM_HAS_INOTIFY
+    if (m_inotify < 0) return;
+    // Directories rather than files, editors often replace the files they save
+    std::set<std::string> watched;
+    for (const auto& [wd, directory] : m_watches) watched.insert(directory);
+    for (const auto& [path, modules] : m_dependents) {
+        const auto directory = fs::path(path).parent_path().string();
+        if (!watched.insert(directory).second) continue;
+        const auto wd = ::inotify_add_watch(m_inotify, directory.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+        if (wd >= 0) m_watches[wd] = directory;
+    }
+#endif
+}
+
+bool watcher::build() {
+    m_messages.clear();
+    m_rebuilt.resize(m_options.sources.size());
+    std::iota(m_rebuilt.begin(), m_rebuilt.end(), 0);
+    return assemble_modules(m_rebuilt) && link({});
+}
+
+bool watcher::rebuild(const std::vector<std::string>& files) {
+    m_messages.clear();
+    std::set<size_t> modules;
+    for (const auto& path : files) {
+        const auto it = m_dependents.find(path);
+        if (it != m_dependents.end()) modules.insert(it->second.begin(), it->second.end());
+    }
+    // A failed module left its previous object, if any, which must not be linked
+    modules.insert(m_failed.begin(), m_failed.end());
+    m_rebuilt.assign(modules.begin(), modules.end());
+    if (m_rebuilt.empty()) return true;
+    return assemble_modules(m_rebuilt) && link(m_rebuilt);
+}
+
+bool watcher::wait(int timeout_ms, std::vector<std::string>& files) {
+    files.clear();
+#ifdef SASM_HAS_INOTIFY
+    if (m_inotify < 0) return false;
+    pollfd descriptor { m_inotify, POLLIN, 0 };
+    if (::poll(&descriptor, 1, timeout_ms) <= 0) return false;
+
+    // Editors save in several steps, the events which follow closely are
+    // gathered into the same change
+    std::set<std::string> changed;
+    alignas(inotify_event) char buffer[16384];
+    do {
+        const auto size = ::read(m_inotify, buffer, sizeof(buffer));
+        if (size <= 0) break;
+        for (ssize_t offset = 0; offset < size; ) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            const auto it = m_watches.find(event->wd);
+            if ((it == m_watches.end()) || (event->len == 0)) continue;
+            const auto path = (fs::path(it->second) / event->name).string();
+            if (m_dependents.count(path) > 0) changed.insert(path);
+        }
+    } while (::poll(&descriptor, 1, 50) > 0);
+    files.assign(changed.begin(), changed.end());
+    return !files.empty();
+#else
+    (void)timeout_ms;
+    return false;
+#endif
+}
+
+bool watcher::watching() const {
+    return m_inotify >= 0;
+}
+
+const std::vector<size_t>& watcher::rebuilt() const {
+    return m_rebuilt;
+}
+
+const std::vector<std::string>& watcher::messages() const {
+    return m_messages;
+}
+
+const linker& watcher::program() const {
+    return m_linker;
+}
+
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <sasm/allocation.h>
+#include <sasm/parser.h>
+
+class TestAllocation : public ::testing::Test {
+public:
+    void SetUp() override {
+        if (!sasm::allocations_counted()) GTEST_SKIP() << "built without SASM_ALLOCATIONS";
+    }
+
+    static uint64_t Count(sasm::allocation_stage stage) {
+        return sasm::allocation_counts()[static_cast<size_t>(stage)].count;
+    }
+
+    // Instruction lines of short tokens
+    static std::string Source(size_t lines) {
+        std::string source;
+        for (size_t i = 0; i < lines; ++i) source += "    ADC $1234, X  ; comment\n";
+        return source;
+    }
+};
+
+TEST_F(TestAllocation, Stages) {
+    sasm::reset_allocation_counts();
+    // Blocks of earlier tests may still be live
+    const auto live = sasm::allocation_counts()[static_cast<size_t>(sasm::allocation_stage::lexer)].live;
+    {
+        sasm::allocation_scope scope(sasm::allocation_stage::lexer);
+        std::vector<int> values(100);
+        {
+            sasm::allocation_scope inner(sasm::allocation_stage::expression);
+            std::vector<int> more(10);
+        }
+        std::vector<int> again(10);
+    }
+    const auto counts = sasm::allocation_counts();
+    const auto& lexer = counts[static_cast<size_t>(sasm::allocation_stage::lexer)];
+    EXPECT_EQ(lexer.count, 2);
+    EXPECT_EQ(lexer.bytes, 110 * sizeof(int));
+    EXPECT_EQ(lexer.peak - live, 110 * sizeof(int));
+    EXPECT_EQ(lexer.live, live);
+    EXPECT_EQ(Count(sasm::allocation_stage::expression), 1);
+
+    const auto report = sasm::allocation_report();
+    EXPECT_TRUE(std::any_of(report.begin(), report.end(),
+        [] (const std::string& line) { return line.starts_with("lexer "); }));
+}
+
+// Tokens of at most 15 characters stay in the string of the token
+TEST_F(TestAllocation, LexerShortTokens) {
+    const auto source = Source(1000);
+    sasm::reader reader(source.data(), source.size());
+    sasm::lexer lexer(&reader);
+    // The first identifier builds the keyword table
+    lexer.get();
+    lexer.get();
+    sasm::reset_allocation_counts();
+    size_t tokens = 2;
+    for (auto token = lexer.get(); !token.eof(); token = lexer.get()) ++tokens;
+    EXPECT_EQ(tokens, 10000);
+    EXPECT_EQ(Count(sasm::allocation_stage::lexer), 0);
+}
+
+// The staging buffer is reused from line to line, it only grows
+TEST_F(TestAllocation, ParserBaseBuffer) {
+    const auto source = Source(1000);
+    sasm::reader reader(source.data(), source.size());
+    sasm::lexer lexer(&reader);
+    sasm::parser_base_t parser(&lexer);
+    sasm::reset_allocation_counts();
+    for (auto token = parser.stage_token(); !token.eof(); token = parser.stage_token()) {
+        if (token.is<sasm::lexer_token::end_of_line>()) parser.accept();
+    }
+    EXPECT_LE(Count(sasm::allocation_stage::parser_base), 16);
+}
+
+// Statements of one line are kept in a vector reused by the next ones
+TEST_F(TestAllocation, ParserStatements) {
+    const auto source = Source(1000);
+    sasm::reader reader(source.data(), source.size());
+    sasm::lexer lexer(&reader);
+    sasm::parser parser(&lexer);
+    sasm::reset_allocation_counts();
+    size_t statements = 0;
+    for (auto statement = parser.get(); !statement.eof(); statement = parser.get()) ++statements;
+    EXPECT_EQ(statements, 1000);
+    EXPECT_EQ(Count(sasm::allocation_stage::lexer), 0);
+    EXPECT_LE(Count(sasm::allocation_stage::parser_base), 16);
+    // The operand of each instruction is a vector of one item
+    EXPECT_LE(Count(sasm::allocation_stage::expression), 4 * statements);
+}
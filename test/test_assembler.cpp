@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <sasm/assembler.h>
+#include <sasm/object.h>
+
+#include <filesystem>
+#include <fstream>
+
+class TestAssembler : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_assembler";
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+};
+
+TEST_F(TestAssembler, Binary) {
+    const auto header = Write("header.s", ".define VALUE 3\n");
+    const auto data = Write("data.bin", "xy");
+    const auto main = Write("main.s",
+        ".include \"" + header + "\"\n"
+        "START: LDX #VALUE\n"
+        "JMP START\n"
+        ".incbin \"" + data + "\"\n");
+
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    sasm::assemble_options_t options;
+    options.origin = 0x200;
+    ASSERT_TRUE(sasm::assemble(main, sources, options, assembly));
+    EXPECT_TRUE(assembly.errors.empty());
+    EXPECT_EQ(assembly.dependencies, std::vector<std::string>({ data, header }));
+
+    bytes_t content;
+    ASSERT_TRUE(sasm::serialize(assembly, content));
+    EXPECT_EQ(content, bytes_t({ 0xA2, 0x03, 0x4C, 0x00, 0x02, 'x', 'y' }));
+}
+
+TEST_F(TestAssembler, Object) {
+    const auto main = Write("main.s", ".export START\nSTART: JMP START\n");
+
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    sasm::assemble_options_t options;
+    options.relocatable = true;
+    ASSERT_TRUE(sasm::assemble(main, sources, options, assembly));
+
+    bytes_t content;
+    ASSERT_TRUE(sasm::serialize(assembly, content));
+    sasm::object_view view;
+    ASSERT_TRUE(view.open(content));
+    EXPECT_NE(view.find_symbol("START"), nullptr);
+}
+
+TEST_F(TestAssembler, Repeat) {
+    // Lookup table of forward addresses, generated from one line
+    const auto main = Write("main.s",
+        ".repeat 3, i\n"
+        ".word TABLE + i * 2\n"
+        ".endrepeat\n"
+        "TABLE:\n");
+
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    sasm::assemble_options_t options;
+    options.origin = 0x1000;
+    ASSERT_TRUE(sasm::assemble(main, sources, options, assembly));
+    bytes_t content;
+    ASSERT_TRUE(sasm::serialize(assembly, content));
+    EXPECT_EQ(content, bytes_t({ 0x06, 0x10, 0x08, 0x10, 0x0A, 0x10 }));
+}
+
+TEST_F(TestAssembler, LocalLabels) {
+    // Each expansion and iteration has its own local labels
+    const auto main = Write("main.s",
+        ".macro WAIT\n"
+        "@loop: LDX #1\n"
+        "BCC @loop\n"
+        ".endmacro\n"
+        "START:\n"
+        "WAIT\n"
+        ".repeat 2\n"
+        "@skip: BCC @skip\n"
+        ".endrepeat\n"
+        "WAIT\n"
+        "@end: JMP @end\n");
+
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    sasm::assemble_options_t options;
+    options.origin = 0x1000;
+    ASSERT_TRUE(sasm::assemble(main, sources, options, assembly));
+    bytes_t content;
+    ASSERT_TRUE(sasm::serialize(assembly, content));
+    EXPECT_EQ(content, bytes_t({
+        0xA2, 0x01, 0x90, 0xFC,
+        0x90, 0xFE, 0x90, 0xFE,
+        0xA2, 0x01, 0x90, 0xFC,
+        0x4C, 0x0C, 0x10 }));
+}
+
+TEST_F(TestAssembler, Errors) {
+    const auto main = Write("main.s", "NOP\nJMP MISSING\nLDX #$1234\n");
+
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    EXPECT_FALSE(sasm::assemble(main, sources, {}, assembly));
+    EXPECT_EQ(assembly.errors.messages(), std::vector<std::string>({
+        main + ":3:1: statement 3 cannot be encoded",
+        main + ": unresolved symbols" }));
+
+    const auto twice = Write("twice.s", "START: NOP\n@loop: NOP\n@loop: NOP\nSTART: NOP\n");
+    EXPECT_FALSE(sasm::assemble(twice, sources, {}, assembly));
+    EXPECT_EQ(assembly.errors.messages(), std::vector<std::string>({
+        twice + ":3:1: statement 5 defines a symbol already defined",
+        twice + ":4:1: statement 7 defines a symbol already defined" }));
+
+    EXPECT_FALSE(sasm::assemble(main + ".missing", sources, {}, assembly));
+    EXPECT_EQ(assembly.errors.entries().size(), 1);
+}
+
+TEST_F(TestAssembler, Limits) {
+    const auto header = Write("header.s", "NOP\n.byte 1, 2, 3, 4, 5, 6, 7, 8, 9\n");
+    const auto main = Write("main.s", ".include \"header.s\"\nLDX #((1))\n");
+
+    sasm::source_manager sources;
+    sources.add_include_path(m_directory.string());
+    sasm::assembly_t assembly;
+    sasm::assemble_options_t options;
+    options.limits = { 1, 24 };
+    EXPECT_FALSE(sasm::assemble(main, sources, options, assembly));
+    EXPECT_EQ(assembly.errors.messages(), std::vector<std::string>({
+        header + ":2:25: line longer than 24 bytes",
+        main + ":2:7: parentheses nested deeper than 1",
+        header + ":2:1: statement 3 is invalid",
+        main + ":2:1: statement 4 cannot be encoded",
+        main + ":2:1: statement 5 is invalid" }));
+
+    options.limits = {};
+    EXPECT_TRUE(sasm::assemble(main, sources, options, assembly));
+}
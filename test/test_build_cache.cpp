@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <sasm/build_cache.h>
+#include <sasm/driver.h>
+
+#include <filesystem>
+#include <fstream>
+
+class TestBuildCache : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_build_cache";
+        std::filesystem::remove_all(m_directory);
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+
+    static bytes_t Bytes(const std::string& text) {
+        return bytes_t(text.begin(), text.end());
+    }
+};
+
+TEST_F(TestBuildCache, SourceKey) {
+    const auto source = Bytes("NOP");
+    const auto key = sasm::build_cache::source_key(source, "origin=0");
+    EXPECT_EQ(key, sasm::build_cache::source_key(source, "origin=0"));
+    EXPECT_NE(key, sasm::build_cache::source_key(source, "origin=1"));
+    EXPECT_NE(key, sasm::build_cache::source_key(Bytes("ROL"), "origin=0"));
+}
+
+TEST_F(TestBuildCache, FindStore) {
+    const auto include = Write("include.s", ".define VALUE 1");
+    sasm::build_cache cache((m_directory / "cache").string(), 1 << 20);
+    const auto key = sasm::build_cache::source_key(Bytes("LDX #VALUE"), "");
+
+    sasm::mapped_file output;
+    EXPECT_FALSE(cache.find(key, output));
+
+    ASSERT_TRUE(cache.store(key, { include }, Bytes("output")));
+    ASSERT_TRUE(cache.find(key, output));
+    EXPECT_EQ(bytes_t(output.bytes().begin(), output.bytes().end()), Bytes("output"));
+
+    // Changing an include makes the entry stale
+    Write("include.s", ".define VALUE 2");
+    EXPECT_FALSE(cache.find(key, output));
+    ASSERT_TRUE(cache.store(key, { include }, Bytes("other output")));
+    ASSERT_TRUE(cache.find(key, output));
+    EXPECT_EQ(bytes_t(output.bytes().begin(), output.bytes().end()), Bytes("other output"));
+
+    std::filesystem::remove(include);
+    EXPECT_FALSE(cache.find(key, output));
+}
+
+// The same bytes including from another directory are another entry
+TEST_F(TestBuildCache, Directory) {
+    std::filesystem::create_directories(m_directory / "a");
+    std::filesystem::create_directories(m_directory / "b");
+    Write("a/header.s", ".define VALUE 1\n");
+    Write("b/header.s", ".define VALUE 2\n");
+    const auto main = Write("main.s", ".include \"header.s\"\nLDX #VALUE\n");
+
+    sasm::driver_options_t options;
+    options.source = main;
+    options.output = (m_directory / "main.bin").string();
+    options.cache_directory = (m_directory / "cache").string();
+    for (const auto& [directory, value] : { std::pair{ "a", 1 }, std::pair{ "b", 2 }, std::pair{ "a", 1 } }) {
+        sasm::source_manager sources;
+        sources.set_directory((m_directory / directory).string());
+        sasm::driver_result_t result;
+        ASSERT_TRUE(sasm::run_driver(options, sources, result)) << directory;
+        EXPECT_EQ(result.output, bytes_t({ 0xA2, static_cast<uint8_t>(value) })) << directory;
+    }
+}
+
+TEST_F(TestBuildCache, Evict) {
+    using namespace std::chrono_literals;
+    const auto directory = m_directory / "cache";
+    sasm::build_cache cache(directory.string(), 1000);
+    const bytes_t content(300, 0xEA);
+
+    const auto now = std::filesystem::file_time_type::clock::now();
+    for (uint64_t key = 1; key <= 3; ++key) {
+        ASSERT_TRUE(cache.store(key, {}, content));
+        // Spread the use times, key 1 being the least recently used
+        for (const auto& item : std::filesystem::directory_iterator(directory)) {
+            if (std::filesystem::last_write_time(item) > now - 10min) {
+                std::filesystem::last_write_time(item, now - 1h + std::chrono::minutes(key));
+            }
+        }
+    }
+    EXPECT_LE(cache.size(), 1000);
+
+    sasm::mapped_file output;
+    EXPECT_TRUE(cache.find(2, output));
+    EXPECT_TRUE(cache.find(3, output));
+    ASSERT_TRUE(cache.store(4, {}, content));
+    EXPECT_LE(cache.size(), 1000);
+    EXPECT_FALSE(cache.find(1, output));
+    EXPECT_TRUE(cache.find(4, output));
+}
@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+
+#include <sasm/assembler.h>
+#include <sasm/debug_map.h>
+#include <sasm/driver.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+class TestDebugMap : public ::testing::Test {
+public:
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_debug_map";
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+
+    // Rows of instructions a few bytes long on following lines, with jumps
+    // of address, line, file and column now and then
+    static std::vector<sasm::debug_row_t> Rows(size_t count, uint32_t files) {
+        std::mt19937 random(11);
+        std::vector<sasm::debug_row_t> rows;
+        sasm::debug_row_t row{ 0x8000, 0, 1, 5 };
+        for (size_t i = 0; i < count; ++i) {
+            rows.push_back(row);
+            row.address += 1 + random() % 3;
+            row.line += 1;
+            if (random() % 50 == 0) row.address += random() % 5000;
+            if (random() % 40 == 0) row.line = 1 + random() % 3000;
+            if (random() % 60 == 0) row.file = random() % files;
+            if (random() % 30 == 0) row.column = 1 + random() % 40;
+        }
+        return rows;
+    }
+};
+
+TEST_F(TestDebugMap, RoundTrip) {
+    const std::vector<std::string> files{ "main.s", "header.s", "macros.s" };
+    const auto rows = Rows(1000, files.size());
+    const auto end = rows.back().address + 3;
+    std::vector<uint8_t> content;
+    ASSERT_TRUE(sasm::write_debug_map(files, rows, end, content));
+
+    sasm::debug_map_view view;
+    ASSERT_TRUE(view.open(content));
+    EXPECT_EQ(view.file_count(), 3);
+    EXPECT_EQ(view.file(1), "header.s");
+    EXPECT_EQ(view.file(3), "");
+    EXPECT_EQ(view.end_address(), end);
+    EXPECT_EQ(view.rows(), rows);
+
+    // Every address against the row before it
+    sasm::debug_row_t row;
+    EXPECT_FALSE(view.find(rows.front().address - 1, row));
+    EXPECT_FALSE(view.find(end, row));
+    size_t next = 0;
+    for (uint32_t address = rows.front().address; address < end; ++address) {
+        while ((next < rows.size()) && (rows[next].address <= address)) ++next;
+        ASSERT_TRUE(view.find(address, row)) << address;
+        ASSERT_EQ(row, rows[next - 1]) << address;
+    }
+}
+
+// Rows on following lines take a byte each
+TEST_F(TestDebugMap, Compact) {
+    std::vector<sasm::debug_row_t> rows;
+    for (uint32_t i = 0; i < 10000; ++i) rows.push_back({ 0x8000 + i * 2, 0, 1 + i, 5 });
+    std::vector<uint8_t> content;
+    ASSERT_TRUE(sasm::write_debug_map(std::vector<std::string>{ "main.s" }, rows, 0x8000 + 20000, content));
+    EXPECT_LT(content.size(), 10000 + 10000 / sasm::debug_format::checkpoint_interval * 24 + 256);
+}
+
+TEST_F(TestDebugMap, Invalid) {
+    const std::vector<std::string> files{ "main.s" };
+    std::vector<uint8_t> content;
+    EXPECT_FALSE(sasm::write_debug_map(files, std::vector<sasm::debug_row_t>{ { 4, 0, 1, 1 }, { 4, 0, 2, 1 } }, 8, content));
+    EXPECT_FALSE(sasm::write_debug_map(files, std::vector<sasm::debug_row_t>{ { 4, 1, 1, 1 } }, 8, content));
+    EXPECT_FALSE(sasm::write_debug_map(files, std::vector<sasm::debug_row_t>{ { 8, 0, 1, 1 } }, 8, content));
+
+    ASSERT_TRUE(sasm::write_debug_map(files, Rows(100, 1), 0x10000, content));
+    sasm::debug_map_view view;
+    EXPECT_FALSE(view.open(std::span<const uint8_t>(content).first(content.size() - 1)));
+    content[0] = 'X';
+    EXPECT_FALSE(view.open(content));
+    sasm::debug_row_t row;
+    EXPECT_FALSE(view.find(0x8000, row));
+    EXPECT_TRUE(view.rows().empty());
+}
+
+// A layout which holds but a program which does not decode to its rows
+TEST_F(TestDebugMap, Program) {
+    using namespace sasm::debug_format;
+    const std::vector<std::string> files{ "main.s", "header.s" };
+    std::vector<uint8_t> valid;
+    ASSERT_TRUE(sasm::write_debug_map(files, std::vector<sasm::debug_row_t>{
+        { 4, 0, 1, 1 }, { 5, 0, 2, 1 }, { 6, 1, 3, 1 } }, 8, valid));
+    header head;
+    std::memcpy(&head, valid.data(), sizeof(head));
+    // Two special opcodes, then set_file 1 and a special opcode
+    ASSERT_EQ(head.program_size, 5);
+    sasm::debug_map_view view;
+    ASSERT_TRUE(view.open(valid));
+
+    const auto corrupt = [&] (size_t offset, uint8_t value) {
+        auto content = valid;
+        content[head.program_offset + offset] = value;
+        return !view.open(content);
+    };
+    EXPECT_TRUE(corrupt(3, 2));                 // a file out of the table
+    EXPECT_TRUE(corrupt(4, set_file));          // an opcode missing its operand
+    EXPECT_TRUE(corrupt(1, copy));              // a row not after the previous one
+    EXPECT_TRUE(corrupt(0, 0xFF));              // a row after the end
+    EXPECT_TRUE(corrupt(0, first_special + 5)); // a row away from its checkpoint
+
+    auto content = valid;
+    ++reinterpret_cast<header*>(content.data())->row_count;
+    EXPECT_FALSE(view.open(content));
+}
+
+TEST_F(TestDebugMap, Assemble) {
+    const auto header = Write("header.s", "    NOP\n");
+    const auto main = Write("main.s",
+        ".include \"header.s\"\n"
+        ".macro LOAD value\n"
+        "  LDX #value\n"
+        ".endmacro\n"
+        "START:\n"
+        "    LDX #1\n"
+        "    LOAD 2\n"
+        "    .repeat 3\n"
+        "    NOP\n"
+        "    .endrepeat\n"
+        "    JMP START\n");
+
+    sasm::source_manager sources;
+    sources.add_include_path(m_directory.string());
+    sasm::assemble_options_t options;
+    options.origin = 0x8000;
+    options.debug_map = true;
+    sasm::assembly_t assembly;
+    ASSERT_TRUE(sasm::assemble(main, sources, options, assembly));
+
+    sasm::debug_map_view view;
+    ASSERT_TRUE(view.open(assembly.debug_map));
+    ASSERT_EQ(view.file_count(), 2);
+    const auto main_file = (view.file(0) == main) ? 0u : 1u;
+    EXPECT_EQ(view.file(1 - main_file), header);
+    // The lines of the macro and of the repeat are those of their bodies
+    EXPECT_EQ(view.rows(), std::vector<sasm::debug_row_t>({
+        { 0x8000, 1 - main_file, 1, 5 },
+        { 0x8001, main_file, 6, 5 },
+        { 0x8003, main_file, 3, 3 },
+        { 0x8005, main_file, 9, 5 },
+        { 0x8008, main_file, 11, 5 } }));
+    sasm::debug_row_t row;
+    ASSERT_TRUE(view.find(0x8006, row));
+    EXPECT_EQ(row.line, 9);
+    EXPECT_EQ(view.end_address(), 0x800B);
+
+    const auto path = (m_directory / "main.dbg").string();
+    ASSERT_TRUE(sasm::write_debug_map(std::vector<std::string>{ main, header }, view.rows(), view.end_address(), path));
+    sasm::debug_map_file file;
+    ASSERT_TRUE(file.open(path));
+    ASSERT_TRUE(file.view().find(0x800A, row));
+    EXPECT_EQ(row.line, 11);
+
+    // Replaced by the driver, a map still mapped keeps its rows
+    sasm::driver_options_t driver;
+    driver.source = main;
+    driver.output = (m_directory / "main.bin").string();
+    driver.include_paths.push_back(m_directory.string());
+    driver.assemble = options;
+    driver.debug_map_path = path;
+    Write("main.s", "    NOP\n");
+    sasm::driver_result_t result;
+    sasm::source_manager driver_sources;
+    ASSERT_TRUE(sasm::run_driver(driver, driver_sources, result));
+    EXPECT_EQ(file.view().end_address(), 0x800B);
+    ASSERT_TRUE(file.view().find(0x800A, row));
+    EXPECT_EQ(row.line, 11);
+    sasm::debug_map_file replaced;
+    ASSERT_TRUE(replaced.open(path));
+    EXPECT_EQ(replaced.view().end_address(), 0x8001);
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    // Not asked for, no positions are kept
+    options.debug_map = false;
+    ASSERT_TRUE(sasm::assemble(main, sources, options, assembly));
+    EXPECT_TRUE(assembly.debug_map.empty());
+    EXPECT_TRUE(assembly.output.positions().empty());
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <sasm/assembler.h>
+
+#include <filesystem>
+#include <fstream>
+
+class TestDiagnostics : public ::testing::Test {
+public:
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_diagnostics";
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+};
+
+TEST_F(TestDiagnostics, Report) {
+    sasm::diagnostics_sink sink(8);
+    EXPECT_TRUE(sink.empty());
+    EXPECT_GE(sink.entries().capacity(), 8);
+
+    const auto main = sink.source("main.s");
+    EXPECT_EQ(sink.source("header.s"), main + 1);
+    EXPECT_EQ(sink.source("main.s"), main);
+
+    sink.report(sasm::diagnostic_code::invalid_statement, main, 0, 0, 3);
+    sink.report(sasm::diagnostic_code::line_too_long, main + 1, 20, 1, 16);
+    sink.report(sasm::diagnostic_code::nesting_too_deep, sasm::diagnostics_sink::no_source, 5, 1, 4);
+    ASSERT_EQ(sink.entries().size(), 3);
+    EXPECT_EQ(sink.entries()[1].code, sasm::diagnostic_code::line_too_long);
+    EXPECT_EQ(sink.entries()[1].offset, 20);
+    EXPECT_EQ(sink.entries()[1].argument, 16);
+
+    EXPECT_EQ(sink.messages(), std::vector<std::string>({
+        "main.s: offset 0: statement 3 is invalid",
+        "header.s: offset 20: line longer than 16 bytes",
+        "offset 5: parentheses nested deeper than 4" }));
+
+    sink.clear();
+    EXPECT_TRUE(sink.empty());
+    EXPECT_EQ(sink.source("header.s"), main + 1);
+}
+
+// Every line an error, each costs an entry and no message until asked for
+TEST_F(TestDiagnostics, ErrorHeavy) {
+    std::string content;
+    for (int i = 0; i < 10000; ++i) content += "LDX #$1234\n";
+    const auto main = Write("main.s", content);
+
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    EXPECT_FALSE(sasm::assemble(main, sources, {}, assembly));
+    ASSERT_EQ(assembly.errors.entries().size(), 10000);
+    EXPECT_EQ(assembly.errors.entries().back().argument, 10000);
+    EXPECT_EQ(assembly.errors.message(assembly.errors.entries().front()),
+              main + ":1:1: statement 1 cannot be encoded");
+}
+
+TEST_F(TestDiagnostics, Assertion) {
+#ifdef SASM_EXCEPTIONS
+    EXPECT_THROW(sasm::assert_f(false, "false", "f", "file.cpp", 1), sasm::assertion_exception);
+#else
+    EXPECT_DEATH(sasm::assert_f(false, "false", "f", "file.cpp", 1),
+                 "Assertion failed: false, function f, file file.cpp, line 1");
+#endif
+}
@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+
+#include <sasm/encoder.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+class TestEncoder : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    struct test_encoder {
+        sasm::reader m_reader;
+        sasm::lexer m_lexer;
+        sasm::parser m_parser;
+        sasm::encoder m_encoder;
+        explicit test_encoder(const std::string& content, size_t origin = 0)
+        : m_reader(content)
+        , m_lexer(&m_reader)
+        , m_parser(&m_lexer)
+        , m_encoder(origin)
+        {}
+
+        bool encode() {
+            for (const auto& statement : m_parser.statements()) {
+                if (!m_encoder.encode(statement)) return false;
+            }
+            return true;
+        }
+    };
+
+    static bytes_t Assemble(const std::string& content, size_t origin = 0) {
+        test_encoder encoder(content, origin);
+        EXPECT_TRUE(encoder.encode()) << content;
+        EXPECT_TRUE(encoder.m_encoder.finish()) << content;
+        return encoder.m_encoder.flatten();
+    }
+
+    static std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+};
+
+TEST_F(TestEncoder, Empty) {
+    EXPECT_EQ(Assemble(""), bytes_t());
+}
+
+TEST_F(TestEncoder, Instructions) {
+    EXPECT_EQ(Assemble("NOP"), bytes_t({ 0xEA }));
+    EXPECT_EQ(Assemble("ROL"), bytes_t({ 0x2A }));
+    EXPECT_EQ(Assemble("ADC #$10"), bytes_t({ 0x69, 0x10 }));
+    EXPECT_EQ(Assemble("ADC $10"), bytes_t({ 0x65, 0x10 }));
+    EXPECT_EQ(Assemble("ADC $1234"), bytes_t({ 0x6D, 0x34, 0x12 }));
+    EXPECT_EQ(Assemble("ADC $10, X"), bytes_t({ 0x75, 0x10 }));
+    EXPECT_EQ(Assemble("ADC $1234, Y"), bytes_t({ 0x79, 0x34, 0x12 }));
+    EXPECT_EQ(Assemble("ADC ($10, X)"), bytes_t({ 0x61, 0x10 }));
+    EXPECT_EQ(Assemble("ADC ($10), Y"), bytes_t({ 0x71, 0x10 }));
+    EXPECT_EQ(Assemble("JMP $10"), bytes_t({ 0x4C, 0x10, 0x00 }));
+    EXPECT_EQ(Assemble("JMP ($1234)"), bytes_t({ 0x6C, 0x34, 0x12 }));
+    EXPECT_EQ(Assemble("LDX $10, Y"), bytes_t({ 0xB6, 0x10 }));
+    EXPECT_EQ(Assemble("LDY $1234, X"), bytes_t({ 0xBC, 0x34, 0x12 }));
+}
+
+TEST_F(TestEncoder, Relative) {
+    EXPECT_EQ(Assemble("BCC *+5"), bytes_t({ 0x90, 0x03 }));
+    EXPECT_EQ(Assemble("BCC *-2"), bytes_t({ 0x90, 0xFC }));
+    EXPECT_EQ(Assemble("loop: BCC loop"), bytes_t({ 0x90, 0xFE }));
+    EXPECT_EQ(Assemble("BCC next\nNOP\nnext:"), bytes_t({ 0x90, 0x01, 0xEA }));
+}
+
+TEST_F(TestEncoder, References) {
+    EXPECT_EQ(Assemble(R"(
+        .define ZP $20
+        .define ABS ZP * $100
+        ADC ZP
+        ADC ABS
+        JMP target
+        target: NOP
+    )", 0x8000), bytes_t({
+        0x65, 0x20,
+        0x6D, 0x00, 0x20,
+        0x4C, 0x08, 0x80,
+        0xEA
+    }));
+}
+
+TEST_F(TestEncoder, LocalLabels) {
+    EXPECT_EQ(Assemble(R"(
+        FIRST:
+        @loop: BCC @loop
+        JMP @end
+        @end: NOP
+        SECOND:
+        @loop: BCC @loop
+    )", 0x8000), bytes_t({
+        0x90, 0xFE,
+        0x4C, 0x05, 0x80,
+        0xEA,
+        0x90, 0xFE,
+    }));
+
+    // Not visible from another scope
+    test_encoder encoder("A:\n@x: NOP\nB:\nJMP @x\n");
+    EXPECT_TRUE(encoder.encode());
+    EXPECT_FALSE(encoder.m_encoder.finish());
+}
+
+TEST_F(TestEncoder, AnonymousLabels) {
+    EXPECT_EQ(Assemble(R"(
+        : NOP
+        BCC :-
+        BCC :+
+        BCC :++
+        : NOP
+        :
+        NOP
+    )"), bytes_t({
+        0xEA,
+        0x90, 0xFD,
+        0x90, 0x02,
+        0x90, 0x01,
+        0xEA,
+        0xEA,
+    }));
+
+    // No label before
+    test_encoder encoder("BCC :-\n");
+    EXPECT_TRUE(encoder.encode());
+    EXPECT_FALSE(encoder.m_encoder.finish());
+}
+
+TEST_F(TestEncoder, Data) {
+    EXPECT_EQ(Assemble(R"(
+        .byte 1, 2, end
+        .word $1234, end
+        end:
+    )"), bytes_t({ 0x01, 0x02, 0x07, 0x34, 0x12, 0x07, 0x00 }));
+}
+
+TEST_F(TestEncoder, Align) {
+    EXPECT_EQ(Assemble(R"(
+        NOP
+        .align 4
+        NOP
+    )"), bytes_t({ 0xEA, 0x00, 0x00, 0x00, 0xEA }));
+}
+
+TEST_F(TestEncoder, Symbols) {
+    test_encoder encoder(R"(
+        .import IN
+        .export OUT
+        .define VALUE 3
+        NOP
+        OUT: JMP IN
+    )", 0x100);
+    ASSERT_TRUE(encoder.encode());
+    EXPECT_FALSE(encoder.m_encoder.finish());
+
+    const auto& symbols = encoder.m_encoder.symbols();
+    ASSERT_EQ(symbols.count("OUT"), 1);
+    EXPECT_EQ(symbols.at("OUT").kind, sasm::symbol_t::label);
+    EXPECT_EQ(symbols.at("OUT").value, 0x101);
+    ASSERT_EQ(symbols.count("VALUE"), 1);
+    EXPECT_EQ(symbols.at("VALUE").kind, sasm::symbol_t::define);
+
+    EXPECT_EQ(encoder.m_encoder.imports(), std::set<std::string>({ "IN" }));
+    EXPECT_EQ(encoder.m_encoder.exports(), std::set<std::string>({ "OUT" }));
+
+    const auto& fixups = encoder.m_encoder.fixups();
+    ASSERT_EQ(fixups.size(), 1);
+    EXPECT_EQ(fixups[0].field, sasm::fixup_t::u16);
+    EXPECT_EQ(fixups[0].address, 2);
+    EXPECT_EQ(fixups[0].expr.get_reference(), "IN");
+}
+
+TEST_F(TestEncoder, Failures) {
+    const auto check = [] (const std::string& content) {
+        test_encoder encoder(content);
+        EXPECT_FALSE(encoder.encode()) << content;
+    };
+    check("<>");
+    check("ADC");
+    check("NOP #1");
+    check("JMP ($10), Y");
+    check("a:\na:");
+    check("@a:\n@a:");
+    check(".align 0");
+    check(".incbin \"/this/file/does/not/exist\"");
+    check("BCC *+200");
+    check(".word $7FFFFFFF + $7FFFFFFF");
+}
+
+TEST_F(TestEncoder, BinaryInclude) {
+    const auto path = Write("sasm_test_incbin.bin", "ABCDEFGH");
+    const auto source = R"(
+        NOP
+        .incbin ")" + path + R"("
+        .incbin ")" + path + R"(", 2, 3
+        .incbin ")" + path + R"(", 6
+        NOP
+    )";
+
+    test_encoder encoder(source);
+    ASSERT_TRUE(encoder.encode());
+    ASSERT_TRUE(encoder.m_encoder.finish());
+
+    const std::string expected = "\xEA" "ABCDEFGH" "CDE" "GH" "\xEA";
+    const auto output = encoder.m_encoder.flatten();
+    EXPECT_EQ(std::string(output.begin(), output.end()), expected);
+    EXPECT_EQ(encoder.m_encoder.size(), expected.size());
+
+    // The file content is referenced, not copied
+    size_t file_fragments = 0;
+    for (const auto& fragment : encoder.m_encoder.fragments()) {
+        if (fragment.is_file()) ++file_fragments;
+    }
+    EXPECT_EQ(file_fragments, 3);
+
+    const auto output_path = (std::filesystem::temp_directory_path()
+                              / "sasm_test_incbin.out").string();
+    ASSERT_TRUE(encoder.m_encoder.write(output_path));
+    std::ifstream written(output_path, std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(written),
+                          std::istreambuf_iterator<char>()), expected);
+
+    std::remove(path.c_str());
+    std::remove(output_path.c_str());
+}
+
+TEST_F(TestEncoder, BinaryIncludeOutOfRange) {
+    const auto path = Write("sasm_test_incbin_range.bin", "ABCD");
+    const auto check = [&] (const std::string& arguments) {
+        test_encoder encoder(".incbin \"" + path + "\"" + arguments);
+        EXPECT_FALSE(encoder.encode()) << arguments;
+    };
+    check(", 5");
+    check(", 2, 3");
+    check(", -1");
+    check(", 2, $7FFFFFFF");
+    std::remove(path.c_str());
+}
@@ -205,3 +205,49 @@ TEST_F(TestExpression, Failure) {
     check("(");
     check("(A");
 }
+
+TEST_F(TestExpression, Evaluate) {
+    const auto lookup = [] (const sasm::reference_t& name, sasm::value_t& value) {
+        if (name == "A") { value = 10; return true; }
+        if (name == "B") { value = 3; return true; }
+        return false;
+    };
+    const auto check = [&](const std::string& expression, int expected) {
+        test_parser parser(expression);
+        sasm::expression_t expr;
+        ASSERT_TRUE(sasm::try_parse_expression(parser, expr)) << expression;
+        sasm::value_t value = 0;
+        EXPECT_TRUE(sasm::evaluate(expr, lookup, value)) << expression;
+        EXPECT_EQ(value, expected) << expression;
+    };
+    check("5", 5);
+    check("A", 10);
+    check("-A", -10);
+    check("+A", 10);
+    check("A + B", 13);
+    check("A * B + 1", 31);
+    check("(A + 1) * (B - 1)", 22);
+    check("A + -B", 7);
+}
+
+TEST_F(TestExpression, EvaluateFailure) {
+    test_parser parser("A + 1");
+    sasm::expression_t expr;
+    ASSERT_TRUE(sasm::try_parse_expression(parser, expr));
+    sasm::value_t value = 0;
+    EXPECT_FALSE(sasm::evaluate(expr, value));
+}
+
+TEST_F(TestExpression, EvaluateOverflow) {
+    const auto check = [&](const std::string& expression) {
+        test_parser parser(expression);
+        sasm::expression_t expr;
+        ASSERT_TRUE(sasm::try_parse_expression(parser, expr)) << expression;
+        sasm::value_t value = 0;
+        EXPECT_FALSE(sasm::evaluate(expr, value)) << expression;
+    };
+    check("$7FFFFFFF + $7FFFFFFF");
+    check("-$7FFFFFFF - 2");
+    check("$10000 * $10000");
+    check("-(-$7FFFFFFF - 1)");
+}
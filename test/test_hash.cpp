@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include <sasm/hash.h>
+
+#include <cstring>
+#include <numeric>
+
+class TestHash : public ::testing::Test {
+public:
+    static uint64_t Hash(const char* text, uint64_t seed = 0) {
+        return sasm::xxhash64(text, std::strlen(text), seed);
+    }
+};
+
+TEST_F(TestHash, Xxhash64) {
+    EXPECT_EQ(Hash(""), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(Hash("a"), 0xD24EC4F1A98C6E5BULL);
+    EXPECT_EQ(Hash("abc"), 0x44BC2CF5AD770999ULL);
+    EXPECT_EQ(Hash("abc", 1), 0xBEA9CA8199328908ULL);
+    EXPECT_EQ(Hash("Nobody inspects the spammish repetition"), 0xFBCEA83C8A378BF1ULL);
+
+    std::vector<uint8_t> bytes(100);
+    std::iota(bytes.begin(), bytes.end(), 0);
+    EXPECT_EQ(sasm::xxhash64(bytes.data(), bytes.size()), 0x6AC1E58032166597ULL);
+}
+
+TEST_F(TestHash, Builder) {
+    const auto hash = [] (std::string_view a, std::string_view b) {
+        return sasm::hash_builder().add(a).add(b).digest();
+    };
+    EXPECT_EQ(hash("a", "b"), hash("a", "b"));
+    EXPECT_NE(hash("a", "b"), hash("b", "a"));
+    EXPECT_NE(hash("ab", ""), hash("a", "b"));
+}
@@ -189,6 +189,40 @@ TEST_F(TestLexer, Symbol) {
     check("*");
 }
 
+TEST_F(TestLexer, StringLiteral) {
+    const auto check = &CheckSingle<sasm::lexer_token::string_literal>;
+    check(R"("")");
+    check(R"("file.bin")");
+    check(R"("with spaces ; and comment")");
+    check(R"("escaped \" quote")");
+    {
+        sasm::reader reader("\"a\"\"b\"");
+        sasm::lexer lexer(&reader);
+
+        auto token = lexer.get();
+        EXPECT_EQ(token.type, sasm::lexer_token::string_literal);
+        EXPECT_EQ(token.content, "\"a\"");
+
+        token = lexer.get();
+        EXPECT_EQ(token.type, sasm::lexer_token::string_literal);
+        EXPECT_EQ(token.content, "\"b\"");
+
+        EXPECT_TRUE(lexer.get().eof());
+    }
+    {
+        sasm::reader reader("\"unterminated\nNOP");
+        sasm::lexer lexer(&reader);
+
+        auto token = lexer.get();
+        EXPECT_EQ(token.type, sasm::lexer_token::unknown);
+        EXPECT_EQ(token.content, "\"unterminated");
+
+        EXPECT_EQ(lexer.get().type, sasm::lexer_token::end_of_line);
+        EXPECT_EQ(lexer.get().type, sasm::lexer_token::identifier);
+        EXPECT_TRUE(lexer.get().eof());
+    }
+}
+
 TEST_F(TestLexer, Unknown) {
     const auto check = &CheckSingle<sasm::lexer_token::unknown>;
     check("<");
@@ -313,3 +347,54 @@ TEST_F(TestLexer, FlagIsTrivia) {
     check("X", false);      // keyword
     check("#", false);      // symbol
 }
+
+TEST_F(TestLexer, Tokens) {
+    sasm::reader reader("label: NOP\n");
+    sasm::lexer lexer(&reader);
+
+    std::vector<sasm::lexer_token::token_type> types;
+    for (const auto& token : lexer.tokens()) {
+        types.push_back(token.type);
+    }
+    const std::vector<sasm::lexer_token::token_type> expected {
+        sasm::lexer_token::identifier,
+        sasm::lexer_token::symbol,
+        sasm::lexer_token::whitespace,
+        sasm::lexer_token::identifier,
+        sasm::lexer_token::end_of_line,
+    };
+    EXPECT_EQ(types, expected);
+
+    EXPECT_TRUE(lexer.get().eof());
+}
+
+TEST_F(TestLexer, TokensAllocator) {
+    struct counting_resource : public std::pmr::memory_resource {
+        int allocations = 0;
+        int deallocations = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            ++deallocations;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    } resource;
+
+    sasm::reader reader("a b c");
+    sasm::lexer lexer(&reader);
+    {
+        auto tokens = lexer.tokens(&resource);
+        EXPECT_EQ(resource.allocations, 1);
+        int count = 0;
+        for ([[maybe_unused]] const auto& token : tokens) ++count;
+        EXPECT_EQ(count, 5);
+    }
+    EXPECT_EQ(resource.allocations, 1);
+    EXPECT_EQ(resource.deallocations, 1);
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <sasm/diagnostics.h>
+#include <sasm/line_index.h>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+class TestLineIndex : public ::testing::Test {
+public:
+    // Line and column by counting every byte before the offset
+    static sasm::line_column_t Count(const std::string& content, size_t offset) {
+        sasm::line_column_t position { 1, 1 };
+        for (size_t i = 0; i < offset; ++i) {
+            if (content[i] == '\n') {
+                ++position.line;
+                position.column = 1;
+            } else {
+                ++position.column;
+            }
+        }
+        return position;
+    }
+};
+
+TEST_F(TestLineIndex, Locate) {
+    const std::string content = "NOP\n\nLDX #1\n";
+    const sasm::line_index lines(content.data(), content.size());
+    EXPECT_EQ(lines.locate(0), sasm::line_column_t({ 1, 1 }));
+    EXPECT_EQ(lines.locate(3), sasm::line_column_t({ 1, 4 }));
+    EXPECT_EQ(lines.locate(4), sasm::line_column_t({ 2, 1 }));
+    EXPECT_EQ(lines.locate(5), sasm::line_column_t({ 3, 1 }));
+    EXPECT_EQ(lines.locate(9), sasm::line_column_t({ 3, 5 }));
+    EXPECT_EQ(lines.locate(content.size()), sasm::line_column_t({ 4, 1 }));
+    EXPECT_EQ(lines.lines(), 4);
+
+    const sasm::line_index empty(nullptr, 0);
+    EXPECT_EQ(empty.locate(0), sasm::line_column_t({ 1, 1 }));
+    EXPECT_EQ(empty.lines(), 1);
+}
+
+// Line feeds at every position of the vectorized blocks and the tail
+TEST_F(TestLineIndex, Scan) {
+    std::mt19937 random(7);
+    std::string content(1000, 'x');
+    for (auto& c : content) {
+        if (random() % 5 == 0) c = '\n';
+    }
+    std::vector<size_t> starts;
+    sasm::find_line_starts(content.data(), content.size(), starts);
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < content.size(); ++i) {
+        if (content[i] == '\n') expected.push_back(i + 1);
+    }
+    EXPECT_EQ(starts, expected);
+
+    const sasm::line_index lines(content.data(), content.size());
+    std::vector<size_t> offsets;
+    for (size_t offset = 0; offset <= content.size(); offset += 7) offsets.push_back(offset);
+    const auto located = lines.locate(offsets);
+    ASSERT_EQ(located.size(), offsets.size());
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        EXPECT_EQ(located[i], Count(content, offsets[i]));
+        EXPECT_EQ(lines.locate(offsets[i]), located[i]);
+    }
+
+    // Out of order is found all the same
+    const std::vector<size_t> unordered = { 900, 10, 500 };
+    const auto found = lines.locate(unordered);
+    for (size_t i = 0; i < unordered.size(); ++i) EXPECT_EQ(found[i], Count(content, unordered[i]));
+}
+
+// The index of a file keeps it mapped, diagnostics may outlive its source
+TEST_F(TestLineIndex, File) {
+    const auto path = (std::filesystem::temp_directory_path() / "test_line_index.s").string();
+    std::ofstream(path, std::ios::binary) << "NOP\nLDX #1\n";
+    auto file = std::make_shared<sasm::mapped_file>();
+    ASSERT_TRUE(file->open(path));
+    const sasm::line_index lines(std::move(file));
+    std::filesystem::remove(path);
+    EXPECT_EQ(lines.locate(8), sasm::line_column_t({ 2, 5 }));
+    EXPECT_EQ(lines.lines(), 3);
+}
+
+TEST_F(TestLineIndex, Diagnostics) {
+    const std::string content = "NOP\nLDX #((1))\n";
+    auto lines = std::make_shared<sasm::line_index>(content.data(), content.size());
+    sasm::diagnostics_sink sink;
+    const auto main = sink.source("main.s", lines);
+    sink.report(sasm::diagnostic_code::nesting_too_deep, main, 10, 1, 1);
+    sink.report(sasm::diagnostic_code::invalid_statement, main, 4, 0, 2);
+    sink.report(sasm::diagnostic_code::line_too_long, main, 4, 1, 8);
+    const std::vector<std::string> expected = {
+        "main.s:2:7: parentheses nested deeper than 1",
+        "main.s:2:1: statement 2 is invalid",
+        "main.s:2:1: line longer than 8 bytes" };
+    EXPECT_EQ(sink.messages(), expected);
+    EXPECT_EQ(sink.message(sink.entries().front()), expected.front());
+}
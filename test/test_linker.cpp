@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+
+#include <sasm/linker.h>
+#include <sasm/parallel.h>
+
+#include <atomic>
+#include <filesystem>
+
+class TestLinker : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    std::vector<std::string> m_paths;
+
+    void TearDown() override {
+        for (const auto& path : m_paths) std::filesystem::remove(path);
+    }
+
+    std::string Object(const std::string& name, const std::string& content) {
+        sasm::reader reader(content);
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer);
+        sasm::encoder encoder(0, true);
+        for (const auto& statement : parser.statements()) {
+            EXPECT_TRUE(encoder.encode(statement)) << content;
+        }
+        encoder.finish();
+
+        const auto path = (std::filesystem::temp_directory_path() / (name + ".o")).string();
+        EXPECT_TRUE(sasm::write_object(encoder, path)) << content;
+        m_paths.push_back(path);
+        return path;
+    }
+};
+
+TEST_F(TestLinker, ParallelFor) {
+    std::vector<std::atomic<int>> counts(1000);
+    sasm::parallel_for(counts.size(), [&] (size_t i) { ++counts[i]; }, 4);
+    for (const auto& count : counts) EXPECT_EQ(count, 1);
+
+    size_t calls = 0;
+    sasm::parallel_for(0, [&] (size_t) { ++calls; });
+    EXPECT_EQ(calls, 0);
+}
+
+TEST_F(TestLinker, Link) {
+    const auto main = Object("test_linker_main", R"(
+        .import ROUTINE
+        .import TABLE
+        START: JMP ROUTINE
+        ADC TABLE + 1, X
+        LOOP: BCC LOOP
+        JMP START
+    )");
+    const auto library = Object("test_linker_library", R"(
+        .export ROUTINE
+        .export TABLE
+        .export SIZE
+        .define SIZE 2
+        ROUTINE: LDX #SIZE
+        TABLE:
+        .byte 1, 2
+    )");
+
+    sasm::linker linker(0x1000);
+    ASSERT_TRUE(linker.link({ main, library }));
+    EXPECT_TRUE(linker.errors().empty());
+    ASSERT_EQ(linker.modules().size(), 2);
+    ASSERT_EQ(linker.modules()[0]->regions.size(), 1);
+    EXPECT_EQ(linker.modules()[0]->regions[0].address, 0x1000);
+    ASSERT_EQ(linker.modules()[1]->regions.size(), 1);
+    EXPECT_EQ(linker.modules()[1]->regions[0].address, 0x100B);
+    EXPECT_EQ(linker.reclaimed(), 0);
+    EXPECT_EQ(linker.exports().size(), 3);
+    EXPECT_EQ(linker.output(), bytes_t({
+        0x4C, 0x0B, 0x10,   // JMP ROUTINE
+        0x7D, 0x0E, 0x10,   // ADC TABLE + 1, X
+        0x90, 0xFE,         // BCC LOOP
+        0x4C, 0x00, 0x10,   // JMP START
+        0xA2, 0x02,         // LDX #SIZE
+        0x01, 0x02,
+    }));
+}
+
+TEST_F(TestLinker, Errors) {
+    const auto first = Object("test_linker_first", R"(
+        .export VALUE
+        .import MISSING
+        VALUE: JMP MISSING
+    )");
+    const auto second = Object("test_linker_second", R"(
+        .export VALUE
+        VALUE: NOP
+    )");
+
+    sasm::linker linker;
+    EXPECT_FALSE(linker.link({ first, second }));
+    EXPECT_EQ(linker.errors(), std::vector<std::string>({
+        "VALUE exported by both " + first + " and " + second }));
+
+    EXPECT_FALSE(linker.link({ first }));
+    EXPECT_EQ(linker.errors(), std::vector<std::string>({
+        first + ": unresolved symbol MISSING" }));
+
+    EXPECT_FALSE(linker.link({ first + ".missing" }));
+    EXPECT_EQ(linker.errors().size(), 1);
+}
+
+TEST_F(TestLinker, OutOfRange) {
+    const auto main = Object("test_linker_range", R"(
+        .import FAR
+        LDX #FAR
+    )");
+    const auto library = Object("test_linker_far", R"(
+        .export FAR
+        .define FAR $1234
+    )");
+
+    sasm::linker linker;
+    EXPECT_FALSE(linker.link({ main, library }));
+    EXPECT_EQ(linker.errors(), std::vector<std::string>({
+        main + ": value out of range at offset 1" }));
+
+    // Overflowing the evaluation rather than the field
+    const auto overflow = Object("test_linker_overflow", R"(
+        .import FAR
+        .word FAR * $10000 * $10000
+    )");
+    sasm::linker overflowing;
+    EXPECT_FALSE(overflowing.link({ overflow, library }));
+    EXPECT_EQ(overflowing.errors().size(), 1);
+}
+
+TEST_F(TestLinker, ManyModules) {
+    // Module i exports Fi and calls the next one
+    static constexpr size_t count = 64;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < count; ++i) {
+        const auto name = "F" + std::to_string(i);
+        const auto next = "F" + std::to_string((i + 1) % count);
+        paths.push_back(Object("test_linker_" + name,
+            ".export " + name + "\n.import " + next + "\n"
+            + name + ": JMP " + next + "\n"));
+    }
+
+    sasm::linker serial(0x2000, 1);
+    ASSERT_TRUE(serial.link(paths));
+    sasm::linker parallel(0x2000, 8);
+    ASSERT_TRUE(parallel.link(paths));
+    EXPECT_EQ(serial.output(), parallel.output());
+
+    const auto& output = parallel.output();
+    ASSERT_EQ(output.size(), count * 3);
+    for (size_t i = 0; i < count; ++i) {
+        const auto next = 0x2000 + ((i + 1) % count) * 3;
+        EXPECT_EQ(output[i * 3], 0x4C);
+        EXPECT_EQ(output[i * 3 + 1], next & 0xFF);
+        EXPECT_EQ(output[i * 3 + 2], next >> 8);
+    }
+}
+
+TEST_F(TestLinker, GarbageCollection) {
+    const auto main = Object("test_linker_gc_main", R"(
+        .export MAIN
+        .export UNUSED
+        .import USED
+        MAIN: JMP USED
+        LOOP: JMP LOOP
+        UNUSED: JMP MAIN
+    )");
+    const auto library = Object("test_linker_gc_library", R"(
+        .export DEAD
+        .export USED
+        .export HELPER
+        DEAD: JMP USED
+        USED: JMP HELPER
+        HELPER: BCC USED
+        NOP
+    )");
+
+    sasm::linker linker(0x1000);
+    linker.add_entry("MAIN");
+    ASSERT_TRUE(linker.link({ main, library }));
+    EXPECT_EQ(linker.reclaimed(), 6);
+    EXPECT_EQ(linker.reclaimed_regions(), 2);
+    EXPECT_EQ(linker.output(), bytes_t({
+        0x4C, 0x06, 0x10,   // MAIN: JMP USED
+        0x4C, 0x03, 0x10,   // LOOP: JMP LOOP
+        0x4C, 0x09, 0x10,   // USED: JMP HELPER
+        0x90, 0xFB,         // HELPER: BCC USED
+        0xEA,
+    }));
+
+    // Every region is kept from the other entry
+    sasm::linker full(0x1000);
+    full.add_entry("MAIN");
+    full.add_entry("UNUSED");
+    full.add_entry("DEAD");
+    ASSERT_TRUE(full.link({ main, library }));
+    EXPECT_EQ(full.reclaimed(), 0);
+    EXPECT_EQ(full.output().size(), 18);
+
+    sasm::linker missing;
+    missing.add_entry("MISSING");
+    EXPECT_FALSE(missing.link({ main, library }));
+    EXPECT_EQ(missing.errors(), std::vector<std::string>({ "entry symbol MISSING not found" }));
+}
+
+TEST_F(TestLinker, FallThrough) {
+    // Code runs from one exported label into the next, which is kept with it
+    const auto main = Object("test_linker_fall_through", R"(
+        .export A
+        .export B
+        .export C
+        A: LDX #1
+        B: LDY #2
+        JMP A
+        .align 4
+        C: NOP
+    )");
+
+    sasm::linker linker(0x1000);
+    linker.add_entry("A");
+    ASSERT_TRUE(linker.link({ main })) << ::testing::PrintToString(linker.errors());
+    EXPECT_EQ(linker.reclaimed(), 1);
+    EXPECT_EQ(linker.output(), bytes_t({
+        0xA2, 0x01,         // A: LDX #1
+        0xA0, 0x02,         // B: LDY #2
+        0x4C, 0x00, 0x10,   // JMP A
+        0x00,               // .align 4
+    }));
+}
+
+TEST_F(TestLinker, LocalLabels) {
+    // Anonymous labels may be in another region, which is then kept
+    const auto main = Object("test_linker_local", R"(
+        .export MAIN
+        .export OTHER
+        MAIN: JMP :+
+        @loop: JMP @loop
+        OTHER: NOP
+        : BCC :-
+    )");
+
+    sasm::linker linker(0x1000);
+    linker.add_entry("MAIN");
+    ASSERT_TRUE(linker.link({ main })) << ::testing::PrintToString(linker.errors());
+    EXPECT_EQ(linker.reclaimed(), 0);
+    EXPECT_EQ(linker.output(), bytes_t({
+        0x4C, 0x07, 0x10,   // MAIN: JMP :+
+        0x4C, 0x03, 0x10,   // @loop: JMP @loop
+        0xEA,               // OTHER: NOP
+        0x90, 0xFE,         // : BCC :-
+    }));
+}
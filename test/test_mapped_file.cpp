@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <sasm/mapped_file.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+class TestMappedFile : public ::testing::Test {
+public:
+    static std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+};
+
+TEST_F(TestMappedFile, Missing) {
+    sasm::mapped_file file;
+    EXPECT_FALSE(file.open("/this/file/does/not/exist"));
+    EXPECT_FALSE(file.is_open());
+    EXPECT_EQ(file.size(), 0);
+}
+
+TEST_F(TestMappedFile, Empty) {
+    const auto path = Write("sasm_test_mapped_empty.bin", "");
+    sasm::mapped_file file;
+    EXPECT_TRUE(file.open(path));
+    EXPECT_TRUE(file.is_open());
+    EXPECT_EQ(file.size(), 0);
+    std::remove(path.c_str());
+}
+
+TEST_F(TestMappedFile, Content) {
+    const auto path = Write("sasm_test_mapped_content.bin", "content");
+    sasm::mapped_file file;
+    ASSERT_TRUE(file.open(path));
+    ASSERT_EQ(file.size(), 7);
+    EXPECT_EQ(std::string(file.data(), file.data() + file.size()), "content");
+
+    sasm::mapped_file moved(std::move(file));
+    EXPECT_FALSE(file.is_open());
+    EXPECT_EQ(moved.bytes().size(), 7);
+    EXPECT_EQ(moved.bytes()[0], 'c');
+    std::remove(path.c_str());
+}
+
+// The mapping outlives the descriptor unless it is asked for
+TEST_F(TestMappedFile, Descriptor) {
+    const auto path = Write("sasm_test_mapped_descriptor.bin", "content");
+    sasm::mapped_file file;
+    ASSERT_TRUE(file.open(path));
+    EXPECT_EQ(file.descriptor(), -1);
+    EXPECT_EQ(std::string(file.data(), file.data() + file.size()), "content");
+
+    sasm::mapped_file kept;
+    ASSERT_TRUE(kept.open(path, true));
+    EXPECT_GE(kept.descriptor(), 0);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <sasm/object.h>
+
+#include <filesystem>
+
+class TestObject : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    struct test_object {
+        sasm::reader m_reader;
+        sasm::lexer m_lexer;
+        sasm::parser m_parser;
+        sasm::encoder m_encoder;
+        bytes_t m_content;
+        sasm::object_view m_view;
+
+        explicit test_object(const std::string& content)
+        : m_reader(content)
+        , m_lexer(&m_reader)
+        , m_parser(&m_lexer)
+        , m_encoder(0x8000, true)
+        {
+            for (const auto& statement : m_parser.statements()) {
+                EXPECT_TRUE(m_encoder.encode(statement)) << content;
+            }
+            m_encoder.finish();
+        }
+
+        bool write() {
+            return sasm::write_object(m_encoder, m_content)
+                && m_view.open(m_content);
+        }
+    };
+};
+
+TEST_F(TestObject, Empty) {
+    test_object object("");
+    ASSERT_TRUE(object.write());
+    EXPECT_EQ(object.m_content.size() % sasm::object_format::data_alignment, 0);
+    ASSERT_EQ(object.m_view.sections().size(), 1);
+    EXPECT_EQ(object.m_view.string(object.m_view.sections()[0].name), "code");
+    EXPECT_TRUE(object.m_view.data(object.m_view.sections()[0]).empty());
+    EXPECT_TRUE(object.m_view.symbols().empty());
+    EXPECT_TRUE(object.m_view.imports().empty());
+    EXPECT_TRUE(object.m_view.relocations().empty());
+}
+
+TEST_F(TestObject, Symbols) {
+    test_object object(R"(
+        .export START
+        .define VALUE 3
+        .define NEXT START + 2
+        ZETA: NOP
+        START: NOP
+        LOOP: BCC LOOP
+    )");
+    ASSERT_TRUE(object.write());
+    const auto& view = object.m_view;
+
+    const auto symbols = view.symbols();
+    ASSERT_EQ(symbols.size(), 5);
+    for (size_t i = 1; i < symbols.size(); ++i) {
+        EXPECT_LT(view.string(symbols[i - 1].name), view.string(symbols[i].name));
+    }
+
+    const auto* start = view.find_symbol("START");
+    ASSERT_NE(start, nullptr);
+    EXPECT_EQ(start->kind, sasm::object_format::symbol::label);
+    EXPECT_EQ(start->section, 0);
+    EXPECT_EQ(start->value, 1);
+    EXPECT_TRUE(start->is_exported());
+
+    const auto* value = view.find_symbol("VALUE");
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(value->kind, sasm::object_format::symbol::constant);
+    EXPECT_EQ(value->section, sasm::object_format::absolute_section);
+    EXPECT_EQ(value->value, 3);
+    EXPECT_FALSE(value->is_exported());
+
+    const auto* next = view.find_symbol("NEXT");
+    ASSERT_NE(next, nullptr);
+    EXPECT_EQ(next->kind, sasm::object_format::symbol::label);
+    EXPECT_EQ(next->value, 3);
+
+    EXPECT_NE(view.find_symbol("ZETA"), nullptr);
+    EXPECT_EQ(view.find_symbol("MISSING"), nullptr);
+
+    // Relative branches are left to the linker
+    const auto data = view.data(view.sections()[0]);
+    EXPECT_EQ(bytes_t(data.begin(), data.end()), bytes_t({ 0xEA, 0xEA, 0x90, 0x00 }));
+    ASSERT_EQ(view.relocations().size(), 1);
+    EXPECT_EQ(view.relocations()[0].field, sasm::fixup_t::relative8);
+    EXPECT_EQ(view.relocations()[0].offset, 3);
+}
+
+// Defines depending on labels are symbols only when they are a label plus a
+// constant, or a difference of labels
+TEST_F(TestObject, LabelDefines) {
+    test_object object(R"(
+        .export SIZE
+        .define SIZE END - START
+        .define AFTER 2 + START - 1
+        .define DOUBLE START * 2
+        START: NOP
+        NOP
+        END:
+        .word DOUBLE
+    )");
+    ASSERT_TRUE(object.write());
+    const auto& view = object.m_view;
+
+    const auto* size = view.find_symbol("SIZE");
+    ASSERT_NE(size, nullptr);
+    EXPECT_EQ(size->kind, sasm::object_format::symbol::constant);
+    EXPECT_EQ(size->section, sasm::object_format::absolute_section);
+    EXPECT_EQ(size->value, 2);
+
+    const auto* after = view.find_symbol("AFTER");
+    ASSERT_NE(after, nullptr);
+    EXPECT_EQ(after->kind, sasm::object_format::symbol::label);
+    EXPECT_EQ(after->value, 1);
+
+    EXPECT_EQ(view.find_symbol("DOUBLE"), nullptr);
+    ASSERT_EQ(view.relocations().size(), 1);
+
+    test_object exported(".export DOUBLE\n.define DOUBLE START * 2\nSTART: NOP\n");
+    EXPECT_FALSE(exported.write());
+}
+
+TEST_F(TestObject, Relocations) {
+    test_object object(R"(
+        .import OUTSIDE
+        .define OFFSET 4
+        START: JMP START
+        ADC OUTSIDE + OFFSET, X
+        LDX #UNDECLARED
+    )");
+    ASSERT_TRUE(object.write());
+    const auto& view = object.m_view;
+
+    const auto imports = view.imports();
+    ASSERT_EQ(imports.size(), 2);
+    EXPECT_EQ(view.string(imports[0].name), "OUTSIDE");
+    EXPECT_EQ(view.string(imports[1].name), "UNDECLARED");
+
+    const auto relocations = view.relocations();
+    ASSERT_EQ(relocations.size(), 3);
+    EXPECT_EQ(relocations[0].offset, 1);
+    EXPECT_EQ(relocations[0].field, sasm::fixup_t::u16);
+    EXPECT_EQ(relocations[1].offset, 4);
+    EXPECT_EQ(relocations[1].field, sasm::fixup_t::u16);
+    EXPECT_EQ(relocations[2].offset, 7);
+    EXPECT_EQ(relocations[2].field, sasm::fixup_t::u8);
+
+    const auto symbol = [&] (uint32_t index, sasm::value_t& value) {
+        if (index >= view.symbols().size()) return false;
+        const auto& entry = view.symbols()[index];
+        value = entry.value;
+        if (entry.kind == sasm::object_format::symbol::label) value += 0x1000;
+        return true;
+    };
+    const auto import = [&] (uint32_t index, sasm::value_t& value) {
+        value = 0x2000 + static_cast<sasm::value_t>(index);
+        return true;
+    };
+    sasm::value_t value;
+    ASSERT_TRUE(sasm::evaluate(view.expression(relocations[0]), symbol, import, value));
+    EXPECT_EQ(value, 0x1000);
+    ASSERT_TRUE(sasm::evaluate(view.expression(relocations[1]), symbol, import, value));
+    EXPECT_EQ(value, 0x2004);
+    ASSERT_TRUE(sasm::evaluate(view.expression(relocations[2]), symbol, import, value));
+    EXPECT_EQ(value, 0x2001);
+}
+
+TEST_F(TestObject, MissingExport) {
+    test_object object(R"(
+        .export MISSING
+        NOP
+    )");
+    EXPECT_FALSE(object.write());
+}
+
+TEST_F(TestObject, Invalid) {
+    test_object object("START: JMP START");
+    ASSERT_TRUE(object.write());
+    auto content = object.m_content;
+
+    sasm::object_view view;
+    EXPECT_FALSE(view.open({}));
+    EXPECT_FALSE(view.open(std::span(content).first(content.size() - 1)));
+
+    auto corrupt = [&] (size_t offset, uint8_t byte) {
+        auto copy = content;
+        copy[offset] = byte;
+        return view.open(copy);
+    };
+    EXPECT_FALSE(corrupt(0, 'X'));
+    EXPECT_FALSE(corrupt(offsetof(sasm::object_format::header, version), 2));
+    EXPECT_FALSE(corrupt(offsetof(sasm::object_format::header, symbol_offset), 0xFF));
+    EXPECT_FALSE(corrupt(object.m_view.header().relocation_offset
+                         + offsetof(sasm::object_format::relocation, expression_count), 0xFF));
+}
+
+TEST_F(TestObject, File) {
+    test_object object("START: JMP START");
+    const auto path = (std::filesystem::temp_directory_path() / "test_object.o").string();
+    ASSERT_TRUE(sasm::write_object(object.m_encoder, path));
+
+    sasm::object_file file;
+    ASSERT_TRUE(file.open(path));
+    const auto& view = file.view();
+    EXPECT_NE(view.find_symbol("START"), nullptr);
+    ASSERT_EQ(view.relocations().size(), 1);
+    const auto data = view.data(view.sections()[0]);
+    EXPECT_EQ(bytes_t(data.begin(), data.end()), bytes_t({ 0x4C, 0x00, 0x00 }));
+    std::filesystem::remove(path);
+}
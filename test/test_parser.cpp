@@ -2,16 +2,22 @@
 
 #include <sasm/parser.h>
 
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
 class TestParser : public ::testing::Test {
 public:
     struct test_parser {
         sasm::reader m_reader;
         sasm::lexer m_lexer;
         sasm::parser m_parser;
-        explicit test_parser(const std::string& content)
+        explicit test_parser(const std::string& content,
+                             sasm::source_manager* sources = nullptr,
+                             const sasm::parse_limits_t& limits = {})
         : m_reader(content)
         , m_lexer(&m_reader)
-        , m_parser(&m_lexer)
+        , m_parser(&m_lexer, sources, limits)
         {}
 
         auto get() { return m_parser.get(); }
@@ -21,6 +27,13 @@ public:
     static constexpr auto SBYTE = sasm::dtype::i8;
     static constexpr auto WORD = sasm::dtype::u16;
     
+    static std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+
     static void CheckValue(const sasm::operand_t& actual,
                            int expected,
                            sasm::dtype::etype type = sasm::dtype::any) {
@@ -415,6 +428,15 @@ TEST_F(TestParser, ParseLiteral) {
     EXPECT_EQ(sasm::parse_literal("10"), 10);
     EXPECT_EQ(sasm::parse_literal("$10"), 0x10);
     EXPECT_EQ(sasm::parse_literal("%10"), 0b10);
+    // Found by fuzzing, the prefix alone threw
+    EXPECT_EQ(sasm::parse_literal("$"), 0);
+    EXPECT_EQ(sasm::parse_literal("%"), 0);
+}
+
+TEST_F(TestParser, ParseString) {
+    EXPECT_EQ(sasm::parse_string(R"("")"), "");
+    EXPECT_EQ(sasm::parse_string(R"("file.bin")"), "file.bin");
+    EXPECT_EQ(sasm::parse_string(R"("a\"b\\c")"), "a\"b\\c");
 }
 
 TEST_F(TestParser, ParseSign) {
@@ -485,14 +507,42 @@ TEST_F(TestParser, ParseByte) {
         .byte $80, $A0
     )");
     
-    const auto check = [this] (const sasm::parser_token& token, int expected) {
-        EXPECT_EQ(token.kind, sasm::parser_token::data);
-        CheckValue(token.operand, expected, BYTE);
+    const auto check = [] (const sasm::parser_token& token,
+                           const std::vector<uint8_t>& expected) {
+        EXPECT_EQ(token.kind, sasm::parser_token::data_block);
+        EXPECT_EQ(std::get<std::vector<uint8_t>>(token.block()), expected);
     };
 
-    check(parser.get(), 0x20);
-    check(parser.get(), 0x80);
-    check(parser.get(), 0xA0);
+    check(parser.get(), { 0x20 });
+    check(parser.get(), { 0x80, 0xA0 });
+
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseByteExpressions) {
+    test_parser parser(R"(
+        .byte 1, 2, REF, 3, -4, 5
+    )");
+
+    auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint8_t>>(item.block()), std::vector<uint8_t>({ 1, 2 }));
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data);
+    CheckReference(item.operand, "REF", BYTE);
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint8_t>>(item.block()), std::vector<uint8_t>({ 3 }));
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data);
+    CheckExpression(item.operand, BYTE);
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint8_t>>(item.block()), std::vector<uint8_t>({ 5 }));
 
     EXPECT_TRUE(parser.get().eof());
 }
@@ -503,15 +553,91 @@ TEST_F(TestParser, ParseWord) {
         .word $80, $A0
     )");
     
-    const auto check = [this] (const sasm::parser_token& token, int expected) {
-        EXPECT_EQ(token.kind, sasm::parser_token::data);
-        CheckValue(token.operand, expected, WORD);
+    const auto check = [] (const sasm::parser_token& token,
+                           const std::vector<uint16_t>& expected) {
+        EXPECT_EQ(token.kind, sasm::parser_token::data_block);
+        EXPECT_EQ(std::get<std::vector<uint16_t>>(token.block()), expected);
     };
 
-    check(parser.get(), 0x20);
-    check(parser.get(), 0x80);
-    check(parser.get(), 0xA0);
+    check(parser.get(), { 0x20 });
+    check(parser.get(), { 0x80, 0xA0 });
+
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseWordExpressions) {
+    test_parser parser(R"(
+        .word 1, 2, REF, 3, -4, 5
+    )");
+
+    auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint16_t>>(item.block()), std::vector<uint16_t>({ 1, 2 }));
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data);
+    CheckReference(item.operand, "REF", WORD);
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint16_t>>(item.block()), std::vector<uint16_t>({ 3 }));
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data);
+    CheckExpression(item.operand, WORD);
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint16_t>>(item.block()), std::vector<uint16_t>({ 5 }));
+
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseDataOutOfRange) {
+    test_parser parser(".byte $100");
+
+    const auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data);
+    CheckValue(item.operand, 0x100, BYTE);
+
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseIncbin) {
+    test_parser parser(R"(
+        .incbin "file.bin"
+        .incbin "file.bin", $10
+        .incbin "file.bin", OFFSET, 4
+    )");
+
+    auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::binary_include);
+    EXPECT_EQ(item.content, "file.bin");
+    EXPECT_TRUE(item.arguments().empty());
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::binary_include);
+    ASSERT_EQ(item.arguments().size(), 1);
+    CheckValue(item.arguments()[0], 0x10);
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::binary_include);
+    ASSERT_EQ(item.arguments().size(), 2);
+    CheckReference(item.arguments()[0], "OFFSET");
+    CheckValue(item.arguments()[1], 4);
+
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseIncbinInvalid) {
+    test_parser parser(R"(
+        .incbin file.bin
+        .incbin "file.bin", 1, 2, 3
+    )");
 
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::binary_include);
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
     EXPECT_TRUE(parser.get().eof());
 }
 
@@ -558,3 +684,496 @@ TEST_F(TestParser, ParseExpression) {
 
     // EXPECT_TRUE(parser.get().eof());
 }
+
+TEST_F(TestParser, Statements) {
+    test_parser parser(R"(
+        label: NOP
+        .byte $10, $20
+        <>
+    )");
+
+    std::vector<sasm::parser_token::statement_kind> kinds;
+    for (const auto& statement : parser.m_parser.statements()) {
+        kinds.push_back(statement.kind);
+    }
+    const std::vector<sasm::parser_token::statement_kind> expected {
+        sasm::parser_token::label,
+        sasm::parser_token::instruction,
+        sasm::parser_token::data_block,
+        sasm::parser_token::unknown,
+    };
+    EXPECT_EQ(kinds, expected);
+
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, StatementsPipeline) {
+    test_parser parser(R"(
+        first: NOP
+        second: ROL
+        third:
+    )");
+
+    const auto labels = [] (sasm::generator<sasm::parser_token> statements)
+        -> sasm::generator<std::string> {
+        for (const auto& statement : statements) {
+            if (statement.kind == sasm::parser_token::label) {
+                co_yield std::string(statement.content);
+            }
+        }
+    };
+
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size(),
+                                                 std::pmr::null_memory_resource());
+    std::vector<std::string> names;
+    for (auto& name : labels(parser.m_parser.statements(&resource))) {
+        names.push_back(name);
+    }
+    EXPECT_EQ(names, std::vector<std::string>({ "first", "second", "third" }));
+}
+
+TEST_F(TestParser, ParseInclude) {
+    const auto inner = Write("sasm_test_parser_inner.inc", "inner:");
+    const auto outer = Write("sasm_test_parser_outer.inc",
+                             ".define A 1\n.include \"" + inner + "\"\nNOP\n");
+    sasm::source_manager sources;
+    test_parser parser(R"(
+        first:
+        .include ")" + outer + R"("
+        last:
+    )", &sources);
+
+    auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::label);
+    EXPECT_EQ(item.content, "first");
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::define);
+    EXPECT_EQ(item.content, "A");
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::label);
+    EXPECT_EQ(item.content, "inner");
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::instruction);
+
+    item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::label);
+    EXPECT_EQ(item.content, "last");
+
+    EXPECT_TRUE(parser.get().eof());
+
+    EXPECT_EQ(parser.m_parser.m_includes,
+              std::vector<std::string>({ outer, inner }));
+    std::remove(inner.c_str());
+    std::remove(outer.c_str());
+}
+
+TEST_F(TestParser, ParseIncludeOnce) {
+    const auto header = Write("sasm_test_parser_header.inc", ".define A 1\n");
+    sasm::source_manager sources;
+    for (int i = 0; i < 10; ++i) {
+        test_parser parser(".include \"" + header + "\"\nNOP", &sources);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::define);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::instruction);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    EXPECT_EQ(sources.lex_count(), 1);
+    std::remove(header.c_str());
+}
+
+TEST_F(TestParser, ParseIncludeFailure) {
+    const auto cycle = Write("sasm_test_parser_cycle.inc", "");
+    Write("sasm_test_parser_cycle.inc", ".include \"" + cycle + "\"\n");
+
+    sasm::source_manager sources;
+    {
+        test_parser parser(".include \"/this/file/does/not/exist\"", &sources);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    {
+        test_parser parser(".include \"" + cycle + "\"", &sources);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+        EXPECT_EQ(parser.m_parser.m_includes.size(),
+                  sasm::parser::max_include_depth);
+    }
+    {
+        // Without source manager
+        test_parser parser(".include \"" + cycle + "\"");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    std::remove(cycle.c_str());
+}
+
+TEST_F(TestParser, ParseMacro) {
+    test_parser parser(R"(
+        .macro LOAD value, address
+        LDX #value
+        LDY address, X
+        .endmacro
+        LOAD 1, $1234
+        LOAD (2 + 3), TABLE + 1
+        NOP
+    )");
+
+    auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::instruction);
+    EXPECT_EQ(item.instr.name, sasm::instruction_set::instruction_name::LDX);
+    CheckValue(item.instr.operand, 1, BYTE);
+
+    item = parser.get();
+    EXPECT_EQ(item.instr.name, sasm::instruction_set::instruction_name::LDY);
+    EXPECT_EQ(item.instr.style, sasm::instruction_set::addressing_style::direct_x);
+    CheckValue(item.instr.operand, 0x1234, WORD);
+
+    item = parser.get();
+    EXPECT_EQ(item.instr.name, sasm::instruction_set::instruction_name::LDX);
+    CheckExpression(item.instr.operand, BYTE);
+
+    item = parser.get();
+    EXPECT_EQ(item.instr.name, sasm::instruction_set::instruction_name::LDY);
+    CheckExpression(item.instr.operand);
+
+    item = parser.get();
+    EXPECT_EQ(item.instr.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseMacroNested) {
+    test_parser parser(R"(
+        .macro INNER
+        NOP
+        .endmacro
+        .macro OUTER count
+        .byte count
+        INNER
+        .endmacro
+        OUTER 7
+    )");
+
+    auto item = parser.get();
+    EXPECT_EQ(item.kind, sasm::parser_token::data_block);
+    EXPECT_EQ(std::get<std::vector<uint8_t>>(item.block()), std::vector<uint8_t>({ 7 }));
+    EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseMacroInvalid) {
+    {
+        // Wrong argument count
+        test_parser parser(".macro ONE a\nNOP\n.endmacro\nONE\nONE 1, 2\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    {
+        // Unterminated
+        test_parser parser(".macro ONE\nNOP\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    {
+        // Recursive
+        test_parser parser(".macro SELF\nSELF\n.endmacro\nSELF\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+}
+
+TEST_F(TestParser, ParseRepeat) {
+    test_parser parser(R"(
+        .define COUNT 2
+        .repeat COUNT, i
+        .repeat 3, j
+        .byte i * 10 + j
+        .endrepeat
+        .endrepeat
+        .rept 2
+        NOP
+        .endr
+        .repeat COUNT - 2
+        NOP
+        .endrepeat
+    )");
+
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::define);
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            const auto item = parser.get();
+            ASSERT_EQ(item.kind, sasm::parser_token::data);
+            CheckValue(item.operand, i * 10 + j, BYTE);
+        }
+    }
+    EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseRepeatBinding) {
+    // References other than the variable are left to the encoder
+    test_parser parser(".repeat 2, i\nLDX TABLE + i\n.endrepeat\nLDX i\n");
+
+    auto item = parser.get();
+    ASSERT_TRUE(item.instr.operand.is_expression());
+    EXPECT_EQ(item.instr.operand.content[0].ref, "TABLE");
+    EXPECT_EQ(item.instr.operand.content[1].val, 0);
+    item = parser.get();
+    EXPECT_EQ(item.instr.operand.content[1].val, 1);
+
+    // Out of the block the name is a plain reference again
+    CheckReference(parser.get().instr.operand, "i");
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseRepeatInvalid) {
+    {
+        test_parser parser(".repeat 2\nNOP\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    {
+        // Count not known to the parser
+        test_parser parser(".repeat UNKNOWN\nNOP\n.endrepeat\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+}
+
+TEST_F(TestParser, ParseConditional) {
+    test_parser parser(R"(
+        .define TARGET 2
+        .ifdef TARGET
+        .byte 1
+        .else
+        .byte 2
+        .endif
+        .ifndef TARGET
+        .byte 3
+        .else
+        .byte 4
+        .endif
+        .if TARGET - 2
+        .byte 5
+        .endif
+        .if TARGET
+        .if TARGET - 1
+        .byte 6
+        .endif
+        .endif
+    )");
+
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::define);
+    for (const auto value : { 1, 4, 6 }) {
+        const auto item = parser.get();
+        ASSERT_EQ(item.kind, sasm::parser_token::data_block);
+        EXPECT_EQ(std::get<std::vector<uint8_t>>(item.block()), std::vector<uint8_t>({ uint8_t(value) }));
+    }
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseConditionalSkipped) {
+    // Inactive lines are not lexed, invalid content there is not an error
+    const std::string inactive = R"(
+        .ifdef OTHER_TARGET
+        "unterminated @@@
+        .if 1
+        .byte 1
+        .else
+        .byte 2
+        .endif
+        .macro NOT_DEFINED
+        .else
+        NOP
+        .endif
+    )";
+    {
+        test_parser parser(inactive);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    {
+        // Replayed tokens are skipped as well
+        const auto header = Write("sasm_test_parser_conditional.inc", inactive);
+        sasm::source_manager sources;
+        test_parser parser(".include \"" + header + "\"\nLDX #1\n", &sources);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::LDX);
+        EXPECT_TRUE(parser.get().eof());
+        std::remove(header.c_str());
+    }
+}
+
+TEST_F(TestParser, ParseConditionalRepeat) {
+    test_parser parser(".repeat 3, i\n.if i - 1\n.byte i\n.endif\n.endrepeat\n");
+    CheckValue(parser.get().operand, 0, BYTE);
+    CheckValue(parser.get().operand, 2, BYTE);
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseConditionalInvalid) {
+    {
+        test_parser parser(".endif\n.else\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+    {
+        // Unterminated, active or not
+        for (const auto* content : { ".ifdef A\nNOP\n", ".ifndef A\n", ".ifdef A\n.else\n" }) {
+            test_parser parser(content);
+            while (!parser.get().eof()) {}
+            const auto& entries = parser.m_parser.diagnostics().entries();
+            ASSERT_EQ(entries.size(), 1) << content;
+            EXPECT_EQ(entries[0].code, sasm::diagnostic_code::unterminated_conditional) << content;
+            EXPECT_EQ(entries[0].offset, 0) << content;
+        }
+    }
+    {
+        // A second .else, taken or skipped
+        for (const auto* content : { ".ifdef A\n.else\nNOP\n.else\nNOP\n.endif\n",
+                                     ".ifndef A\nNOP\n.else\n.else\nNOP\n.endif\n" }) {
+            test_parser parser(content);
+            EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP) << content;
+            EXPECT_TRUE(parser.get().eof()) << content;
+            const auto& entries = parser.m_parser.diagnostics().entries();
+            ASSERT_EQ(entries.size(), 1) << content;
+            EXPECT_EQ(entries[0].code, sasm::diagnostic_code::duplicate_else) << content;
+        }
+    }
+    {
+        // Not computable while parsing
+        test_parser parser(".if LABEL\nNOP\n.endif\n");
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+    }
+}
+
+// A block is closed in the file or expansion it was opened in
+TEST_F(TestParser, ParseConditionalScope) {
+    sasm::source_manager sources;
+    {
+        // Skipped up to the end of the include, not into the includer
+        const auto header = Write("sasm_test_parser_unterminated.inc", "NOP\n.ifdef A\nNOP\n");
+        test_parser parser(".include \"" + header + "\"\nLDX #1\n.endif\n", &sources);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::LDX);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+        const auto& entries = parser.m_parser.diagnostics().entries();
+        ASSERT_EQ(entries.size(), 1);
+        EXPECT_EQ(entries[0].code, sasm::diagnostic_code::unterminated_conditional);
+        EXPECT_EQ(parser.m_parser.diagnostics().message(entries[0]),
+                  header + ":2:1: conditional block not closed by .endif");
+        std::remove(header.c_str());
+    }
+    {
+        // Active up to the end of the include
+        const auto header = Write("sasm_test_parser_unterminated_active.inc", ".ifndef A\nNOP\n");
+        test_parser parser(".include \"" + header + "\"\nLDX #1\n.endif\n", &sources);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::LDX);
+        EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+        EXPECT_TRUE(parser.get().eof());
+        const auto& entries = parser.m_parser.diagnostics().entries();
+        ASSERT_EQ(entries.size(), 1);
+        EXPECT_EQ(entries[0].code, sasm::diagnostic_code::unterminated_conditional);
+        std::remove(header.c_str());
+    }
+    {
+        // Nor from one iteration of a repeat into the next
+        test_parser parser(".repeat 2\n.ifdef A\n.endrepeat\nNOP\n");
+        EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+        EXPECT_TRUE(parser.get().eof());
+        EXPECT_EQ(parser.m_parser.diagnostics().entries().size(), 2);
+    }
+}
+
+TEST_F(TestParser, ParseLocalLabel) {
+    test_parser parser("@start:\nFIRST:\n@loop: BCC @loop\nBCC @next\n@next:\nSECOND:\n@next:\n");
+
+    auto item = parser.get();
+    ASSERT_EQ(item.kind, sasm::parser_token::local_label);
+    EXPECT_EQ(item.operand.content[0].scope, 0);
+    EXPECT_EQ(item.operand.content[0].val, 0);
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::label);
+
+    // Slots are given in order of appearance, references included
+    item = parser.get();
+    ASSERT_EQ(item.kind, sasm::parser_token::local_label);
+    EXPECT_EQ(item.content, "@loop");
+    EXPECT_EQ(item.operand.content[0].scope, 1);
+    EXPECT_EQ(item.operand.content[0].val, 0);
+    item = parser.get();
+    ASSERT_TRUE(item.instr.operand.content[0].is<sasm::expression_item_t::local_label>());
+    EXPECT_EQ(item.instr.operand.content[0].val, 0);
+    item = parser.get();
+    EXPECT_EQ(item.instr.operand.content[0].val, 1);
+    item = parser.get();
+    EXPECT_EQ(item.operand.content[0].val, 1);
+
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::label);
+    item = parser.get();
+    EXPECT_EQ(item.operand.content[0].scope, 2);
+    EXPECT_EQ(item.operand.content[0].val, 0);
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, ParseAnonymousLabel) {
+    test_parser parser(":\nBCC :-\nJMP :++ + 1\n: NOP\n:\n");
+
+    auto item = parser.get();
+    ASSERT_EQ(item.kind, sasm::parser_token::anonymous_label);
+    EXPECT_EQ(item.operand.content[0].val, 0);
+
+    item = parser.get();
+    ASSERT_TRUE(item.instr.operand.content[0].is<sasm::expression_item_t::anonymous_label>());
+    EXPECT_EQ(item.instr.operand.content[0].val, 0);
+
+    // The second one ahead, then a sign after a blank is an operation
+    item = parser.get();
+    ASSERT_EQ(item.instr.operand.content.size(), 3);
+    EXPECT_EQ(item.instr.operand.content[0].val, 2);
+
+    item = parser.get();
+    EXPECT_EQ(item.operand.content[0].val, 1);
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::instruction);
+    item = parser.get();
+    EXPECT_EQ(item.operand.content[0].val, 2);
+    EXPECT_TRUE(parser.get().eof());
+}
+
+TEST_F(TestParser, NestingLimit) {
+    test_parser parser("LDX #((((1))))\nLDX #(((((1)))))\nNOP\n", nullptr, { 4, 0 });
+    auto statement = parser.get();
+    ASSERT_EQ(statement.kind, sasm::parser_token::instruction);
+    CheckValue(statement.instr.operand, 1, BYTE);
+    // With no operand, the rest of the line is invalid
+    EXPECT_EQ(parser.get().instr.style, sasm::instruction_set::addressing_style::no_op);
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+    EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_TRUE(parser.get().eof());
+    // Reported once, however many instruction patterns tried the line
+    EXPECT_EQ(parser.m_parser.diagnostics().messages(), std::vector<std::string>({
+        "offset 24: parentheses nested deeper than 4" }));
+}
+
+TEST_F(TestParser, LineLengthLimit) {
+    test_parser parser(".byte 1,2,3,4,5,6,7,8,9\nNOP\n", nullptr, { 0, 16 });
+    // The values before the limit are parsed, the rest of the line is not
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::data_block);
+    EXPECT_EQ(parser.get().kind, sasm::parser_token::unknown);
+    EXPECT_EQ(parser.get().instr.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_TRUE(parser.get().eof());
+    EXPECT_EQ(parser.m_parser.diagnostics().messages(), std::vector<std::string>({
+        "offset 16: line longer than 16 bytes" }));
+
+    test_parser unlimited(".byte 1,2,3,4,5,6,7,8,9\n", nullptr, { 0, 0 });
+    EXPECT_EQ(unlimited.get().kind, sasm::parser_token::data_block);
+    EXPECT_TRUE(unlimited.get().eof());
+    EXPECT_TRUE(unlimited.m_parser.diagnostics().empty());
+}
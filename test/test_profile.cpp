@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <sasm/parser.h>
+
+class TestProfile : public ::testing::Test {
+public:
+    static sasm::parse_profile Parse(const std::string& source) {
+        sasm::thread_profile().clear();
+        sasm::reader reader(source);
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer);
+        for (auto statement = parser.get(); !statement.eof(); statement = parser.get()) {}
+        return sasm::thread_profile();
+    }
+};
+
+TEST_F(TestProfile, Report) {
+    sasm::parse_profile profile;
+    profile.record(sasm::parse_rule::define, false, 2, 1000);
+    profile.record(sasm::parse_rule::instruction, true, 3, 5000);
+    profile.restaged(nullptr, 12);
+    profile.restaged(nullptr, 12);
+    profile.restaged(nullptr, 30);
+
+    const auto& define = profile.rule(sasm::parse_rule::define);
+    EXPECT_EQ(define.attempts, 1);
+    EXPECT_EQ(define.successes, 0);
+    EXPECT_EQ(define.wasted_tokens, 2);
+    EXPECT_EQ(profile.rule(sasm::parse_rule::instruction).wasted_tokens, 0);
+
+    const auto lines = profile.report(1);
+    ASSERT_EQ(lines.size(), 5);
+    EXPECT_EQ(lines[1].substr(0, 11), "instruction");
+    EXPECT_EQ(lines[2].substr(0, 6), "define");
+    EXPECT_EQ(lines[4], "        2  <input>:+12");
+}
+
+TEST_F(TestProfile, Rules) {
+    const auto profile = Parse("    LDX #$10\n    ADC $1234, X\n    NOP\n");
+    if (!sasm::profile_enabled()) {
+        EXPECT_EQ(profile.rule(sasm::parse_rule::instruction).attempts, 0);
+        return;
+    }
+    const auto& instruction = profile.rule(sasm::parse_rule::instruction);
+    EXPECT_EQ(instruction.attempts, 3);
+    EXPECT_EQ(instruction.successes, 3);
+    EXPECT_EQ(profile.rule(sasm::parse_rule::immediate).successes, 1);
+    EXPECT_EQ(profile.rule(sasm::parse_rule::direct_indexed).successes, 1);
+    EXPECT_EQ(profile.rule(sasm::parse_rule::implied).successes, 1);
+    // Every alternative before the implied one failed on NOP
+    EXPECT_EQ(profile.rule(sasm::parse_rule::relative).attempts, 3);
+    EXPECT_GT(profile.rule(sasm::parse_rule::relative).wasted_tokens, 0);
+    EXPECT_EQ(profile.rule(sasm::parse_rule::define).successes, 0);
+}
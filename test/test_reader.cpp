@@ -2,9 +2,14 @@
 
 #include <sasm/reader.h>
 
+#include <type_traits>
+
 class TestReader : public ::testing::Test {
 };
 
+// A copy would view the storage of the original
+static_assert(!std::is_copy_constructible_v<sasm::reader> && !std::is_move_constructible_v<sasm::reader>);
+
 TEST_F(TestReader, Empty) {
     sasm::reader reader("");
 
@@ -42,3 +47,13 @@ TEST_F(TestReader, SingleContent) {
 
     EXPECT_TRUE(reader.get().eof());
 }
+
+TEST_F(TestReader, FindDirectiveLine) {
+    const std::string content = "NOP\n  ; .if\n\t .if 1\nNOP\n";
+    sasm::reader reader(content);
+    EXPECT_EQ(reader.find_directive_line(0), content.find("\t .if"));
+    EXPECT_EQ(reader.find_directive_line(content.find("NOP\n", 1)), content.size());
+
+    reader.seek(content.find("\t .if"));
+    EXPECT_EQ(reader.get().value, '\t');
+}
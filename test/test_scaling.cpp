@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <sasm/encoder.h>
+#include <sasm/parser.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+// Adversarial inputs of size N then 2N, the second must not take much more
+// than twice as long: a quadratic step would take four times
+class TestScaling : public ::testing::Test {
+public:
+    using input_f = std::function<std::string(size_t)>;
+
+    // Parses and encodes the content with no limits
+    static double Seconds(const std::string& content) {
+        const auto start = std::chrono::steady_clock::now();
+        sasm::reader reader(content);
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer, nullptr, { 0, 0 });
+        sasm::encoder encoder;
+        for (auto statement = parser.get(); !statement.eof(); statement = parser.get()) {
+            encoder.encode(statement);
+        }
+        encoder.finish();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Best of a few runs, alternated so that a busy machine slows both
+    // sizes. A quadratic step fails every attempt, noise seldom twice.
+    static void CheckLinear(const input_f& input, size_t n) {
+        const auto small = input(n);
+        const auto large = input(2 * n);
+        double once = 1e30;
+        double twice = 1e30;
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            once = 1e30;
+            twice = 1e30;
+            for (int run = 0; run < 5; ++run) {
+                once = std::min(once, Seconds(small));
+                twice = std::min(twice, Seconds(large));
+            }
+            if (twice < 2.5 * once) return;
+        }
+        ADD_FAILURE() << "N " << once << "s, 2N " << twice << "s";
+    }
+
+    static std::string Repeat(const std::string& text, size_t count) {
+        std::string result;
+        result.reserve(text.size() * count);
+        for (size_t i = 0; i < count; ++i) result += text;
+        return result;
+    }
+};
+
+TEST_F(TestScaling, DeepParentheses) {
+    CheckLinear([] (size_t n) {
+        return "LDX #" + Repeat("(", n) + "1" + Repeat(")", n) + "\n";
+    }, 20000);
+}
+
+TEST_F(TestScaling, UnbalancedParentheses) {
+    CheckLinear([] (size_t n) {
+        return "JMP " + Repeat("(", n) + "\n";
+    }, 20000);
+}
+
+TEST_F(TestScaling, LongLine) {
+    CheckLinear([] (size_t n) {
+        return "LDX #1" + Repeat(" + 1 - 1", n) + "\n";
+    }, 5000);
+}
+
+TEST_F(TestScaling, LongIdentifier) {
+    CheckLinear([] (size_t n) {
+        const auto name = "L" + std::string(n, 'x');
+        return name + ":\nJMP " + name + "\n";
+    }, 500000);
+}
+
+TEST_F(TestScaling, ByteList) {
+    CheckLinear([] (size_t n) {
+        return ".byte 1" + Repeat(", 2", n) + "\n";
+    }, 20000);
+}
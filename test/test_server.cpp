@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+
+#include <sasm/server.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+class TestServer : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_server";
+        std::filesystem::remove_all(m_directory);
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+
+    bytes_t Read(const std::string& name) {
+        std::ifstream input(m_directory / name, std::ios::binary);
+        return bytes_t(std::istreambuf_iterator<char>(input), {});
+    }
+};
+
+TEST_F(TestServer, Arguments) {
+    sasm::driver_options_t options;
+    ASSERT_TRUE(sasm::parse_arguments({ "-c", "-I", "inc", "--origin", "0x100", "main.s" }, options));
+    EXPECT_EQ(options.source, "main.s");
+    EXPECT_EQ(options.output, "main.o");
+    EXPECT_EQ(options.include_paths, std::vector<std::string>({ "inc" }));
+    EXPECT_EQ(options.assemble.origin, 0x100);
+    EXPECT_TRUE(options.assemble.relocatable);
+    EXPECT_FALSE(options.stats);
+
+    sasm::make_absolute(options, "/work");
+    EXPECT_EQ(options.source, "/work/main.s");
+    EXPECT_EQ(options.include_paths, std::vector<std::string>({ "/work/inc" }));
+
+    sasm::driver_options_t watch;
+    ASSERT_TRUE(sasm::parse_arguments({ "--watch", "--trace", "t.json", "a.s", "b.s" }, watch));
+    EXPECT_EQ(watch.sources, std::vector<std::string>({ "a.s", "b.s" }));
+    EXPECT_EQ(watch.trace_path, "t.json");
+    EXPECT_EQ(watch.output, "a.bin");
+
+    sasm::driver_options_t limited;
+    ASSERT_TRUE(sasm::parse_arguments({ "--max-nesting", "8", "--max-line-length", "0", "a.s" }, limited));
+    EXPECT_EQ(limited.assemble.limits.max_nesting, 8);
+    EXPECT_EQ(limited.assemble.limits.max_line_length, 0);
+    EXPECT_NE(sasm::output_settings(limited), sasm::output_settings(options));
+
+    sasm::driver_options_t mapped;
+    ASSERT_TRUE(sasm::parse_arguments({ "--debug-map", "a.dbg", "a.s" }, mapped));
+    EXPECT_TRUE(mapped.assemble.debug_map);
+    EXPECT_EQ(mapped.debug_map_path, "a.dbg");
+
+    sasm::driver_options_t invalid;
+    EXPECT_FALSE(sasm::parse_arguments({}, invalid));
+    EXPECT_FALSE(sasm::parse_arguments({ "a.s", "b.s" }, invalid));
+    EXPECT_FALSE(sasm::parse_arguments({ "--origin", "x", "a.s" }, invalid));
+    EXPECT_FALSE(sasm::parse_arguments({ "--server", "socket", "a.s" }, invalid));
+    sasm::driver_options_t no_source;
+    EXPECT_FALSE(sasm::parse_arguments({ "--watch" }, no_source));
+    sasm::driver_options_t cached;
+    EXPECT_FALSE(sasm::parse_arguments({ "--watch", "--cache", "cache", "a.s" }, cached));
+    sasm::driver_options_t watch_stats;
+    EXPECT_FALSE(sasm::parse_arguments({ "--watch", "--stats", "a.s" }, watch_stats));
+    sasm::driver_options_t watch_map;
+    EXPECT_FALSE(sasm::parse_arguments({ "--watch", "--debug-map", "a.dbg", "a.s" }, watch_map));
+    sasm::driver_options_t server_profile;
+    EXPECT_FALSE(sasm::parse_arguments({ "--server", "socket", "--profile" }, server_profile));
+    sasm::driver_options_t server_trace;
+    EXPECT_FALSE(sasm::parse_arguments({ "--server", "socket", "--trace", "t.json" }, server_trace));
+}
+
+TEST_F(TestServer, Handle) {
+    Write("header.s", ".define VALUE 3\n");
+    Write("main.s", ".include \"header.s\"\nLDX #VALUE\n");
+
+    sasm::assembler_server server;
+    std::vector<std::string> messages;
+    const std::vector<std::string> arguments = { "-I", ".", "main.s" };
+    ASSERT_TRUE(server.handle(arguments, m_directory.string(), messages));
+    EXPECT_EQ(Read("main.bin"), bytes_t({ 0xA2, 0x03 }));
+    EXPECT_EQ(server.hits(), 0);
+
+    ASSERT_TRUE(server.handle(arguments, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 1);
+
+    // A deleted output is written again from memory
+    std::filesystem::remove(m_directory / "main.bin");
+    ASSERT_TRUE(server.handle(arguments, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 2);
+    EXPECT_EQ(Read("main.bin"), bytes_t({ 0xA2, 0x03 }));
+
+    // A changed include is reassembled
+    Write("header.s", ".define VALUE $10\n");
+    ASSERT_TRUE(server.handle(arguments, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 2);
+    EXPECT_EQ(Read("main.bin"), bytes_t({ 0xA2, 0x10 }));
+
+    EXPECT_FALSE(server.handle({ "missing.s" }, m_directory.string(), messages));
+    EXPECT_EQ(messages.size(), 1);
+}
+
+// Files named by the sources are found from the client directory, not from
+// that of the server
+TEST_F(TestServer, Directory) {
+    Write("header.s", ".define VALUE 3\n");
+    Write("data.bin", "xy");
+    Write("main.s", ".include \"header.s\"\nLDX #VALUE\n.incbin \"data.bin\"\n");
+    ASSERT_NE(std::filesystem::current_path(), m_directory);
+
+    sasm::assembler_server server;
+    std::vector<std::string> messages;
+    ASSERT_TRUE(server.handle({ "main.s" }, m_directory.string(), messages))
+        << ::testing::PrintToString(messages);
+    EXPECT_EQ(Read("main.bin"), bytes_t({ 0xA2, 0x03, 'x', 'y' }));
+
+    // A change to the binary include is seen
+    Write("data.bin", "z");
+    ASSERT_TRUE(server.handle({ "main.s" }, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 0);
+    EXPECT_EQ(Read("main.bin"), bytes_t({ 0xA2, 0x03, 'z' }));
+}
+
+// The kept output has no debug map, asking for one assembles again
+TEST_F(TestServer, DebugMap) {
+    Write("main.s", "NOP\n");
+
+    sasm::assembler_server server;
+    std::vector<std::string> messages;
+    ASSERT_TRUE(server.handle({ "main.s" }, m_directory.string(), messages));
+    ASSERT_TRUE(server.handle({ "--debug-map", "main.dbg", "main.s" }, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 0);
+    EXPECT_TRUE(std::filesystem::exists(m_directory / "main.dbg"));
+
+    std::filesystem::remove(m_directory / "main.dbg");
+    ASSERT_TRUE(server.handle({ "--debug-map", "main.dbg", "main.s" }, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 0);
+    EXPECT_TRUE(std::filesystem::exists(m_directory / "main.dbg"));
+}
+
+// Over its size, the least recently used outputs and sources are dropped
+TEST_F(TestServer, Evict) {
+    Write("a.s", "NOP\n");
+    Write("b.s", "LDX #1\n");
+
+    sasm::assembler_server server(1000);
+    std::vector<std::string> messages;
+    ASSERT_TRUE(server.handle({ "a.s" }, m_directory.string(), messages));
+    ASSERT_TRUE(server.handle({ "a.s" }, m_directory.string(), messages));
+    EXPECT_EQ(server.hits(), 1);
+    EXPECT_GT(server.size(), 0);
+
+    sasm::assembler_server small(1);
+    ASSERT_TRUE(small.handle({ "a.s" }, m_directory.string(), messages));
+    EXPECT_LE(small.size(), 1);
+    ASSERT_TRUE(small.handle({ "b.s" }, m_directory.string(), messages));
+    ASSERT_TRUE(small.handle({ "a.s" }, m_directory.string(), messages));
+    EXPECT_EQ(small.hits(), 0);
+    EXPECT_EQ(Read("a.bin"), bytes_t({ 0xEA }));
+}
+
+// A client which never sends its request does not hold the others
+TEST_F(TestServer, Stalled) {
+    Write("main.s", "NOP\n");
+    const auto socket_path = (m_directory / "socket").string();
+
+    sasm::assembler_server server(256 << 20, 100);
+    std::thread thread([&] { server.serve(socket_path); });
+    bool success = false;
+    std::vector<std::string> messages;
+    bool reached = false;
+    for (int attempt = 0; !reached && (attempt < 100); ++attempt) {
+        reached = sasm::send_request(socket_path, { "main.s" }, m_directory.string(), success, messages);
+        if (!reached) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(reached);
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    const int stalled = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(::connect(stalled, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(sasm::send_request(socket_path, { "main.s" }, m_directory.string(), success, messages));
+    EXPECT_TRUE(success);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    ::close(stalled);
+
+    EXPECT_TRUE(sasm::stop_server(socket_path));
+    thread.join();
+}
+
+TEST_F(TestServer, Socket) {
+    Write("main.s", "NOP\n");
+    const auto socket_path = (m_directory / "socket").string();
+
+    sasm::assembler_server server;
+    std::thread thread([&] { server.serve(socket_path); });
+
+    bool success = false;
+    std::vector<std::string> messages;
+    bool reached = false;
+    for (int attempt = 0; !reached && (attempt < 100); ++attempt) {
+        reached = sasm::send_request(socket_path, { "main.s" }, m_directory.string(), success, messages);
+        if (!reached) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(reached);
+    EXPECT_TRUE(success);
+    EXPECT_EQ(Read("main.bin"), bytes_t({ 0xEA }));
+
+    ASSERT_TRUE(sasm::send_request(socket_path, { "-o" }, m_directory.string(), success, messages));
+    EXPECT_FALSE(success);
+    EXPECT_EQ(messages.size(), 1);
+
+    EXPECT_TRUE(sasm::stop_server(socket_path));
+    thread.join();
+    EXPECT_FALSE(std::filesystem::exists(socket_path));
+}
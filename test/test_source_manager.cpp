@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <sasm/source_manager.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+class TestSourceManager : public ::testing::Test {
+public:
+    static std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+};
+
+TEST_F(TestSourceManager, Missing) {
+    sasm::source_manager sources;
+    EXPECT_EQ(sources.get("/this/file/does/not/exist"), nullptr);
+    EXPECT_EQ(sources.lex_count(), 0);
+}
+
+TEST_F(TestSourceManager, Tokens) {
+    const auto path = Write("sasm_test_sources_tokens.s", "label: ; comment\n  NOP");
+    sasm::source_manager sources;
+    const auto source = sources.get(path);
+    ASSERT_NE(source, nullptr);
+    EXPECT_EQ(source->size, 22);
+
+    // No trivia, ends with an end of line
+    const auto& tokens = *source->tokens;
+    ASSERT_EQ(tokens.size(), 5);
+    EXPECT_TRUE(tokens[0].is<sasm::lexer_token::identifier>("label"));
+    EXPECT_TRUE(tokens[1].is<sasm::lexer_token::symbol>(":"));
+    EXPECT_TRUE(tokens[2].is<sasm::lexer_token::end_of_line>());
+    EXPECT_TRUE(tokens[3].is<sasm::lexer_token::identifier>("NOP"));
+    EXPECT_EQ(tokens[3].offset, 19);
+    EXPECT_TRUE(tokens[4].is<sasm::lexer_token::end_of_line>());
+    std::remove(path.c_str());
+}
+
+TEST_F(TestSourceManager, Cached) {
+    const auto path = Write("sasm_test_sources_cached.s", "NOP\n");
+    sasm::source_manager sources;
+    const auto first = sources.get(path);
+    const auto second = sources.get(path);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(sources.lex_count(), 1);
+
+    Write("sasm_test_sources_cached.s", "NOP\nNOP\n");
+    const auto third = sources.get(path);
+    ASSERT_NE(third, nullptr);
+    EXPECT_NE(first, third);
+    EXPECT_EQ(third->tokens->size(), 4);
+    EXPECT_EQ(sources.lex_count(), 2);
+    std::remove(path.c_str());
+}
+
+// Lines starting with a directive, where skipped branches may end
+TEST_F(TestSourceManager, Directives) {
+    const auto path = Write("sasm_test_sources_directives.s", ".if 0\n  NOP\nA = .\n  .endif\nLDX #1\n");
+    sasm::source_manager sources;
+    const auto source = sources.get(path);
+    ASSERT_NE(source, nullptr);
+    ASSERT_NE(source->directives, nullptr);
+    const auto& tokens = *source->tokens;
+    ASSERT_EQ(source->directives->size(), 2);
+    EXPECT_EQ((*source->directives)[0], 0);
+    EXPECT_TRUE(tokens[(*source->directives)[1]].is<sasm::lexer_token::symbol>("."));
+    EXPECT_TRUE(tokens[(*source->directives)[1] + 1].is<sasm::lexer_token::identifier>("endif"));
+    std::remove(path.c_str());
+}
+
+// Threads asking for the same file wait for one lex
+TEST_F(TestSourceManager, Parallel) {
+    std::string content;
+    for (int i = 0; i < 10000; ++i) content += "    LDX #" + std::to_string(i % 256) + "\n";
+    const auto path = Write("sasm_test_sources_parallel.s", content);
+    sasm::source_manager sources;
+    std::vector<std::shared_ptr<const sasm::source_t>> loaded(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        threads.emplace_back([&, i] () { loaded[i] = sources.get(path); });
+    }
+    for (auto& thread : threads) thread.join();
+    ASSERT_NE(loaded[0], nullptr);
+    for (const auto& source : loaded) EXPECT_EQ(source, loaded[0]);
+    EXPECT_EQ(sources.lex_count(), 1);
+    EXPECT_EQ(sources.find(loaded[0]->id), loaded[0]);
+    std::remove(path.c_str());
+}
+
+TEST_F(TestSourceManager, IncludePaths) {
+    const auto path = Write("sasm_test_sources_search.s", "NOP\n");
+    sasm::source_manager sources;
+    EXPECT_EQ(sources.get("sasm_test_sources_search.s"), nullptr);
+
+    sources.add_include_path(std::filesystem::temp_directory_path().string());
+    const auto source = sources.get("sasm_test_sources_search.s");
+    ASSERT_NE(source, nullptr);
+    EXPECT_EQ(source->path, path);
+    std::remove(path.c_str());
+}
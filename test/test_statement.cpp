@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <sasm/statement.h>
+
+class TestStatement : public ::testing::Test {
+public:
+    struct test_parser {
+        sasm::reader m_reader;
+        sasm::lexer m_lexer;
+        sasm::parser m_parser;
+        sasm::statement_context m_context;
+        explicit test_parser(const std::string& content)
+        : m_reader(content)
+        , m_lexer(&m_reader)
+        , m_parser(&m_lexer)
+        {}
+
+        std::vector<sasm::statement_t> get_all() {
+            std::vector<sasm::statement_t> statements;
+            for (const auto& token : m_parser.statements()) {
+                statements.push_back(sasm::make_statement(token, m_context));
+            }
+            return statements;
+        }
+    };
+};
+
+TEST_F(TestStatement, Size) {
+    EXPECT_LE(4 * sizeof(sasm::statement_t), sizeof(sasm::parser_token));
+}
+
+TEST_F(TestStatement, NameTable) {
+    sasm::name_table names;
+    const auto a = names.intern("a");
+    const auto b = names.intern("b");
+    EXPECT_NE(a, b);
+    EXPECT_EQ(names.intern("a"), a);
+    EXPECT_EQ(names[a], "a");
+    EXPECT_EQ(names[b], "b");
+    EXPECT_EQ(names.size(), 2);
+}
+
+TEST_F(TestStatement, Kinds) {
+    test_parser parser(R"(
+        .define A $10
+        .align 4
+        .import IN
+        .export OUT
+        OUT: ADC #A
+        NOP
+        .byte 1, 2
+        .word OUT
+        <>
+    )");
+    const auto statements = parser.get_all();
+    ASSERT_EQ(statements.size(), 10);
+
+    const auto& names = parser.m_context.names;
+
+    const auto& define = std::get<sasm::statement::define>(statements[0]);
+    EXPECT_EQ(names[define.name], "A");
+    EXPECT_EQ(define.value->get_value(), 0x10);
+
+    const auto& align = std::get<sasm::statement::align>(statements[1]);
+    EXPECT_EQ(align.value->get_value(), 4);
+
+    const auto& import = std::get<sasm::statement::import_symbol>(statements[2]);
+    EXPECT_EQ(names[import.name], "IN");
+
+    const auto& exported = std::get<sasm::statement::export_symbol>(statements[3]);
+    const auto& label = std::get<sasm::statement::label>(statements[4]);
+    EXPECT_EQ(names[label.name], "OUT");
+    EXPECT_EQ(exported.name, label.name);
+
+    const auto& adc = std::get<sasm::statement::instruction>(statements[5]);
+    EXPECT_EQ(adc.name, sasm::instruction_set::instruction_name::ADC);
+    EXPECT_EQ(adc.style, sasm::instruction_set::addressing_style::immediate);
+    ASSERT_NE(adc.operand, nullptr);
+    EXPECT_EQ(adc.operand->get_reference(), "A");
+
+    const auto& nop = std::get<sasm::statement::instruction>(statements[6]);
+    EXPECT_EQ(nop.name, sasm::instruction_set::instruction_name::NOP);
+    EXPECT_EQ(nop.operand, nullptr);
+
+    const auto& block = std::get<sasm::statement::data_block>(statements[7]);
+    EXPECT_EQ(std::get<std::vector<uint8_t>>(*block.values),
+              std::vector<uint8_t>({ 1, 2 }));
+
+    const auto& data = std::get<sasm::statement::data>(statements[8]);
+    EXPECT_EQ(data.value->get_reference(), "OUT");
+    EXPECT_EQ(data.value->type, sasm::dtype::u16);
+
+    EXPECT_TRUE(std::holds_alternative<sasm::statement::unknown>(statements[9]));
+}
+
+TEST_F(TestStatement, Labels) {
+    test_parser parser(R"(
+        START:
+        @loop: BCC @loop
+        :
+        NEXT:
+        @loop:
+    )");
+    const auto statements = parser.get_all();
+    ASSERT_EQ(statements.size(), 6);
+
+    const auto& first = std::get<sasm::statement::local_label>(statements[1]);
+    const auto& second = std::get<sasm::statement::local_label>(statements[5]);
+    EXPECT_EQ(first.slot, 0);
+    EXPECT_EQ(second.slot, 0);
+    EXPECT_NE(first.scope, second.scope);
+    EXPECT_EQ(std::get<sasm::statement::anonymous_label>(statements[3]).rank, 0);
+}
+
+TEST_F(TestStatement, SharedValues) {
+    test_parser parser(R"(
+        ADC #1
+        ADC #2
+        ADC #1
+        ADC #2
+        ADC #1
+        .align 1
+    )");
+    const auto statements = parser.get_all();
+    ASSERT_EQ(statements.size(), 6);
+
+    const auto value = [&] (size_t i) -> const sasm::operand_t* {
+        if (i == 5) return std::get<sasm::statement::align>(statements[i]).value;
+        return std::get<sasm::statement::instruction>(statements[i]).operand;
+    };
+    EXPECT_EQ(value(0), value(2));
+    EXPECT_EQ(value(0), value(4));
+    EXPECT_EQ(value(1), value(3));
+    EXPECT_NE(value(0), value(1));
+    EXPECT_NE(value(0), value(5));
+    EXPECT_EQ(parser.m_context.expressions.size(), 3);
+}
+
+// The assembler keeps compact statements rather than parser tokens, their
+// payload moved into the context
+TEST_F(TestStatement, Moved) {
+    sasm::reader reader(".byte 1, 2, 3\n.word START + 1\n");
+    sasm::lexer lexer(&reader);
+    sasm::parser parser(&lexer);
+    sasm::statement_context context;
+
+    auto token = parser.get();
+    const auto bytes = std::get<std::vector<uint8_t>>(token.block()).data();
+    const auto block = std::get<sasm::statement::data_block>(sasm::make_statement(std::move(token), context));
+    EXPECT_EQ(std::get<std::vector<uint8_t>>(*block.values).data(), bytes);
+
+    token = parser.get();
+    const auto data = std::get<sasm::statement::data>(sasm::make_statement(std::move(token), context));
+    ASSERT_EQ(data.value->content.size(), 3);
+    EXPECT_EQ(data.value->content.front().ref, "START");
+    EXPECT_EQ(data.value->type, sasm::dtype::u16);
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <sasm/parser.h>
+
+class TestStats : public ::testing::Test {
+public:
+    // Counts of parsing the source on this thread
+    static sasm::stats_t Parse(const std::string& source) {
+        const auto before = sasm::thread_stats();
+        sasm::reader reader(source);
+        sasm::lexer lexer(&reader);
+        sasm::parser parser(&lexer);
+        for (auto statement = parser.get(); !statement.eof(); statement = parser.get()) {}
+        auto stats = sasm::thread_stats();
+        stats -= before;
+        return stats;
+    }
+};
+
+TEST_F(TestStats, Report) {
+    sasm::stats_t stats;
+    stats.characters = 12;
+    stats.tokens[sasm::lexer_token::identifier] = 3;
+    stats.statements[sasm::parser_token::instruction] = 2;
+    EXPECT_EQ(stats.report(), std::vector<std::string>({
+        "characters 12", "tokens.identifier 3", "statements.instruction 2" }));
+
+    auto later = stats;
+    later.characters = 20;
+    later -= stats;
+    EXPECT_EQ(later.report(), std::vector<std::string>({ "characters 8" }));
+}
+
+TEST_F(TestStats, Counters) {
+    const auto stats = Parse("start: LDX #$10  ; load\n    NOP\n");
+    if (!sasm::stats_enabled()) {
+        EXPECT_TRUE(stats.report().empty());
+        return;
+    }
+    EXPECT_EQ(stats.characters, 32);
+    EXPECT_EQ(stats.tokens[sasm::lexer_token::identifier], 3);
+    EXPECT_EQ(stats.tokens[sasm::lexer_token::comment], 1);
+    EXPECT_EQ(stats.trivia, 5);
+    EXPECT_EQ(stats.statements[sasm::parser_token::label], 1);
+    EXPECT_EQ(stats.statements[sasm::parser_token::instruction], 2);
+    EXPECT_GT(stats.scope_pushes, 0);
+    EXPECT_GT(stats.restaged, 0);
+}
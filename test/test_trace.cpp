@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <sasm/assembler.h>
+#include <sasm/trace.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <thread>
+
+class TestTrace : public ::testing::Test {
+public:
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_trace";
+        std::filesystem::remove_all(m_directory);
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        sasm::stop_trace();
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+
+    std::string Read(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(input), {});
+    }
+};
+
+TEST_F(TestTrace, Spans) {
+    { sasm::trace_span span("before"); }
+    const auto path = (m_directory / "trace.json").string();
+    ASSERT_TRUE(sasm::start_trace(path));
+    EXPECT_TRUE(sasm::tracing());
+    { sasm::trace_span span("main", "a \"quoted\" name"); }
+    std::thread thread([] { sasm::trace_span span("worker"); });
+    thread.join();
+    ASSERT_TRUE(sasm::stop_trace());
+    EXPECT_FALSE(sasm::tracing());
+
+    const auto trace = Read(path);
+    EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0);
+    EXPECT_EQ(trace.find("\"before\""), std::string::npos);
+    EXPECT_NE(trace.find("\"name\":\"main\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(trace.find("\"file\":\"a \\\"quoted\\\" name\""), std::string::npos);
+    // The worker ended before the trace was written, its events were kept
+    EXPECT_NE(trace.find("\"name\":\"worker\""), std::string::npos);
+}
+
+// Each write appends the events since the previous one
+TEST_F(TestTrace, Incremental) {
+    const auto path = (m_directory / "trace.json").string();
+    ASSERT_TRUE(sasm::start_trace(path));
+    { sasm::trace_span span("first"); }
+    ASSERT_TRUE(sasm::write_trace());
+    { sasm::trace_span span("second"); }
+    ASSERT_TRUE(sasm::write_trace());
+    ASSERT_TRUE(sasm::stop_trace());
+
+    const auto trace = Read(path);
+    const auto first = trace.find("\"name\":\"first\"");
+    ASSERT_NE(first, std::string::npos);
+    EXPECT_EQ(trace.find("\"name\":\"first\"", first + 1), std::string::npos);
+    EXPECT_NE(trace.find(",\n{\"name\":\"second\""), std::string::npos);
+    EXPECT_EQ(trace.substr(trace.size() - 27), "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+// Threads started one after the other record into the same buffer
+TEST_F(TestTrace, Threads) {
+    const auto path = (m_directory / "trace.json").string();
+    ASSERT_TRUE(sasm::start_trace(path));
+    for (int i = 0; i < 10; ++i) {
+        std::thread thread([] { sasm::trace_span span("worker"); });
+        thread.join();
+    }
+    ASSERT_TRUE(sasm::stop_trace());
+
+    const auto trace = Read(path);
+    std::set<std::string> threads;
+    size_t events = 0;
+    for (auto at = trace.find("\"name\":\"worker\""); at != std::string::npos;
+         at = trace.find("\"name\":\"worker\"", at + 1)) {
+        const auto tid = trace.find("\"tid\":", at);
+        threads.insert(trace.substr(tid, trace.find(',', tid) - tid));
+        ++events;
+    }
+    EXPECT_EQ(events, 10);
+    EXPECT_EQ(threads.size(), 1);
+}
+
+TEST_F(TestTrace, Phases) {
+    const auto source = Write("main.s", "start: LDX #$10\n    JMP start\n");
+    const auto path = (m_directory / "trace.json").string();
+    ASSERT_TRUE(sasm::start_trace(path));
+    sasm::source_manager sources;
+    sasm::assembly_t assembly;
+    ASSERT_TRUE(sasm::assemble(source, sources, {}, assembly));
+    ASSERT_TRUE(sasm::stop_trace());
+
+    const auto trace = Read(path);
+    for (const auto* phase : { "read", "lex", "assemble", "parse", "encode", "evaluate" }) {
+        EXPECT_NE(trace.find(std::string("\"name\":\"") + phase + "\""), std::string::npos) << phase;
+    }
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <sasm/watcher.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+class TestWatcher : public ::testing::Test {
+public:
+    using bytes_t = std::vector<uint8_t>;
+
+    std::filesystem::path m_directory;
+
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "test_watcher";
+        std::filesystem::remove_all(m_directory);
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string Write(const std::string& name, const std::string& content) {
+        const auto path = (m_directory / name).string();
+        std::ofstream output(path, std::ios::binary);
+        output << content;
+        return path;
+    }
+
+    bytes_t Read(const std::string& name) {
+        std::ifstream input(m_directory / name, std::ios::binary);
+        return bytes_t(std::istreambuf_iterator<char>(input), {});
+    }
+
+    sasm::driver_options_t Options() {
+        Write("values.s", ".define VALUE 3\n");
+        Write("main.s", ".include \"values.s\"\nLDX #VALUE\nJMP TABLE\n");
+        Write("table.s", ".export TABLE\nTABLE:\n.byte 1\n");
+        sasm::driver_options_t options;
+        EXPECT_TRUE(sasm::parse_arguments({ "--watch", "-I", ".", "-o", "out.bin", "main.s", "table.s" }, options));
+        sasm::make_absolute(options, m_directory.string());
+        return options;
+    }
+};
+
+TEST_F(TestWatcher, Build) {
+    sasm::watcher watcher(Options());
+    ASSERT_TRUE(watcher.build()) << ::testing::PrintToString(watcher.messages());
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 0, 1 }));
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xA2, 0x03, 0x4C, 0x05, 0x00, 0x01 }));
+}
+
+TEST_F(TestWatcher, Rebuild) {
+    sasm::watcher watcher(Options());
+    ASSERT_TRUE(watcher.build());
+
+    // Only the module including the file is assembled, then relocated
+    const auto values = Write("values.s", ".define VALUE $10\n");
+    ASSERT_TRUE(watcher.rebuild({ values })) << ::testing::PrintToString(watcher.messages());
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 0 }));
+    EXPECT_EQ(watcher.program().relocated(), 1);
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xA2, 0x10, 0x4C, 0x05, 0x00, 0x01 }));
+
+    // A module changing size moves the others, everything is relocated
+    const auto main = Write("main.s", ".include \"values.s\"\nNOP\nLDX #VALUE\nJMP TABLE\n");
+    ASSERT_TRUE(watcher.rebuild({ main }));
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 0 }));
+    EXPECT_EQ(watcher.program().relocated(), 2);
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xEA, 0xA2, 0x10, 0x4C, 0x06, 0x00, 0x01 }));
+
+    // Errors are reported, and the next change may fix them
+    Write("values.s", "");
+    EXPECT_FALSE(watcher.rebuild({ values }));
+    EXPECT_FALSE(watcher.messages().empty());
+    Write("values.s", ".define VALUE 4\n");
+    ASSERT_TRUE(watcher.rebuild({ values }));
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xEA, 0xA2, 0x04, 0x4C, 0x06, 0x00, 0x01 }));
+
+    // Files read by no module change nothing
+    ASSERT_TRUE(watcher.rebuild({ Write("other.s", "NOP\n") }));
+    EXPECT_TRUE(watcher.rebuilt().empty());
+}
+
+// A failed module is assembled again with any change, its object is stale
+TEST_F(TestWatcher, Failed) {
+    auto options = Options();
+    const auto table = Write("table.s", ".export TABLE\nTABLE:\n<>\n");
+    sasm::watcher watcher(options);
+    EXPECT_FALSE(watcher.build());
+
+    const auto values = Write("values.s", ".define VALUE 4\n");
+    EXPECT_FALSE(watcher.rebuild({ values }));
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 0, 1 }));
+    EXPECT_FALSE(watcher.messages().empty());
+
+    Write("table.s", ".export TABLE\nTABLE:\n.byte 2\n");
+    ASSERT_TRUE(watcher.rebuild({ table })) << ::testing::PrintToString(watcher.messages());
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 1 }));
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xA2, 0x04, 0x4C, 0x05, 0x00, 0x02 }));
+
+    // Once it succeeded, a change to another module leaves it alone
+    Write("values.s", ".define VALUE 5\n");
+    ASSERT_TRUE(watcher.rebuild({ values }));
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 0 }));
+
+    // Nor is the object left by a previous success linked
+    Write("table.s", ".export TABLE\nTABLE:\n<>\n");
+    EXPECT_FALSE(watcher.rebuild({ table }));
+    EXPECT_FALSE(watcher.rebuild({ values }));
+    EXPECT_EQ(watcher.rebuilt(), std::vector<size_t>({ 0, 1 }));
+}
+
+TEST_F(TestWatcher, Wait) {
+    sasm::watcher watcher(Options());
+    if (!watcher.watching()) GTEST_SKIP();
+    ASSERT_TRUE(watcher.build());
+
+    std::vector<std::string> files;
+    EXPECT_FALSE(watcher.wait(0, files));
+
+    // Written files outside the graph are ignored
+    Write("other.s", "NOP\n");
+    EXPECT_FALSE(watcher.wait(100, files));
+
+    const auto values = Write("values.s", ".define VALUE 5\n");
+    ASSERT_TRUE(watcher.wait(1000, files));
+    EXPECT_EQ(files, std::vector<std::string>({ values }));
+    ASSERT_TRUE(watcher.rebuild(files));
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xA2, 0x05, 0x4C, 0x05, 0x00, 0x01 }));
+}
+
+// A module failing on a missing include waits for the file to be created
+TEST_F(TestWatcher, Missing) {
+    const auto options = Options();
+    std::filesystem::remove(m_directory / "values.s");
+    sasm::watcher watcher(options);
+    if (!watcher.watching()) GTEST_SKIP();
+    EXPECT_FALSE(watcher.build());
+
+    std::vector<std::string> files;
+    const auto values = Write("values.s", ".define VALUE 6\n");
+    ASSERT_TRUE(watcher.wait(1000, files));
+    EXPECT_EQ(files, std::vector<std::string>({ values }));
+    ASSERT_TRUE(watcher.rebuild(files)) << ::testing::PrintToString(watcher.messages());
+    EXPECT_EQ(Read("out.bin"), bytes_t({ 0xA2, 0x06, 0x4C, 0x05, 0x00, 0x01 }));
+}
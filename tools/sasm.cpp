@@ -0,0 +1,93 @@
+#include <sasm/allocation.h>
+#include <sasm/driver.h>
+#include <sasm/server.h>
+#include <sasm/trace.h>
+#include <sasm/watcher.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    sasm::driver_options_t options;
+    if (!sasm::parse_arguments(std::vector<std::string>(argv + 1, argv + argc), options)) {
+        std::fputs(sasm::usage_text(), stderr);
+        return 1;
+    }
+
+    if (!options.server_socket.empty()) {
+        sasm::assembler_server server;
+        if (!server.serve(options.server_socket)) {
+            std::fprintf(stderr, "error: cannot serve on %s\n", options.server_socket.c_str());
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!options.trace_path.empty() && !sasm::start_trace(options.trace_path)) {
+        std::fprintf(stderr, "error: cannot write %s\n", options.trace_path.c_str());
+        return 1;
+    }
+
+    if (options.watch) {
+        sasm::watcher watcher(options);
+        if (!watcher.watching()) {
+            std::fputs("error: cannot watch files on this system\n", stderr);
+            return 1;
+        }
+        auto success = watcher.build();
+        std::vector<std::string> files;
+        while (true) {
+            for (const auto& message : watcher.messages()) {
+                std::fprintf(stderr, "error: %s\n", message.c_str());
+            }
+            std::fprintf(stderr, "%s %s, %zu of %zu modules assembled, %zu relocated\n",
+                success ? "built" : "failed", options.output.c_str(),
+                watcher.rebuilt().size(), options.sources.size(), watcher.program().relocated());
+            // Watching ends with a signal, the trace is written after each build
+            if (sasm::tracing()) sasm::write_trace();
+            while (!watcher.wait(-1, files)) {}
+            success = watcher.rebuild(files);
+        }
+    }
+
+    sasm::source_manager sources;
+    for (const auto& path : options.include_paths) {
+        sources.add_include_path(path);
+    }
+    sasm::driver_result_t result;
+    if (options.allocations) sasm::reset_allocation_counts();
+    const auto success = sasm::run_driver(options, sources, result);
+    for (const auto& message : result.messages) {
+        std::fprintf(stderr, "error: %s\n", message.c_str());
+    }
+    if (options.stats) {
+        if (!sasm::stats_enabled()) {
+            std::fputs("stats: not counted, sasm was built without SASM_STATS\n", stderr);
+        } else if (result.cached) {
+            std::fputs("stats: not counted, the output came from the build cache\n", stderr);
+        }
+        for (const auto& line : result.stats.report()) {
+            std::fprintf(stderr, "stats: %s\n", line.c_str());
+        }
+    }
+    if (options.profile) {
+        if (!sasm::profile_enabled()) {
+            std::fputs("profile: not recorded, sasm was built without SASM_PROFILE\n", stderr);
+        } else if (result.cached) {
+            std::fputs("profile: not recorded, the output came from the build cache\n", stderr);
+        }
+        for (const auto& line : result.profile.report()) {
+            std::fprintf(stderr, "profile: %s\n", line.c_str());
+        }
+    }
+    if (options.allocations) {
+        if (!sasm::allocations_counted()) {
+            std::fputs("allocations: not counted, sasm was built without SASM_ALLOCATIONS\n", stderr);
+        }
+        for (const auto& line : sasm::allocation_report()) {
+            std::fprintf(stderr, "allocations: %s\n", line.c_str());
+        }
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#include <sasm/server.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: sasm-client [--socket <path>] sasm arguments...\n"
+        "       sasm-client [--socket <path>] --stop\n"
+        "  --socket <path>  socket of the server, $SASM_SOCKET by default\n"
+        "  --stop           stop the server\n");
+}
+
+int main(int argc, char** argv) {
+    std::string socket_path;
+    if (const char* variable = std::getenv("SASM_SOCKET")) {
+        socket_path = variable;
+    }
+    bool stop = false;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--socket") && (i + 1 < argc)) {
+            socket_path = argv[++i];
+        } else if (arg == "--stop") {
+            stop = true;
+        } else {
+            arguments.push_back(arg);
+        }
+    }
+    if (socket_path.empty() || (stop == !arguments.empty())) {
+        usage();
+        return 1;
+    }
+
+    if (stop) {
+        return sasm::stop_server(socket_path) ? 0 : 1;
+    }
+
+    bool success = false;
+    std::vector<std::string> messages;
+    std::error_code error;
+    const auto directory = std::filesystem::current_path(error).string();
+    if (!sasm::send_request(socket_path, arguments, directory, success, messages)) {
+        std::fprintf(stderr, "error: cannot reach the server on %s\n", socket_path.c_str());
+        return 1;
+    }
+    for (const auto& message : messages) {
+        std::fprintf(stderr, "error: %s\n", message.c_str());
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <sasm/linker.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: sasm-link [options] objects...\n"
+        "  -o <path>         output binary, a.bin by default\n"
+        "  --origin <addr>   address of the first module, 0 by default\n"
+        "  -j <threads>      worker threads, every core by default\n"
+        "  --entry <symbol>  keep only what this export references, repeatable\n"
+        "  --map             print the address of every placed region\n");
+}
+
+static bool parse_number(const char* text, size_t& value) {
+    char* end = nullptr;
+    value = std::strtoull(text, &end, 0);
+    return (end != text) && (*end == '\0');
+}
+
+int main(int argc, char** argv) {
+    std::string output = "a.bin";
+    size_t origin = 0;
+    size_t threads = 0;
+    bool map = false;
+    std::vector<std::string> entries;
+    std::vector<std::string> objects;
+
+    bool valid = true;
+    for (int i = 1; valid && (i < argc); ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if ((arg == "-o") && has_value) {
+            output = argv[++i];
+        } else if ((arg == "--origin") && has_value) {
+            valid = parse_number(argv[++i], origin);
+        } else if ((arg == "-j") && has_value) {
+            valid = parse_number(argv[++i], threads);
+        } else if ((arg == "--entry") && has_value) {
+            entries.push_back(argv[++i]);
+        } else if (arg == "--map") {
+            map = true;
+        } else if (!arg.empty() && (arg[0] == '-')) {
+            valid = false;
+        } else {
+            objects.push_back(arg);
+        }
+    }
+    if (!valid || objects.empty()) {
+        usage();
+        return 1;
+    }
+
+    sasm::linker linker(origin, threads);
+    for (const auto& entry : entries) {
+        linker.add_entry(entry);
+    }
+    const auto success = linker.link(objects);
+    for (const auto& error : linker.errors()) {
+        std::fprintf(stderr, "error: %s\n", error.c_str());
+    }
+    if (!success) return 1;
+
+    if (map) {
+        for (const auto& module : linker.modules()) {
+            for (const auto& region : module->regions) {
+                if (!region.live) continue;
+                std::printf("%04zX %5u %s+%u\n", region.address, region.size,
+                            module->path.c_str(), region.offset);
+            }
+        }
+    }
+    if (!entries.empty()) {
+        std::printf("reclaimed %zu bytes in %zu regions\n",
+                    linker.reclaimed(), linker.reclaimed_regions());
+    }
+    if (!linker.write(output)) {
+        std::fprintf(stderr, "error: cannot write %s\n", output.c_str());
+        return 1;
+    }
+    return 0;
+}